@@ -27,10 +27,35 @@
 
 #include "gltfscene.h"
 #include "mikktWrapper.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <numeric>
+#include <thread>
 
 namespace nvh {
+    //--------------------------------------------------------------------------------------------------
+    // Calls task(i) for every index in \p order, spread over all hardware threads
+    //
+    template <typename Task>
+    static void parallelFor(const std::vector<size_t>& order, const Task& task)
+    {
+        std::atomic<size_t> next{ 0 };
+        auto                worker = [&]() {
+            for (size_t i = next++; i < order.size(); i = next++)
+                task(order[i]);
+        };
+
+        size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), order.size());
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
     //--------------------------------------------------------------------------------------------------
     // Collect the value of all materials
     //
@@ -104,11 +129,14 @@ namespace nvh {
     //
     void GltfScene::importDrawableNodes(const tinygltf::Model& tmodel, GltfAttributes attributes)
     {
-        // Find the number of vertex(attributes) and index
-        uint32_t nbVert{ 0 };
-        uint32_t nbIndex{ 0 };
+        // Find the number of vertex(attributes) and index, and where each primitive lands in them
+        uint32_t nbVert{ static_cast<uint32_t>(m_positions.size()) };
+        uint32_t nbIndex{ static_cast<uint32_t>(m_indices.size()) };
         uint32_t meshCnt{ 0 };  // use for mesh to new meshes
-        uint32_t primCnt{ 0 };  //  "   "  "  "
+        uint32_t primCnt{ static_cast<uint32_t>(m_primMeshes.size()) };  //  "   "  "  "
+        uint32_t firstPrim{ primCnt };
+
+        std::vector<const tinygltf::Primitive*> tprimitives;
         for (const auto& mesh : tmodel.meshes)
         {
             std::vector<uint32_t> vprim;
@@ -117,37 +145,54 @@ namespace nvh {
                 if (primitive.mode != 4)  // Triangle
                     continue;
                 const auto& posAccessor = tmodel.accessors[primitive.attributes.find("POSITION")->second];
-                nbVert += static_cast<uint32_t>(posAccessor.count);
                 const auto& indexAccessor = tmodel.accessors[primitive.indices];
-                nbIndex += static_cast<uint32_t>(indexAccessor.count);
+
+                GltfPrimMesh resultMesh;
+                resultMesh.materialIndex = std::max(0, primitive.material);
+                resultMesh.vertexOffset = nbVert;
+                resultMesh.firstIndex = nbIndex;
+                resultMesh.vertexCount = static_cast<uint32_t>(posAccessor.count);
+                resultMesh.indexCount = static_cast<uint32_t>(indexAccessor.count);
+                m_primMeshes.emplace_back(resultMesh);
+                tprimitives.emplace_back(&primitive);
+
+                nbVert += resultMesh.vertexCount;
+                nbIndex += resultMesh.indexCount;
                 vprim.emplace_back(primCnt++);
             }
             m_meshToPrimMeshes[meshCnt++] = std::move(vprim);  // mesh-id = { prim0, prim1, ... }
         }
 
-        // Reserving memory
-        // m_tangents.resize(nbVert, nvmath::vec4f(0.f, 0.f, 0.f, 0.f));
-        m_positions.reserve(nbVert);
-        m_indices.reserve(nbIndex);
+        // Allocating every attribute up front, so primitives can fill their ranges independently
+        m_positions.resize(nbVert);
+        m_indices.resize(nbIndex);
         if ((attributes & GltfAttributes::Normal) == GltfAttributes::Normal)
-            m_normals.reserve(nbVert);
+            m_normals.resize(nbVert);
         if ((attributes & GltfAttributes::Texcoord_0) == GltfAttributes::Texcoord_0)
-            m_texcoords0.reserve(nbVert);
+            m_texcoords0.resize(nbVert);
         if ((attributes & GltfAttributes::Tangent) == GltfAttributes::Tangent)
-            m_tangents.reserve(nbVert);
+            m_tangents.resize(nbVert);
         if ((attributes & GltfAttributes::Color_0) == GltfAttributes::Color_0)
-            m_colors0.reserve(nbVert);
+            m_colors0.resize(nbVert);
+        if ((attributes & GltfAttributes::Joints_0) == GltfAttributes::Joints_0)
+            m_joints0.resize(nbVert);
+        if ((attributes & GltfAttributes::Weights_0) == GltfAttributes::Weights_0)
+            m_weights0.resize(nbVert);
 
-        // Convert all mesh/primitives+ to a single primitive per mesh
-        for (const auto& tmesh : tmodel.meshes)
-        {
-            for (const auto& tprimitive : tmesh.primitives)
-            {
-                processMesh(tmodel, tprimitive, attributes);
-            }
-        }
+        // Convert all mesh/primitives+ to a single primitive per mesh. The largest primitives are
+        // started first so a big one picked up last does not hold up the whole import.
+        std::vector<size_t> order(tprimitives.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return m_primMeshes[firstPrim + a].indexCount > m_primMeshes[firstPrim + b].indexCount;
+        });
+
+        parallelFor(order, [&](size_t i) { processMesh(tmodel, *tprimitives[i], m_primMeshes[firstPrim + i], attributes); });
+
+        importSkins(tmodel);
 
         // Transforming the scene hierarchy to a flat list
+        m_nodeWorldMatrices.resize(tmodel.nodes.size(), nvmath::mat4f(1));
         int         defaultScene = tmodel.defaultScene > -1 ? tmodel.defaultScene : 0;
         const auto& tscene = tmodel.scenes[defaultScene];
         for (auto nodeIdx : tscene.nodes)
@@ -158,9 +203,6 @@ namespace nvh {
         computeSceneDimensions();
 
         m_meshToPrimMeshes.clear();
-        primitiveIndices32u.clear();
-        primitiveIndices16u.clear();
-        primitiveIndices8u.clear();
     }
 
     //--------------------------------------------------------------------------------------------------
@@ -173,6 +215,8 @@ namespace nvh {
         nvmath::mat4f matrix = getLocalMatrix(tnode);
         nvmath::mat4f worldMatrix = parentMatrix * matrix;
 
+        m_nodeWorldMatrices[nodeIdx] = worldMatrix;
+
         if (tnode.mesh > -1)
         {
             const auto& meshes = m_meshToPrimMeshes[tnode.mesh];  // A mesh could have many primitives
@@ -181,6 +225,7 @@ namespace nvh {
                 GltfNode node;
                 node.primMesh = mesh;
                 node.worldMatrix = worldMatrix;
+                node.skin = tnode.skin;
                 m_nodes.emplace_back(node);
             }
         }
@@ -209,49 +254,36 @@ namespace nvh {
     }
 
     //--------------------------------------------------------------------------------------------------
-    // Extracting the values to a linear buffer
+    // Extracting the values into the range of the linear buffers reserved for \p resultMesh.
+    // Only touches that range, so primitives can be processed concurrently.
     //
-    void GltfScene::processMesh(const tinygltf::Model& tmodel, const tinygltf::Primitive& tmesh, GltfAttributes attributes)
+    void GltfScene::processMesh(const tinygltf::Model& tmodel, const tinygltf::Primitive& tmesh, GltfPrimMesh& resultMesh, GltfAttributes attributes)
     {
-        GltfPrimMesh resultMesh;
-        resultMesh.materialIndex = std::max(0, tmesh.material);
-        resultMesh.vertexOffset = static_cast<uint32_t>(m_positions.size());
-        resultMesh.firstIndex = static_cast<uint32_t>(m_indices.size());
-
-        // Only triangles are supported
-        // 0:point, 1:lines, 2:line_loop, 3:line_strip, 4:triangles, 5:triangle_strip, 6:triangle_fan
-        if (tmesh.mode != 4)
-            return;
-
         // INDICES
         {
             const tinygltf::Accessor& indexAccessor = tmodel.accessors[tmesh.indices];
             const tinygltf::BufferView& bufferView = tmodel.bufferViews[indexAccessor.bufferView];
             const tinygltf::Buffer& buffer = tmodel.buffers[bufferView.buffer];
-
-            resultMesh.indexCount = static_cast<uint32_t>(indexAccessor.count);
+            uint32_t* dst = m_indices.data() + resultMesh.firstIndex;
 
             switch (indexAccessor.componentType)
             {
             case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                primitiveIndices32u.resize(indexAccessor.count);
-                memcpy(primitiveIndices32u.data(), &buffer.data[indexAccessor.byteOffset + bufferView.byteOffset],
-                    indexAccessor.count * sizeof(uint32_t));
-                m_indices.insert(m_indices.end(), primitiveIndices32u.begin(), primitiveIndices32u.end());
+                const uint32_t* indices = reinterpret_cast<const uint32_t*>(
+                    &buffer.data[indexAccessor.byteOffset + bufferView.byteOffset]);
+                std::copy(indices, indices + indexAccessor.count, dst);
                 break;
             }
             case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                primitiveIndices16u.resize(indexAccessor.count);
-                memcpy(primitiveIndices16u.data(), &buffer.data[indexAccessor.byteOffset + bufferView.byteOffset],
-                    indexAccessor.count * sizeof(uint16_t));
-                m_indices.insert(m_indices.end(), primitiveIndices16u.begin(), primitiveIndices16u.end());
+                const uint16_t* indices = reinterpret_cast<const uint16_t*>(
+                    &buffer.data[indexAccessor.byteOffset + bufferView.byteOffset]);
+                std::copy(indices, indices + indexAccessor.count, dst);
                 break;
             }
             case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-                primitiveIndices8u.resize(indexAccessor.count);
-                memcpy(primitiveIndices8u.data(), &buffer.data[indexAccessor.byteOffset + bufferView.byteOffset],
-                    indexAccessor.count * sizeof(uint8_t));
-                m_indices.insert(m_indices.end(), primitiveIndices8u.begin(), primitiveIndices8u.end());
+                const uint8_t* indices = reinterpret_cast<const uint8_t*>(
+                    &buffer.data[indexAccessor.byteOffset + bufferView.byteOffset]);
+                std::copy(indices, indices + indexAccessor.count, dst);
                 break;
             }
             default:
@@ -262,11 +294,10 @@ namespace nvh {
 
         // POSITION
         {
-            bool result = getAttribute<nvmath::vec3f>(tmodel, tmesh, m_positions, "POSITION");
+            getAttribute<nvmath::vec3f>(tmodel, tmesh, &m_positions[resultMesh.vertexOffset], "POSITION");
 
-            // Keeping the size of this primitive (Spec says this is required information)
+            // Keeping the bounds of this primitive (Spec says this is required information)
             const auto& accessor = tmodel.accessors[tmesh.attributes.find("POSITION")->second];
-            resultMesh.vertexCount = static_cast<uint32_t>(accessor.count);
             if (!accessor.minValues.empty())
                 resultMesh.posMin = nvmath::vec3f(accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]);
             if (!accessor.maxValues.empty())
@@ -277,10 +308,10 @@ namespace nvh {
         // NORMAL
         if ((attributes & GltfAttributes::Normal) == GltfAttributes::Normal)
         {
-            if (!getAttribute<nvmath::vec3f>(tmodel, tmesh, m_normals, "NORMAL"))
+            if (!getAttribute<nvmath::vec3f>(tmodel, tmesh, &m_normals[resultMesh.vertexOffset], "NORMAL"))
             {
-                // Need to compute the normals
-                std::vector<nvmath::vec3> geonormal(resultMesh.vertexCount);
+                // Need to compute the normals, accumulated in place
+                nvmath::vec3f* geonormal = &m_normals[resultMesh.vertexOffset];
                 for (size_t i = 0; i < resultMesh.indexCount; i += 3)
                 {
                     uint32_t    ind0 = m_indices[resultMesh.firstIndex + i + 0];
@@ -296,16 +327,15 @@ namespace nvh {
                     geonormal[ind1] += n;
                     geonormal[ind2] += n;
                 }
-                for (auto& n : geonormal)
-                    n = nvmath::normalize(n);
-                m_normals.insert(m_normals.end(), geonormal.begin(), geonormal.end());
+                for (uint32_t i = 0; i < resultMesh.vertexCount; i++)
+                    geonormal[i] = nvmath::normalize(geonormal[i]);
             }
         }
 
         // TEXCOORD_0
         if ((attributes & GltfAttributes::Texcoord_0) == GltfAttributes::Texcoord_0)
         {
-            if (!getAttribute<nvmath::vec2f>(tmodel, tmesh, m_texcoords0, "TEXCOORD_0"))
+            if (!getAttribute<nvmath::vec2f>(tmodel, tmesh, &m_texcoords0[resultMesh.vertexOffset], "TEXCOORD_0"))
             {
                 // Set them all to zero
                 //      m_texcoords0.insert(m_texcoords0.end(), resultMesh.vertexCount, nvmath::vec2f(0, 0));
@@ -383,7 +413,7 @@ namespace nvh {
                     float u = 0.5f * (uc / maxAxis + 1.0f);
                     float v = 0.5f * (vc / maxAxis + 1.0f);
 
-                    m_texcoords0.emplace_back(u, v);
+                    m_texcoords0[resultMesh.vertexOffset + i] = nvmath::vec2f(u, v);
                 }
             }
         }
@@ -392,29 +422,85 @@ namespace nvh {
         // TANGENT
         if ((attributes & GltfAttributes::Tangent) == GltfAttributes::Tangent)
         {
-            if (!getAttribute<nvmath::vec4f>(tmodel, tmesh, m_tangents, "TANGENT"))
+            if (!getAttribute<nvmath::vec4f>(tmodel, tmesh, &m_tangents[resultMesh.vertexOffset], "TANGENT"))
             {
                 // Default MikkTSpace algorithms
                 // See: https://github.com/mmikk/MikkTSpace
-                std::vector<nvmath::vec4f> localTangents(resultMesh.vertexCount);
-                genTangents(&resultMesh, m_indices.data(), m_positions.data(), m_normals.data(), m_texcoords0.data(), localTangents.data());
-                m_tangents.insert(m_tangents.end(), localTangents.begin(), localTangents.end());
+                genTangents(&resultMesh, m_indices.data(), m_positions.data(), m_normals.data(), m_texcoords0.data(),
+                            &m_tangents[resultMesh.vertexOffset]);
             }
         }
 
         // COLOR_0
         if ((attributes & GltfAttributes::Color_0) == GltfAttributes::Color_0)
         {
-            if (!getAttribute<nvmath::vec4f>(tmodel, tmesh, m_colors0, "COLOR_0"))
+            if (!getAttribute<nvmath::vec4f>(tmodel, tmesh, &m_colors0[resultMesh.vertexOffset], "COLOR_0"))
             {
                 // Set them all to one
-                m_colors0.insert(m_colors0.end(), resultMesh.vertexCount, nvmath::vec4f(1, 1, 1, 1));
+                std::fill_n(&m_colors0[resultMesh.vertexOffset], resultMesh.vertexCount, nvmath::vec4f(1, 1, 1, 1));
             }
         }
 
-        m_primMeshes.emplace_back(resultMesh);
+        // JOINTS_0, unsigned byte or short indices into the skin's joint list
+        if ((attributes & GltfAttributes::Joints_0) == GltfAttributes::Joints_0)
+        {
+            forEachComponent(tmodel, tmesh, "JOINTS_0", 4, [&](size_t i, int c, const uint8_t* data, int componentType) {
+                m_joints0[resultMesh.vertexOffset + i][c] = componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE
+                                                                ? *data
+                                                                : *reinterpret_cast<const uint16_t*>(data);
+            });
+        }
+
+        // WEIGHTS_0, float or normalized unsigned byte or short. Left at zero when missing,
+        // which the skinning pass treats as an unskinned vertex.
+        if ((attributes & GltfAttributes::Weights_0) == GltfAttributes::Weights_0)
+        {
+            forEachComponent(tmodel, tmesh, "WEIGHTS_0", 4, [&](size_t i, int c, const uint8_t* data, int componentType) {
+                float& weight = m_weights0[resultMesh.vertexOffset + i][c];
+                switch (componentType)
+                {
+                case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                    weight = *reinterpret_cast<const float*>(data);
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                    weight = *data / 255.0f;
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                    weight = *reinterpret_cast<const uint16_t*>(data) / 65535.0f;
+                    break;
+                }
+            });
+        }
     }  // namespace nvh
 
+    //--------------------------------------------------------------------------------------------------
+    // Joint lists and inverse bind matrices of every skin
+    //
+    void GltfScene::importSkins(const tinygltf::Model& tmodel)
+    {
+        m_skins.reserve(m_skins.size() + tmodel.skins.size());
+        for (const auto& tskin : tmodel.skins)
+        {
+            GltfSkin skin;
+            skin.joints = tskin.joints;
+            skin.inverseBindMatrices.resize(tskin.joints.size(), nvmath::mat4f(1));
+
+            if (tskin.inverseBindMatrices > -1)
+            {
+                const auto& accessor = tmodel.accessors[tskin.inverseBindMatrices];
+                const auto& bufView = tmodel.bufferViews[accessor.bufferView];
+                const auto& buffer = tmodel.buffers[bufView.buffer];
+                const auto  bufData = reinterpret_cast<const float*>(&buffer.data[accessor.byteOffset + bufView.byteOffset]);
+
+                // Column major, like nvmath
+                for (size_t i = 0; i < std::min(accessor.count, skin.joints.size()); i++)
+                    std::copy(bufData + i * 16, bufData + i * 16 + 16, skin.inverseBindMatrices[i].mat_array);
+            }
+
+            m_skins.emplace_back(std::move(skin));
+        }
+    }
+
     //--------------------------------------------------------------------------------------------------
     // Return the matrix of the node
     //
@@ -463,8 +549,10 @@ namespace nvh {
         m_texcoords1.clear();
         m_colors0.clear();
         m_cameras.clear();
-        //m_joints0.clear();
-        //m_weights0.clear();
+        m_joints0.clear();
+        m_weights0.clear();
+        m_skins.clear();
+        m_nodeWorldMatrices.clear();
         m_dimensions = {};
     }
 
@@ -562,7 +650,7 @@ namespace nvh {
         if (!gltfModel.images.empty()) {
             m_textures.reserve(gltfModel.images.size());
             for (size_t i = 0; i < gltfModel.images.size(); i++) {
-                m_textures.emplace_back(gltfModel.images[i]);
+                m_textures.emplace_back(std::move(gltfModel.images[i]));
             }
         }        
     }
@@ -102,6 +102,13 @@ namespace nvh {
     {
         nvmath::mat4f worldMatrix{ 1 };
         int           primMesh{ 0 };
+        int           skin{ -1 };
+    };
+
+    struct GltfSkin
+    {
+        std::vector<int>           joints;  // glTF node indices
+        std::vector<nvmath::mat4f> inverseBindMatrices;
     };
 
     struct GltfPrimMesh
@@ -152,8 +159,8 @@ namespace nvh {
         Texcoord_1 = 4,
         Tangent = 8,
         Color_0 = 16,
-        //Joints_0   = 32, // #TODO - Add support for skinning
-        //Weights_0  = 64,
+        Joints_0 = 32,
+        Weights_0 = 64,
     };
     using GltfAttributes_t = std::underlying_type_t<GltfAttributes>;
 
@@ -197,10 +204,11 @@ namespace nvh {
         std::vector<nvmath::vec2f> m_texcoords1;
         std::vector<nvmath::vec4f> m_colors0;
 
-        // #TODO - Adding support for Skinning
-        //using vec4us = vector4<unsigned short>;
-        //std::vector<vec4us>        m_joints0;
-        //std::vector<nvmath::vec4f> m_weights0;
+        // Skinning
+        std::vector<nvmath::vec4ui> m_joints0;
+        std::vector<nvmath::vec4f>  m_weights0;
+        std::vector<GltfSkin>      m_skins;
+        std::vector<nvmath::mat4f> m_nodeWorldMatrices;  // Every glTF node, including joints, by glTF node index
 
         // Size of the scene
         struct Dimensions
@@ -215,15 +223,13 @@ namespace nvh {
 
     private:
         void          processNode(const tinygltf::Model& tmodel, int& nodeIdx, const nvmath::mat4f& parentMatrix);
-        void          processMesh(const tinygltf::Model& tmodel, const tinygltf::Primitive& tmesh, GltfAttributes attributes);
+        void          processMesh(const tinygltf::Model& tmodel, const tinygltf::Primitive& tmesh, GltfPrimMesh& resultMesh, GltfAttributes attributes);
         nvmath::mat4f getLocalMatrix(const tinygltf::Node& tnode);
+        void          importSkins(const tinygltf::Model& tmodel);
 
 
         // Temporary data
         std::unordered_map<int, std::vector<uint32_t>> m_meshToPrimMeshes;
-        std::vector<uint32_t>                          primitiveIndices32u;
-        std::vector<uint16_t>                          primitiveIndices16u;
-        std::vector<uint8_t>                           primitiveIndices8u;
 
         // Return a vector of data for a tinygltf::Value
         template <typename T>
@@ -240,10 +246,37 @@ namespace nvh {
             return result;
         }
 
-        // Appending to \p attribVec, all the values of \p attribName
+        // Calling \p visit(element, component, data, componentType) for the first \p nbComponents
+        // components of every element of \p attribName, whatever their type
+        // Return false if the attribute is missing
+        template <typename Visit>
+        static bool forEachComponent(const tinygltf::Model& tmodel, const tinygltf::Primitive& primitive, const std::string& attribName,
+                                     int nbComponents, const Visit& visit)
+        {
+            if (primitive.attributes.find(attribName) == primitive.attributes.end())
+                return false;
+
+            const auto& accessor = tmodel.accessors[primitive.attributes.find(attribName)->second];
+            const auto& bufView = tmodel.bufferViews[accessor.bufferView];
+            const auto& buffer = tmodel.buffers[bufView.buffer];
+            const auto  bufData = &buffer.data[accessor.byteOffset + bufView.byteOffset];
+
+            const int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+            const int elementSize = componentSize * tinygltf::GetNumComponentsInType(accessor.type);
+            const size_t byteStride = bufView.byteStride > 0 ? bufView.byteStride : elementSize;
+            nbComponents = std::min(nbComponents, tinygltf::GetNumComponentsInType(accessor.type));
+
+            for (size_t i = 0; i < accessor.count; i++)
+                for (int c = 0; c < nbComponents; c++)
+                    visit(i, c, bufData + i * byteStride + c * componentSize, accessor.componentType);
+
+            return true;
+        }
+
+        // Writing to \p attribData, all the values of \p attribName
         // Return false if the attribute is missing
         template <typename T>
-        bool getAttribute(const tinygltf::Model& tmodel, const tinygltf::Primitive& primitive, std::vector<T>& attribVec, const std::string& attribName)
+        bool getAttribute(const tinygltf::Model& tmodel, const tinygltf::Primitive& primitive, T* attribData, const std::string& attribName)
         {
             if (primitive.attributes.find(attribName) == primitive.attributes.end())
                 return false;
@@ -262,7 +295,7 @@ namespace nvh {
             {
                 if (bufView.byteStride == 0)
                 {
-                    attribVec.insert(attribVec.end(), bufData, bufData + nbElems);
+                    std::copy(bufData, bufData + nbElems, attribData);
                 }
                 else
                 {
@@ -270,7 +303,7 @@ namespace nvh {
                     auto bufferByte = reinterpret_cast<const uint8_t*>(bufData);
                     for (size_t i = 0; i < nbElems; i++)
                     {
-                        attribVec.push_back(*reinterpret_cast<const T*>(bufferByte));
+                        attribData[i] = *reinterpret_cast<const T*>(bufferByte);
                         bufferByte += bufView.byteStride;
                     }
                 }
@@ -298,7 +331,7 @@ namespace nvh {
                         bufferByteData += strideComponent;
                     }
                     bufferByte += byteStride;
-                    attribVec.push_back(vecValue);
+                    attribData[i] = vecValue;
                 }
             }
 
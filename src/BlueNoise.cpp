@@ -0,0 +1,157 @@
+#include "BlueNoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace
+{
+constexpr float   Sigma        = 1.9f;
+constexpr int32_t KernelRadius = 6;
+
+// Gaussian energy of the set pixels, wrapped around the edges so the texture tiles
+class EnergyField
+{
+public:
+    EnergyField(uint32_t size)
+        : _size(size), _energy(size * size, 0.0f), _set(size * size, false)
+    {
+        for (int32_t y = -KernelRadius; y <= KernelRadius; ++y)
+        {
+            for (int32_t x = -KernelRadius; x <= KernelRadius; ++x)
+            {
+                _kernel.push_back(
+                    std::exp(-static_cast<float>(x * x + y * y) / (2.0f * Sigma * Sigma)));
+            }
+        }
+    }
+
+    void set(uint32_t pixel, bool value)
+    {
+        _set[pixel] = value;
+
+        float   sign = value ? 1.0f : -1.0f;
+        int32_t size = static_cast<int32_t>(_size);
+        int32_t px   = static_cast<int32_t>(pixel % _size);
+        int32_t py   = static_cast<int32_t>(pixel / _size);
+
+        uint32_t k = 0;
+        for (int32_t y = -KernelRadius; y <= KernelRadius; ++y)
+        {
+            for (int32_t x = -KernelRadius; x <= KernelRadius; ++x, ++k)
+            {
+                int32_t wx = (px + x + size) % size;
+                int32_t wy = (py + y + size) % size;
+                _energy[wy * size + wx] += sign * _kernel[k];
+            }
+        }
+    }
+
+    uint32_t tightestCluster() const
+    {
+        return find(true, [](float a, float b) { return a > b; });
+    }
+
+    uint32_t largestVoid() const
+    {
+        return find(false, [](float a, float b) { return a < b; });
+    }
+
+private:
+    uint32_t           _size;
+    std::vector<float> _kernel;
+    std::vector<float> _energy;
+    std::vector<bool>  _set;
+
+    template<typename Compare>
+    uint32_t find(bool set, Compare better) const
+    {
+        uint32_t found = 0;
+        bool     any   = false;
+        for (uint32_t i = 0; i < _energy.size(); ++i)
+        {
+            if (_set[i] == set && (!any || better(_energy[i], _energy[found])))
+            {
+                found = i;
+                any   = true;
+            }
+        }
+
+        return found;
+    }
+};
+} // namespace
+
+std::vector<uint16_t> BlueNoise::generate(uint32_t seed)
+{
+    constexpr uint32_t pixelCount = Size * Size;
+
+    std::vector<uint16_t> texels(pixelCount * Channels);
+    for (uint32_t channel = 0; channel < Channels; ++channel)
+    {
+        std::vector<uint32_t> ranks = rankPixels(seed + channel);
+        for (uint32_t i = 0; i < pixelCount; ++i)
+        {
+            // Centered in the rank's interval, so no texel is exactly 0 or 1
+            texels[i * Channels + channel] =
+                static_cast<uint16_t>((ranks[i] * 65536u + 32768u) / pixelCount);
+        }
+    }
+
+    return texels;
+}
+
+std::vector<uint32_t> BlueNoise::rankPixels(uint32_t seed)
+{
+    constexpr uint32_t pixelCount   = Size * Size;
+    constexpr uint32_t initialCount = pixelCount / 10;
+
+    std::vector<uint32_t> order(pixelCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+
+    // Initial binary pattern, relaxed by moving the tightest cluster into the largest void until
+    // that stops changing anything. Bounded in case it cycles.
+    EnergyField prototype(Size);
+    for (uint32_t i = 0; i < initialCount; ++i)
+    {
+        prototype.set(order[i], true);
+    }
+
+    for (uint32_t i = 0; i < pixelCount; ++i)
+    {
+        uint32_t cluster = prototype.tightestCluster();
+        prototype.set(cluster, false);
+
+        uint32_t largestVoid = prototype.largestVoid();
+        prototype.set(largestVoid, true);
+
+        if (largestVoid == cluster)
+        {
+            break;
+        }
+    }
+
+    std::vector<uint32_t> ranks(pixelCount);
+
+    EnergyField field = prototype;
+    for (uint32_t rank = initialCount; rank-- > 0;)
+    {
+        uint32_t cluster = field.tightestCluster();
+        field.set(cluster, false);
+        ranks[cluster] = rank;
+    }
+
+    // Past half the pixels, the tightest cluster of unset pixels is also the largest void since
+    // their energies add up to a constant, so one loop covers both remaining phases
+    field = prototype;
+    for (uint32_t rank = initialCount; rank < pixelCount; ++rank)
+    {
+        uint32_t largestVoid = field.largestVoid();
+        field.set(largestVoid, true);
+        ranks[largestVoid] = rank;
+    }
+
+    return ranks;
+}
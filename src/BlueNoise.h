@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Tileable blue noise built with void and cluster. Every channel is an independent ranking of the
+// pixels, so each one is uniformly distributed with its error pushed to high frequencies.
+class BlueNoise
+{
+public:
+    static constexpr uint32_t Size     = 64;
+    static constexpr uint32_t Channels = 4;
+
+    // Size * Size interleaved RGBA16 texels
+    static std::vector<uint16_t> generate(uint32_t seed);
+
+private:
+    static std::vector<uint32_t> rankPixels(uint32_t seed);
+};
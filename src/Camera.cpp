@@ -20,8 +20,9 @@ void Camera::update()
     float f = 1.0f / std::tan(0.5f * FovY);
 
     ProjectionMatrix = nvmath::mat4f_zero;
-    ProjectionMatrix.set_row(0, nvmath::vec4f(f / AspectRatio, 0.0f, 0.0f, 0.0f));
-    ProjectionMatrix.set_row(1, nvmath::vec4f(0.0f, f, 0.0f, 0.0f));
+    // Clip w is the view depth, so the jitter in the z column moves every point the same amount
+    ProjectionMatrix.set_row(0, nvmath::vec4f(f / AspectRatio, 0.0f, Jitter.x, 0.0f));
+    ProjectionMatrix.set_row(1, nvmath::vec4f(0.0f, f, Jitter.y, 0.0f));
     ProjectionMatrix.set_row(
         2,
         nvmath::vec4f(0.0f, 0.0f, -ZFar / (ZNear - ZFar), ZNear * ZFar / (ZNear - ZFar)));
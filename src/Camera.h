@@ -14,6 +14,9 @@ public:
     float FovY        = 0.5f * nv_pi;
     float AspectRatio = 1.0f;
 
+    // Sub-pixel offset of the projection in normalized device coordinates
+    nvmath::vec2f Jitter {0.0f, 0.0f};
+
     nvmath::vec3f ForwardVec;
     nvmath::vec3f RightVec;
     nvmath::vec3f UpVec;
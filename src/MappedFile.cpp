@@ -0,0 +1,132 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cout << "Failed to open " << path << "!" << std::endl;
+        std::abort();
+    }
+    _file = file;
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    _size = static_cast<std::size_t>(size.QuadPart);
+
+    if (_size == 0)
+    {
+        return;
+    }
+
+    _mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!_mapping)
+    {
+        std::cout << "Failed to map " << path << "!" << std::endl;
+        std::abort();
+    }
+
+    _data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        std::cout << "Failed to open " << path << "!" << std::endl;
+        std::abort();
+    }
+
+    struct stat status;
+    fstat(file, &status);
+    _size = static_cast<std::size_t>(status.st_size);
+
+    if (_size > 0)
+    {
+        void* mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+        _data        = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapped);
+    }
+
+    // The mapping keeps its own reference to the file
+    close(file);
+#endif
+
+    if (_size > 0 && !_data)
+    {
+        std::cout << "Failed to map " << path << "!" << std::endl;
+        std::abort();
+    }
+}
+
+MappedFile::MappedFile(MappedFile&& src) noexcept
+{
+    *this = std::move(src);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& src) noexcept
+{
+    assert(&src != this);
+    reset();
+
+    std::swap(_data, src._data);
+    std::swap(_size, src._size);
+#ifdef _WIN32
+    std::swap(_file, src._file);
+    std::swap(_mapping, src._mapping);
+#endif
+
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    reset();
+}
+
+std::span<const uint8_t> MappedFile::data() const
+{
+    return {_data, _size};
+}
+
+void MappedFile::reset()
+{
+#ifdef _WIN32
+    if (_data)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping)
+    {
+        CloseHandle(_mapping);
+    }
+    if (_file)
+    {
+        CloseHandle(_file);
+    }
+
+    _file    = nullptr;
+    _mapping = nullptr;
+#else
+    if (_data)
+    {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+#endif
+
+    _data = nullptr;
+    _size = 0;
+}
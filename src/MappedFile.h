@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+
+// Read-only view of a whole file mapped into memory. Pages are only read in as they are touched
+// and never count against the heap.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& path);
+    MappedFile(MappedFile&& src) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&& src) noexcept;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    std::span<const uint8_t> data() const;
+
+private:
+    const uint8_t* _data = nullptr;
+    std::size_t    _size = 0;
+
+#ifdef _WIN32
+    void* _file    = nullptr;
+    void* _mapping = nullptr;
+#endif
+
+    void reset();
+};
@@ -5,7 +5,27 @@
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
-Program::Program(const std::string& scene, uint32_t pointLightCount)
+namespace
+{
+// Radical inverse of index in the given base
+float halton(uint32_t index, uint32_t base)
+{
+    float result   = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0)
+    {
+        fraction /= static_cast<float>(base);
+        result += fraction * static_cast<float>(index % base);
+        index /= base;
+    }
+    return result;
+}
+} // namespace
+
+Program::Program(const std::string& scene,
+                 uint32_t           pointLightCount,
+                 vk::DeviceSize     textureBudget,
+                 const std::string& environment)
 {
     initGlfw();
 
@@ -14,6 +34,7 @@ Program::Program(const std::string& scene, uint32_t pointLightCount)
     createDevice();
 
     _swapchain = Swapchain(*_device, _physicalDevice, *_surface, _window);
+    updateRenderSize();
 
     {
         vk::CommandPoolCreateInfo poolInfo;
@@ -24,15 +45,27 @@ Program::Program(const std::string& scene, uint32_t pointLightCount)
 
     _allocator = ResourceManager(vulkanApiVersion, *_instance, _physicalDevice, *_device);
 
-    _transientCommandBuffer = TransientCommandBuffer(*_device, _queue, _queueIndex);
-    _scene = Scene(scene, _allocator, _transientCommandBuffer, *_device, pointLightCount);
+    _transientCommandBuffer =
+        TransientCommandBuffer(*_device, _queue, _queueIndex, _transferQueue, _transferQueueIndex);
+    _scene = Scene(scene,
+                   _allocator,
+                   _transientCommandBuffer,
+                   *_device,
+                   pointLightCount,
+                   _textureCompressionBC,
+                   environment);
+    _textureStreamer = TextureStreamer(*_device,
+                                       _allocator,
+                                       _scene,
+                                       _transientCommandBuffer,
+                                       textureBudget);
 
     createDescriptorSets();
 
     Formats::initialize(_physicalDevice);
 
     _basePass = BasePass(*_device,
-                         _swapchain.ScreenSize,
+                         _renderSize,
                          _allocator,
                          *_staticDescriptorPool,
                          *_textureDescriptorPool,
@@ -43,45 +76,105 @@ Program::Program(const std::string& scene, uint32_t pointLightCount)
     {
         framebufferData.framebuffer = Framebuffer(_allocator,
                                                   *_device,
-                                                  _swapchain.ScreenSize,
+                                                  _renderSize,
                                                   _basePass,
                                                   _transientCommandBuffer);
     }
 
     createUniformBuffer();
 
-    _restirPass =
-        RestirPass(*_device, _physicalDevice, *_staticDescriptorPool, _allocator, _framebufferData);
-    _spatialReusePass =
-        SpatialReusePass(*_device, *_staticDescriptorPool, _allocator, _framebufferData);
+    _cullingPass = CullingPass(*_device,
+                               *_staticDescriptorPool,
+                               _allocator,
+                               _scene,
+                               _renderSize,
+                               _framebufferData,
+                               _transientCommandBuffer);
+
+    _basePass.bindVisibleInstances(*_device, *_cullingPass.VisibleInstances);
+
+    _skinningPass = SkinningPass(*_device, _physicalDevice, *_staticDescriptorPool, _scene);
+
+    _restirPass = RestirPass(*_device,
+                             _physicalDevice,
+                             *_staticDescriptorPool,
+                             _allocator,
+                             _framebufferData,
+                             _basePass.getTextureDescriptorSetLayout(),
+                             _transientCommandBuffer);
+    _spatialReusePass = SpatialReusePass(*_device,
+                                         *_staticDescriptorPool,
+                                         _allocator,
+                                         _framebufferData,
+                                         _basePass.getTextureDescriptorSetLayout());
+    _giPass = GiPass(*_device,
+                     _physicalDevice,
+                     *_staticDescriptorPool,
+                     _allocator,
+                     _framebufferData,
+                     _restirPass.getStaticDescriptorSetLayout(),
+                     _basePass.getTextureDescriptorSetLayout());
+    _denoisePass = DenoisePass(*_device,
+                               *_staticDescriptorPool,
+                               _allocator,
+                               _renderSize,
+                               _framebufferData,
+                               _restirPass.getStaticDescriptorSetLayout(),
+                               _transientCommandBuffer);
+    _accumulationPass = AccumulationPass(*_device,
+                                         *_staticDescriptorPool,
+                                         _allocator,
+                                         _renderSize,
+                                         _framebufferData,
+                                         _transientCommandBuffer);
+    _upscalePass = UpscalePass(*_device,
+                               *_staticDescriptorPool,
+                               _allocator,
+                               _swapchain.ScreenSize,
+                               _framebufferData,
+                               _transientCommandBuffer);
 
     updateRestirBuffers();
 
     _lightingPass = LightingPass(*_device,
-                                 _swapchain.ScreenFormat,
                                  *_staticDescriptorPool,
                                  _allocator,
+                                 _swapchain.ScreenSize,
                                  _framebufferData);
 
+    _toneMappingPass = ToneMappingPass(*_device,
+                                       *_staticDescriptorPool,
+                                       _allocator,
+                                       _swapchain.ScreenSize,
+                                       _transientCommandBuffer);
+    _toneMappingPass.initializeDescriptorSet(*_device, _lightingPass.getHdrView());
+
     initializeLightingPassResources();
 
     std::vector<vk::UniqueCommandBuffer> commandBuffers =
         std::move(_device->allocateCommandBuffersUnique({
             .commandPool        = *_commandPool,
             .level              = vk::CommandBufferLevel::ePrimary,
-            .commandBufferCount = static_cast<uint32_t>(FRAMEBUFFER_COUNT),
+            .commandBufferCount = static_cast<uint32_t>(FRAMEBUFFER_COUNT + 1),
         }));
 
     for (size_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
     {
         _framebufferData[i].MainCommandBuffer = std::move(commandBuffers[i]);
     }
+    _sceneUpdateCommandBuffer = std::move(commandBuffers[FRAMEBUFFER_COUNT]);
 
     recordMainCommandBuffers();
     createSwapchainBuffers();
 
+#ifdef ENABLE_SHADER_HOT_RELOAD
+    _shaderHotReload = ShaderHotReload(SHADER_SOURCE_DIRECTORY, "shaders");
+#endif
+
     createSyncObjects();
 
+    _allocator.logHeapUsage();
+
     vk::Extent2D extent = getWindowSize();
     _camera.AspectRatio = static_cast<float>(extent.width) / static_cast<float>(extent.height);
     _camera.update();
@@ -222,10 +315,11 @@ void Program::createSurface()
 
 void Program::createDevice()
 {
-    const std::array<const char*, 6> requestedDeviceExtensions {
+    const std::array<const char*, 7> requestedDeviceExtensions {
         VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
         VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
         VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
+        VK_KHR_RAY_QUERY_EXTENSION_NAME,
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
         VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME,
@@ -289,27 +383,62 @@ void Program::createDevice()
         }
     }
 
-    float                                    queuePriority = 1.0f;
-    std::array<vk::DeviceQueueCreateInfo, 1> queueCreateInfos {{{
+    // A transfer-only family maps to the copy engines, so uploads there run alongside the
+    // graphics queue
+    for (std::size_t i = 0; i < queueFamilyProperties.size(); ++i)
+    {
+        const vk::QueueFlags flags = queueFamilyProperties[i].queueFlags;
+
+        if ((flags & vk::QueueFlagBits::eTransfer) &&
+            !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)))
+        {
+            _transferQueueIndex = static_cast<uint32_t>(i);
+            break;
+        }
+    }
+
+    // Without BC support scene textures stay uncompressed RGBA8
+    _textureCompressionBC = _physicalDevice.getFeatures().textureCompressionBC;
+
+    float                                  queuePriority = 1.0f;
+    std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos {{
         .queueFamilyIndex = _queueIndex,
         .queueCount       = 1,
         .pQueuePriorities = &queuePriority,
-    }}};
+    }};
+    if (_transferQueueIndex)
+    {
+        queueCreateInfos.push_back({
+            .queueFamilyIndex = *_transferQueueIndex,
+            .queueCount       = 1,
+            .pQueuePriorities = &queuePriority,
+        });
+    }
 
     vk::StructureChain<vk::DeviceCreateInfo,
                        vk::PhysicalDeviceFeatures2,
                        vk::PhysicalDeviceVulkan12Features,
                        vk::PhysicalDeviceVulkan13Features,
                        vk::PhysicalDeviceRayTracingPipelineFeaturesKHR,
-                       vk::PhysicalDeviceAccelerationStructureFeaturesKHR>
+                       vk::PhysicalDeviceAccelerationStructureFeaturesKHR,
+                       vk::PhysicalDeviceRayQueryFeaturesKHR>
         deviceCreateInfo {
             {.queueCreateInfoCount    = static_cast<uint32_t>(queueCreateInfos.size()),
              .pQueueCreateInfos       = queueCreateInfos.data(),
              .enabledExtensionCount   = static_cast<uint32_t>(requestedDeviceExtensions.size()),
              .ppEnabledExtensionNames = requestedDeviceExtensions.data()},
-            {.features {.samplerAnisotropy = true, .shaderInt64 = true}},
+            {.features {.multiDrawIndirect         = true,
+                        .drawIndirectFirstInstance = true,
+                        .samplerAnisotropy         = true,
+                        .textureCompressionBC      = _textureCompressionBC,
+                        .shaderInt64               = true}},
             {
-             .bufferDeviceAddress = true,
+             .drawIndirectCount                         = true,
+             .descriptorIndexing                        = true,
+             .shaderSampledImageArrayNonUniformIndexing = true,
+             .descriptorBindingSampledImageUpdateAfterBind = true,
+             .runtimeDescriptorArray                    = true,
+             .bufferDeviceAddress                       = true,
              },
             {
              .maintenance4 = true,
@@ -319,6 +448,9 @@ void Program::createDevice()
              },
             {
              .accelerationStructure = true,
+             },
+            {
+             .rayQuery = true,
              }
     };
 
@@ -326,12 +458,16 @@ void Program::createDevice()
     VULKAN_HPP_DEFAULT_DISPATCHER.init(*_device);
 
     _queue = _device->getQueue(_queueIndex, 0);
+    if (_transferQueueIndex)
+    {
+        _transferQueue = _device->getQueue(*_transferQueueIndex, 0);
+    }
 }
 
 void Program::createDescriptorSets()
 {
     std::array<vk::DescriptorPoolSize, 6> staticPoolSizes {
-        {{.type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = 128},
+        {{.type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = 256},
          {.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 128},
          {.type = vk::DescriptorType::eUniformBuffer, .descriptorCount = 128},
          {.type = vk::DescriptorType::eUniformBufferDynamic, .descriptorCount = 128},
@@ -341,19 +477,20 @@ void Program::createDescriptorSets()
 
     _staticDescriptorPool = _device->createDescriptorPoolUnique({
         .flags         = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-        .maxSets       = 128,
+        .maxSets       = 256,
         .poolSizeCount = static_cast<uint32_t>(staticPoolSizes.size()),
         .pPoolSizes    = staticPoolSizes.data(),
     });
 
     std::array<vk::DescriptorPoolSize, 1> texturePoolSizes {{{
         .type            = vk::DescriptorType::eCombinedImageSampler,
-        .descriptorCount = static_cast<uint32_t>(3 * _scene.GltfScene.m_materials.size()),
+        .descriptorCount = static_cast<uint32_t>(_scene.GltfScene.m_textures.size() + 2),
     }}};
 
     _textureDescriptorPool = _device->createDescriptorPoolUnique({
-        .flags         = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-        .maxSets       = static_cast<uint32_t>(_scene.GltfScene.m_materials.size()),
+        .flags         = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet |
+                         vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+        .maxSets       = 1,
         .poolSizeCount = static_cast<uint32_t>(texturePoolSizes.size()),
         .pPoolSizes    = texturePoolSizes.data(),
     });
@@ -367,8 +504,7 @@ void Program::createUniformBuffer()
         VMA_MEMORY_USAGE_CPU_TO_GPU);
 
     auto* restirUniforms = _restirUniformBuffer.mapAs<shader::RestirUniforms>();
-    restirUniforms->screenSize =
-        nvmath::uvec2(_swapchain.ScreenSize.width, _swapchain.ScreenSize.height);
+    restirUniforms->screenSize = nvmath::uvec2(_renderSize.width, _renderSize.height);
     restirUniforms->frame                  = 0;
     restirUniforms->spatialPosThreshold    = _positionThreshold;
     restirUniforms->spatialNormalThreshold = _normalThreshold;
@@ -383,6 +519,16 @@ void Program::createUniformBuffer()
     {
         restirUniforms->flags |= RESTIR_TEMPORAL_REUSE_FLAG;
     }
+
+    if (_enableUnbiasedReuse)
+    {
+        restirUniforms->flags |= RESTIR_UNBIASED_FLAG;
+    }
+
+    if (_enableGi)
+    {
+        restirUniforms->flags |= RESTIR_GI_FLAG;
+    }
     restirUniforms->spatialNeighbors = _spatialReuseNeighbourCount;
     restirUniforms->spatialRadius    = 30.0f;
     _restirUniformBuffer.unmap();
@@ -425,7 +571,7 @@ void Program::mainLoop()
         handleMovement();
 
         vk::Extent2D newWindowSize = getWindowSize();
-        if (needsResize || newWindowSize != windowSize)
+        if (needsResize || newWindowSize != windowSize || _renderScaleChanged)
         {
             //_device->waitIdle();
 
@@ -441,6 +587,8 @@ void Program::mainLoop()
             _swapchain.reset();
 
             _swapchain = Swapchain(*_device, _physicalDevice, *_surface, _window);
+            updateRenderSize();
+            _renderScaleChanged = false;
 
             currentFrame = 0;
 
@@ -448,15 +596,45 @@ void Program::mainLoop()
             {
                 concurrentFrameData.framebuffer.resize(_allocator,
                                                        *_device,
-                                                       _swapchain.ScreenSize,
+                                                       _renderSize,
                                                        _basePass,
                                                        _transientCommandBuffer);
             }
 
-            _basePass.onResized(*_device, _swapchain.ScreenSize);
+            _basePass.onResized(*_device, _renderSize);
+            _cullingPass.onResized(*_device,
+                                   _allocator,
+                                   _renderSize,
+                                   _framebufferData,
+                                   _transientCommandBuffer);
+            _previousDepthValid = false;
+
+            _denoisePass.onResized(*_device,
+                                   _allocator,
+                                   _renderSize,
+                                   _transientCommandBuffer);
+            _denoiserHistoryValid = false;
+
+            _accumulationPass.onResized(*_device,
+                                        _allocator,
+                                        _renderSize,
+                                        _transientCommandBuffer);
+
+            _upscalePass.onResized(*_device,
+                                   _allocator,
+                                   _swapchain.ScreenSize,
+                                   _transientCommandBuffer);
+            _upscaleHistoryValid = false;
+
+            _lightingPass.onResized(*_device, _allocator, _swapchain.ScreenSize);
+            _toneMappingPass.onResized(*_device,
+                                       _allocator,
+                                       _swapchain.ScreenSize,
+                                       _transientCommandBuffer);
+            _toneMappingPass.initializeDescriptorSet(*_device, _lightingPass.getHdrView());
 
             auto* restirUniforms       = _restirUniformBuffer.mapAs<shader::RestirUniforms>();
-            restirUniforms->screenSize = nvmath::uvec2(windowSize.width, windowSize.height);
+            restirUniforms->screenSize = nvmath::uvec2(_renderSize.width, _renderSize.height);
             restirUniforms->frame      = 0;
             _restirUniformBuffer.unmap();
             _restirUniformBuffer.flush();
@@ -474,6 +652,8 @@ void Program::mainLoop()
             _cameraUpdated = true;
         }
 
+        reloadShaders();
+
         std::chrono::high_resolution_clock::time_point now =
             std::chrono::high_resolution_clock::now();
 
@@ -504,70 +684,144 @@ void Program::mainLoop()
         {}
         _device->resetFences(*_mainFence);
 
+        _skinningPass.logTimings(*_device);
+
+        if (_enableAccumulation && _accumulatedSamples == _accumulationSaveSamples)
+        {
+            _accumulationPass.save(_allocator,
+                                   _transientCommandBuffer,
+                                   "accumulation_" + std::to_string(_accumulatedSamples) + ".hdr");
+        }
+
+        for (uint32_t texture : _textureStreamer.update(*_device,
+                                                        _allocator,
+                                                        _transientCommandBuffer,
+                                                        _basePass.TextureFeedback))
+        {
+            _basePass.updateTexture(*_device,
+                                    texture,
+                                    _scene.Textures[texture].getDescriptorInfo());
+            _settingsChanged = true;
+        }
+
+        // Halton (2, 3) over eight frames, centered on the pixel
+        const bool          upscale     = _renderSize != _swapchain.ScreenSize;
+        const nvmath::vec2f prevJitter  = _jitter;
+        const uint32_t      haltonIndex = _jitterIndex++ % 8 + 1;
+
+        _jitter = upscale ? nvmath::vec2f(halton(haltonIndex, 2), halton(haltonIndex, 3)) -
+                                nvmath::vec2f(0.5f, 0.5f)
+                          : nvmath::vec2f(0.0f, 0.0f);
+
+        _camera.Jitter = nvmath::vec2f(2.0f * _jitter.x / static_cast<float>(_renderSize.width),
+                                       2.0f * _jitter.y / static_cast<float>(_renderSize.height));
+        _camera.update();
+
+        // Only the main command buffer reads these, and it is done once the fence is signaled
+        auto* baseUniforms = _basePass.UniformBuffer.mapAs<BasePass::Uniforms>();
+        baseUniforms->projectionViewMatrix          = _camera.ProjectionViewMatrix;
+        baseUniforms->prevFrameProjectionViewMatrix = prevFrameProjectionView;
+        _basePass.UniformBuffer.unmap();
+        _basePass.UniformBuffer.flush();
+
         auto* restirUniforms = _restirUniformBuffer.mapAs<shader::RestirUniforms>();
         ++restirUniforms->frame;
         restirUniforms->lightSampleCount              = _lightSampleCount;
+        restirUniforms->projectionViewMatrix          = _camera.ProjectionViewMatrix;
         restirUniforms->prevFrameProjectionViewMatrix = prevFrameProjectionView;
         restirUniforms->temporalSampleCountMultiplier = _temporalReuseSampleMultiplier;
-
-        if (_enableTemporalReuse)
-        {
-            restirUniforms->flags |= RESTIR_TEMPORAL_REUSE_FLAG;
-        }
-        else
+        restirUniforms->spatialPosThreshold           = _positionThreshold;
+        restirUniforms->spatialNormalThreshold        = _normalThreshold;
+        restirUniforms->spatialNeighbors              = _spatialReuseNeighbourCount;
+        restirUniforms->sampleSequences               = 0;
+        for (int32_t dimension = 0; dimension < SAMPLE_DIMENSION_COUNT; ++dimension)
         {
-            restirUniforms->flags &= ~RESTIR_TEMPORAL_REUSE_FLAG;
+            restirUniforms->sampleSequences |= _sampleSequences[dimension]
+                                               << (SAMPLE_SEQUENCE_BITS * dimension);
         }
-
-        if (_cameraUpdated || _viewParamChanged)
+        restirUniforms->flags = (_enableVisibilityReuse ? RESTIR_VISIBILITY_REUSE_FLAG : 0) |
+                                (_enableTemporalReuse ? RESTIR_TEMPORAL_REUSE_FLAG : 0) |
+                                (_enableUnbiasedReuse ? RESTIR_UNBIASED_FLAG : 0) |
+                                (_enableGi ? RESTIR_GI_FLAG : 0) |
+                                (_enableAdaptiveCandidates ? RESTIR_ADAPTIVE_CANDIDATES_FLAG : 0) |
+                                (_enableDenoiser && _denoiserHistoryValid
+                                     ? RESTIR_DENOISE_HISTORY_FLAG
+                                     : 0);
+
+        _spatialReusePass.setIterationCount(_spatialReuseIterations, _renderSize);
+        _denoisePass.setEnabled(_enableDenoiser, _renderSize);
+
+        auto* cullingUniforms = _cullingPass.UniformBuffer.mapAs<shader::CullingUniforms>();
+        cullingUniforms->projectionViewMatrix          = _camera.ProjectionViewMatrix;
+        cullingUniforms->prevFrameProjectionViewMatrix = prevFrameProjectionView;
+        cullingUniforms->flags =
+            _enableOcclusionCulling && _previousDepthValid ? CULLING_OCCLUSION_FLAG : 0;
+        _cullingPass.UniformBuffer.unmap();
+        _cullingPass.UniformBuffer.flush();
+
+        bool resetAccumulation = _cameraUpdated || _viewParamChanged || _settingsChanged;
+        _settingsChanged       = false;
+
+        if (_cameraUpdated || _viewParamChanged || _cameraSettling)
         {
             _queue.waitIdle();
 
-            auto* uniforms                 = _basePass.UniformBuffer.mapAs<BasePass::Uniforms>();
-            uniforms->projectionViewMatrix = _camera.ProjectionViewMatrix;
-            _basePass.UniformBuffer.unmap();
-            _basePass.UniformBuffer.flush();
-
             restirUniforms->cameraPos = _camera.Position;
 
             auto* lightingPassUniforms =
                 _lightingPass.UniformBuffer.mapAs<shader::LightingPassUniforms>();
+            lightingPassUniforms->inverseProjectionViewMatrix =
+                nvmath::invert(_camera.ProjectionViewMatrix);
             lightingPassUniforms->cameraPos = _camera.Position;
-            lightingPassUniforms->bufferSize =
-                nvmath::uvec2(_swapchain.ScreenSize.width, _swapchain.ScreenSize.height);
-            lightingPassUniforms->gamma = _gamma;
+            lightingPassUniforms->bufferSize = nvmath::uvec2(_renderSize.width, _renderSize.height);
+            lightingPassUniforms->flags = (_enableDenoiser ? LIGHTING_DENOISE_FLAG : 0) |
+                                          (_enableAccumulation ? LIGHTING_ACCUMULATE_FLAG : 0) |
+                                          (upscale ? LIGHTING_UPSCALE_FLAG : 0);
             _lightingPass.UniformBuffer.unmap();
             _lightingPass.UniformBuffer.flush();
 
+            // The frame after the camera stops still needs its motion vectors zeroed
+            _cameraSettling   = _cameraUpdated;
             _cameraUpdated    = false;
             _viewParamChanged = false;
         }
-        else if (_renderPathChanged)
-        {
-            _device->waitIdle();
-            updateRestirBuffers();
-            recordMainCommandBuffers();
-            initializeLightingPassResources();
+        _restirUniformBuffer.unmap();
+        _restirUniformBuffer.flush();
 
-            restirUniforms->frame                  = 0;
-            restirUniforms->spatialPosThreshold    = _positionThreshold;
-            restirUniforms->spatialNormalThreshold = _normalThreshold;
-            restirUniforms->flags |= RESTIR_VISIBILITY_REUSE_FLAG;
+        // Skinned vertices, moved instances and the refitted acceleration structures have to be
+        // in place before culling and ReSTIR
+        _sceneUpdateCommandBuffer->begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        const bool skinned =
+            _skinningPass.issueCommands(*_device, *_sceneUpdateCommandBuffer, _scene);
+        const bool updated = _scene.recordUpdate(*_device, *_sceneUpdateCommandBuffer, skinned);
+        _sceneUpdateCommandBuffer->end();
 
-            _renderPathChanged = false;
+        if (resetAccumulation || skinned || updated)
+        {
+            _accumulatedSamples = 0;
         }
+        _accumulationPass.update(_enableAccumulation, _accumulatedSamples);
+        _upscalePass.update(upscale, _jitter, prevJitter, _renderSize, _upscaleHistoryValid);
 
-        _restirUniformBuffer.unmap();
-        _restirUniformBuffer.flush();
+        std::array<vk::CommandBuffer, 2> frameCommandBuffers {
+            *_sceneUpdateCommandBuffer,
+            *_framebufferData[currentFrame].MainCommandBuffer,
+        };
+        const uint32_t firstCommandBuffer = skinned || updated ? 0 : 1;
 
         _queue.submit(
             {
-                {.commandBufferCount = 1,
-                 .pCommandBuffers    = &*_framebufferData[currentFrame].MainCommandBuffer}
+                {.commandBufferCount = static_cast<uint32_t>(frameCommandBuffers.size()) -
+                                       firstCommandBuffer,
+                 .pCommandBuffers    = frameCommandBuffers.data() + firstCommandBuffer}
         },
             *_mainFence);
 
         prevFrameProjectionView = _camera.ProjectionViewMatrix;
+        _previousDepthValid     = true;
+        _denoiserHistoryValid   = _enableDenoiser;
+        _accumulatedSamples += _enableAccumulation ? 1 : 0;
+        _upscaleHistoryValid = upscale;
 
         while (_device->waitForFences({*_inFlightFences[currentPresentFrame]},
                                       true,
@@ -586,24 +840,33 @@ void Program::mainLoop()
         _device->resetFences({*_inFlightFences[currentPresentFrame]});
 
         vk::CommandBuffer commandBuffer = *_swapchainBuffers[imageIndex].commandBuffer;
-        vk::Framebuffer   frameBuffer   = *_swapchainBuffers[imageIndex].framebuffer;
 
         commandBuffer.begin(vk::CommandBufferBeginInfo());
 
-        ResourceManager::transitionImageLayout(commandBuffer,
-                                               _swapchain.Images[imageIndex],
-                                               _swapchain.ScreenFormat,
-                                               vk::ImageLayout::eUndefined,
-                                               vk::ImageLayout::eColorAttachmentOptimal);
-
         _lightingPass.issueCommands(commandBuffer,
-                                    frameBuffer,
                                     *_framebufferData[currentFrame].LightingPassDescriptorSet,
                                     _swapchain.ScreenSize);
 
+        // Luminance range of 2^-10 to 2^12
+        shader::ToneMappingConstants toneMappingConstants {
+            .minLogLuminance      = -10.0f,
+            .logLuminanceRange    = 22.0f,
+            .adaptation           = 1.0f - std::exp(-frameTime * _exposureAdaptationSpeed),
+            .exposureCompensation = _exposureCompensation,
+            .toneMappingOperator  = _toneMappingOperator,
+            .flags                = _enableAutoExposure ? TONE_MAPPING_AUTO_EXPOSURE_FLAG : 0,
+        };
+
+        _toneMappingPass.issueCommands(commandBuffer,
+                                       _swapchain.Images[imageIndex],
+                                       _swapchain.ScreenFormat,
+                                       _swapchain.ScreenSize,
+                                       toneMappingConstants);
+
         commandBuffer.end();
 
-        vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        // The swapchain image is first touched by the tone mapping pass's blit
+        vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eTransfer;
 
         _queue.submit(
             {
@@ -702,6 +965,9 @@ void Program::onKeyEvent(int key, int, int action, int)
 {
     if (action == GLFW_PRESS)
     {
+        // Any setting may change the image
+        _settingsChanged = true;
+
         switch (key)
         {
             case GLFW_KEY_Z: {
@@ -709,31 +975,122 @@ void Program::onKeyEvent(int key, int, int action, int)
                 break;
             }
 
+            case GLFW_KEY_C: {
+                _enableOcclusionCulling = !_enableOcclusionCulling;
+                std::cout << "Occlusion culling set to: " << _enableOcclusionCulling << std::endl;
+                break;
+            }
+
+            // Light selection, triangle point and spatial offset sequences
+            case GLFW_KEY_1:
+            case GLFW_KEY_2:
+            case GLFW_KEY_3: {
+                int32_t dimension = key - GLFW_KEY_1;
+                _sampleSequences[dimension] =
+                    (_sampleSequences[dimension] + 1) % SAMPLE_SEQUENCE_COUNT;
+                std::cout << "Sample sequence " << dimension
+                          << " set to: " << _sampleSequences[dimension] << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_I: {
+                _enableAdaptiveCandidates = !_enableAdaptiveCandidates;
+                std::cout << "Adaptive candidates set to: " << _enableAdaptiveCandidates
+                          << std::endl;
+                break;
+            }
+
             case GLFW_KEY_O: {
                 _lightSampleCount = std::clamp(_lightSampleCount >> 1, 1, 1024);
                 std::cout << "Initial Light Samples set to: " << _lightSampleCount << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
             case GLFW_KEY_P: {
                 _lightSampleCount = std::clamp(_lightSampleCount << 1, 1, 1024);
                 std::cout << "Initial Light Samples set to: " << _lightSampleCount << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
             case GLFW_KEY_T: {
                 _enableTemporalReuse = !_enableTemporalReuse;
                 std::cout << "Temporal reuse set to: " << _enableTemporalReuse << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
             case GLFW_KEY_V: {
                 _enableVisibilityReuse = !_enableVisibilityReuse;
                 std::cout << "Visibility reuse set to: " << _enableVisibilityReuse << std::endl;
-                _renderPathChanged = true;
+                break;
+            }
+
+            case GLFW_KEY_B: {
+                _enableUnbiasedReuse = !_enableUnbiasedReuse;
+                std::cout << "Unbiased reuse set to: " << _enableUnbiasedReuse << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_G: {
+                _enableGi = !_enableGi;
+                std::cout << "GI set to: " << _enableGi << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_F: {
+                _enableDenoiser   = !_enableDenoiser;
+                _viewParamChanged = true;
+                std::cout << "Denoiser set to: " << _enableDenoiser << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_X: {
+                _renderScaleIndex   = (_renderScaleIndex + 1) % RenderScales.size();
+                _renderScaleChanged = true;
+                std::cout << "Render scale set to: " << RenderScales[_renderScaleIndex]
+                          << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_L: {
+                _toneMappingOperator = (_toneMappingOperator + 1) % TONE_MAPPING_OPERATOR_COUNT;
+                std::cout << "Tone mapping operator set to: " << _toneMappingOperator
+                          << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_E: {
+                _enableAutoExposure = !_enableAutoExposure;
+                std::cout << "Auto exposure set to: " << _enableAutoExposure << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_LEFT_BRACKET: {
+                _exposureCompensation = std::clamp(_exposureCompensation - 0.5f, -10.0f, 10.0f);
+                std::cout << "Exposure compensation set to: " << _exposureCompensation
+                          << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_RIGHT_BRACKET: {
+                _exposureCompensation = std::clamp(_exposureCompensation + 0.5f, -10.0f, 10.0f);
+                std::cout << "Exposure compensation set to: " << _exposureCompensation
+                          << std::endl;
+                break;
+            }
+
+            case GLFW_KEY_R: {
+                // The presenting command buffers draw into the HDR target
+                _queue.waitIdle();
+                _lightingPass.save(_allocator,
+                                   _transientCommandBuffer,
+                                   "frame_" + std::to_string(_savedFrames++) + ".hdr");
+                break;
+            }
+
+            case GLFW_KEY_K: {
+                _enableAccumulation = !_enableAccumulation;
+                _viewParamChanged   = true;
+                std::cout << "Accumulation set to: " << _enableAccumulation << std::endl;
                 break;
             }
 
@@ -741,7 +1098,6 @@ void Program::onKeyEvent(int key, int, int action, int)
                 _spatialReuseNeighbourCount = std::clamp(_spatialReuseNeighbourCount - 1, 1, 100);
                 std::cout << "Spatial reuse neighbour count set to: " << _spatialReuseNeighbourCount
                           << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
@@ -749,7 +1105,6 @@ void Program::onKeyEvent(int key, int, int action, int)
                 _spatialReuseNeighbourCount = std::clamp(_spatialReuseNeighbourCount + 1, 1, 100);
                 std::cout << "Spatial reuse neighbour count set to: " << _spatialReuseNeighbourCount
                           << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
@@ -770,46 +1125,44 @@ void Program::onKeyEvent(int key, int, int action, int)
             }
 
             case GLFW_KEY_H: {
-                _spatialReuseIterations = std::clamp(_spatialReuseIterations - 1, 0, 10);
+                _spatialReuseIterations = std::clamp(_spatialReuseIterations - 1,
+                                                     0,
+                                                     SpatialReusePass::MaxIterations);
                 std::cout << "Spatial reuse iterations set to: " << _spatialReuseIterations
                           << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
             case GLFW_KEY_J: {
-                _spatialReuseIterations = std::clamp(_spatialReuseIterations + 1, 0, 10);
+                _spatialReuseIterations = std::clamp(_spatialReuseIterations + 1,
+                                                     0,
+                                                     SpatialReusePass::MaxIterations);
                 std::cout << "Spatial reuse iterations set to: " << _spatialReuseIterations
                           << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
             case GLFW_KEY_N: {
                 _positionThreshold = std::clamp(_positionThreshold - 0.1f, 0.0f, 1.0f);
                 std::cout << "Depth threshold set to: " << _positionThreshold << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
             case GLFW_KEY_M: {
                 _positionThreshold = std::clamp(_positionThreshold + 0.1f, 0.0f, 1.0f);
                 std::cout << "Depth threshold set to: " << _positionThreshold << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
             case GLFW_KEY_COMMA: {
                 _normalThreshold = std::clamp(_normalThreshold - 5.0f, 5.0f, 45.0f);
                 std::cout << "Normal threshold set to: " << _normalThreshold << std::endl;
-                _renderPathChanged = true;
                 break;
             }
 
             case GLFW_KEY_PERIOD: {
                 _normalThreshold = std::clamp(_normalThreshold + 5.0f, 5.0f, 45.0f);
                 std::cout << "Normal threshold set to: " << _normalThreshold << std::endl;
-                _renderPathChanged = true;
                 break;
             }
         }
@@ -840,11 +1193,20 @@ vk::Extent2D Program::getWindowSize()
     return {.width = static_cast<uint32_t>(width), .height = static_cast<uint32_t>(height)};
 }
 
+void Program::updateRenderSize()
+{
+    const float scale = RenderScales[_renderScaleIndex];
+
+    _renderSize = {
+        .width  = std::max(static_cast<uint32_t>(_swapchain.ScreenSize.width * scale), 1u),
+        .height = std::max(static_cast<uint32_t>(_swapchain.ScreenSize.height * scale), 1u),
+    };
+}
+
 void Program::createSwapchainBuffers()
 {
     _swapchainBuffers.clear();
-    _swapchainBuffers =
-        _swapchain.getBuffers(*_device, *_lightingPass.RenderPass, *_commandPool, _allocator);
+    _swapchainBuffers = _swapchain.getBuffers(*_device, *_commandPool);
 }
 
 void Program::recordMainCommandBuffers()
@@ -854,28 +1216,59 @@ void Program::recordMainCommandBuffers()
         vk::CommandBufferBeginInfo beginInfo;
         concurrentFameData.MainCommandBuffer->begin(beginInfo);
 
+        _cullingPass.issueCommands(*concurrentFameData.MainCommandBuffer,
+                                   *concurrentFameData.HiZSeedDescriptor);
+
         _basePass.issueCommands(*concurrentFameData.MainCommandBuffer,
-                                *concurrentFameData.framebuffer.UniqueFramebuffer);
+                                *concurrentFameData.framebuffer.UniqueFramebuffer,
+                                *_cullingPass.VisibleDrawCommands,
+                                _cullingPass.DrawCount);
 
         _restirPass.issueCommands(*concurrentFameData.MainCommandBuffer,
                                   *concurrentFameData.RestirFrameDescriptor,
-                                  _swapchain.ScreenSize);
+                                  _basePass.getTextureDescriptorSet(),
+                                  *concurrentFameData.CandidateBudgetBuffer,
+                                  _renderSize);
 
-        for (int32_t i = 0; i < _spatialReuseIterations; ++i)
+        // Every possible iteration is recorded, the ones past the current count dispatch nothing
+        for (int32_t i = 0; i < SpatialReusePass::MaxIterations; ++i)
         {
             _spatialReusePass.issueCommands(*concurrentFameData.MainCommandBuffer,
                                             *concurrentFameData.SpatialReuseDescriptor,
-                                            _swapchain.ScreenSize);
+                                            _basePass.getTextureDescriptorSet(),
+                                            i);
         }
 
+        _giPass.issueCommands(*concurrentFameData.MainCommandBuffer,
+                              *_restirPass.RestirStaticDescriptor,
+                              *concurrentFameData.GiFrameDescriptor,
+                              *concurrentFameData.GiSpatialReuseDescriptor,
+                              _basePass.getTextureDescriptorSet(),
+                              _renderSize);
+
+        _denoisePass.issueCommands(*concurrentFameData.MainCommandBuffer,
+                                   *_restirPass.RestirStaticDescriptor,
+                                   *concurrentFameData.DenoiseShadeDescriptor,
+                                   *concurrentFameData.DenoiseTemporalDescriptor,
+                                   concurrentFameData.DenoiseAtrousDescriptors,
+                                   _renderSize);
+
+        _accumulationPass.issueCommands(*concurrentFameData.MainCommandBuffer,
+                                        *concurrentFameData.AccumulationDescriptor);
+
+        _upscalePass.issueCommands(*concurrentFameData.MainCommandBuffer,
+                                   *concurrentFameData.UpscaleDescriptor);
+
         concurrentFameData.MainCommandBuffer->end();
     }
 }
 
 void Program::updateRestirBuffers()
 {
-    uint32_t       numPixels           = _swapchain.ScreenSize.width * _swapchain.ScreenSize.height;
+    uint32_t       numPixels           = _renderSize.width * _renderSize.height;
     vk::DeviceSize reservoirBufferSize = numPixels * sizeof(shader::Reservoir);
+
+    vk::DeviceSize giReservoirBufferSize = numPixels * sizeof(shader::GiReservoir);
     {
         _transientCommandBuffer.begin();
 
@@ -889,6 +1282,26 @@ void Program::updateRestirBuffers()
                                                 0,
                                                 VK_WHOLE_SIZE,
                                                 0);
+
+            concurrentFameData.GiReservoirBuffer =
+                _allocator.createTypedBuffer<shader::GiReservoir>(
+                    numPixels,
+                    vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                    VMA_MEMORY_USAGE_GPU_ONLY);
+            _transientCommandBuffer->fillBuffer(*concurrentFameData.GiReservoirBuffer,
+                                                0,
+                                                VK_WHOLE_SIZE,
+                                                0);
+
+            concurrentFameData.CandidateBudgetBuffer =
+                _allocator.createTypedBuffer<shader::CandidateBudget>(
+                    1,
+                    vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                    VMA_MEMORY_USAGE_GPU_ONLY);
+            _transientCommandBuffer->fillBuffer(*concurrentFameData.CandidateBudgetBuffer,
+                                                0,
+                                                VK_WHOLE_SIZE,
+                                                0);
         }
 
         _reservoirTemporaryBuffer = _allocator.createTypedBuffer<shader::Reservoir>(
@@ -897,6 +1310,12 @@ void Program::updateRestirBuffers()
             VMA_MEMORY_USAGE_GPU_ONLY);
         _transientCommandBuffer->fillBuffer(*_reservoirTemporaryBuffer, 0, VK_WHOLE_SIZE, 0);
 
+        _giSpatialReservoirBuffer = _allocator.createTypedBuffer<shader::GiReservoir>(
+            numPixels,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            VMA_MEMORY_USAGE_GPU_ONLY);
+        _transientCommandBuffer->fillBuffer(*_giSpatialReservoirBuffer, 0, VK_WHOLE_SIZE, 0);
+
         _transientCommandBuffer.submitAndWait();
     }
 
@@ -913,43 +1332,169 @@ void Program::updateRestirBuffers()
             *_framebufferData[i].ReservoirBuffer,
             *_framebufferData[(i - 1) % FRAMEBUFFER_COUNT].ReservoirBuffer,
             reservoirBufferSize,
+            *_framebufferData[i].CandidateBudgetBuffer,
+            *_framebufferData[(i - 1) % FRAMEBUFFER_COUNT].CandidateBudgetBuffer,
             *_device,
             *_framebufferData[i].RestirFrameDescriptor);
 
         _spatialReusePass.initializeDescriptorSetFor(
             _framebufferData[i].framebuffer,
+            _scene,
             *_restirUniformBuffer,
             *_framebufferData[i].ReservoirBuffer,
             reservoirBufferSize,
             *_framebufferData[(i + FRAMEBUFFER_COUNT - 1) % FRAMEBUFFER_COUNT].ReservoirBuffer,
+            _restirPass.getBlueNoiseView(),
             *_device,
             *_framebufferData[i].SpatialReuseDescriptor);
 
         _spatialReusePass.initializeDescriptorSetFor(
             _framebufferData[i].framebuffer,
+            _scene,
             *_restirUniformBuffer,
             *_framebufferData[(i + FRAMEBUFFER_COUNT - 1) % FRAMEBUFFER_COUNT].ReservoirBuffer,
             reservoirBufferSize,
             *_framebufferData[i].ReservoirBuffer,
+            _restirPass.getBlueNoiseView(),
             *_device,
             *_framebufferData[i].SpatialReuseSecondDescriptor);
+
+        _giPass.initializeFrameDescriptorSetFor(
+            _framebufferData[i].framebuffer,
+            _framebufferData[(i + FRAMEBUFFER_COUNT - 1) % FRAMEBUFFER_COUNT].framebuffer,
+            *_framebufferData[i].ReservoirBuffer,
+            reservoirBufferSize,
+            *_framebufferData[i].GiReservoirBuffer,
+            *_framebufferData[(i + FRAMEBUFFER_COUNT - 1) % FRAMEBUFFER_COUNT].GiReservoirBuffer,
+            giReservoirBufferSize,
+            *_device,
+            *_framebufferData[i].GiFrameDescriptor);
+
+        _giPass.initializeSpatialReuseDescriptorSetFor(
+            _framebufferData[i].framebuffer,
+            _scene,
+            *_restirUniformBuffer,
+            *_framebufferData[i].GiReservoirBuffer,
+            *_giSpatialReservoirBuffer,
+            giReservoirBufferSize,
+            *_device,
+            *_framebufferData[i].GiSpatialReuseDescriptor);
     }
+
+    _denoisePass.initializeDescriptorSets(*_device,
+                                          _framebufferData,
+                                          reservoirBufferSize,
+                                          *_giSpatialReservoirBuffer,
+                                          giReservoirBufferSize);
 }
 
 void Program::initializeLightingPassResources()
 {
-    uint32_t       pixelCount          = _swapchain.ScreenSize.width * _swapchain.ScreenSize.height;
-    vk::DeviceSize reservoirBufferSize = pixelCount * sizeof(shader::Reservoir);
-    for (FramebufferData& concurrentFameData : _framebufferData)
+    for (uint32_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
     {
+        FramebufferData& concurrentFameData = _framebufferData[i];
+
         _lightingPass.initializeDescriptorSetFor(concurrentFameData.framebuffer,
                                                  _scene,
                                                  *_lightingPass.UniformBuffer,
-                                                 *concurrentFameData.ReservoirBuffer,
-                                                 reservoirBufferSize,
+                                                 _denoisePass.getIlluminationView(),
+                                                 _denoisePass.getDenoisedIlluminationView(),
+                                                 _accumulationPass.getAccumulatedView(),
+                                                 _upscalePass.getUpscaledView(i),
                                                  *_device,
                                                  *concurrentFameData.LightingPassDescriptorSet);
+
+        _accumulationPass.initializeDescriptorSetFor(concurrentFameData.framebuffer,
+                                                     _scene,
+                                                     *_lightingPass.UniformBuffer,
+                                                     _denoisePass.getIlluminationView(),
+                                                     *_device,
+                                                     *concurrentFameData.AccumulationDescriptor);
+    }
+
+    _upscalePass.initializeDescriptorSets(*_device,
+                                          _framebufferData,
+                                          _scene,
+                                          *_lightingPass.UniformBuffer,
+                                          _denoisePass.getIlluminationView(),
+                                          _denoisePass.getDenoisedIlluminationView());
+}
+
+void Program::reloadShaders()
+{
+#ifdef ENABLE_SHADER_HOT_RELOAD
+    std::vector<std::string> shaders = _shaderHotReload.poll();
+    if (shaders.empty())
+    {
+        return;
+    }
+
+    bool reloadBase         = false;
+    bool reloadRestir       = false;
+    bool reloadSpatialReuse = false;
+    bool reloadLighting     = false;
+    bool reloadGi           = false;
+    bool reloadDenoise      = false;
+    bool reloadAccumulation = false;
+    bool reloadUpscale      = false;
+    bool reloadToneMapping  = false;
+    for (const std::string& shader : shaders)
+    {
+        reloadBase |= shader.starts_with("base.");
+        reloadRestir |= shader.starts_with("restir.") || shader.starts_with("visibility.");
+        reloadSpatialReuse |= shader.starts_with("spatialReuse.");
+        reloadLighting |= shader.starts_with("lighting.");
+        reloadGi |= shader.starts_with("gi") || shader.starts_with("visibility.");
+        reloadDenoise |= shader.starts_with("denoise");
+        reloadAccumulation |= shader.starts_with("accumulate.");
+        reloadUpscale |= shader.starts_with("upscale.");
+        reloadToneMapping |= shader.starts_with("toneMap");
+    }
+
+    // Only pipelines are replaced, the scene and acceleration structures stay resident
+    _device->waitIdle();
+
+    if (reloadBase)
+    {
+        _basePass.reloadShaders(*_device);
+    }
+    if (reloadRestir)
+    {
+        _restirPass.reloadShaders(*_device, _physicalDevice, _allocator);
+    }
+    if (reloadSpatialReuse)
+    {
+        _spatialReusePass.reloadShaders(*_device);
+    }
+    if (reloadLighting)
+    {
+        _lightingPass.reloadShaders(*_device);
+    }
+    if (reloadGi)
+    {
+        _giPass.reloadShaders(*_device, _physicalDevice, _allocator);
+    }
+    if (reloadDenoise)
+    {
+        _denoisePass.reloadShaders(*_device);
+    }
+    if (reloadAccumulation)
+    {
+        _accumulationPass.reloadShaders(*_device);
     }
+    if (reloadUpscale)
+    {
+        _upscalePass.reloadShaders(*_device);
+    }
+    if (reloadToneMapping)
+    {
+        _toneMappingPass.reloadShaders(*_device);
+    }
+
+    recordMainCommandBuffers();
+
+    std::cout << "Reloaded " << shaders.size() << " shader(s)" << std::endl;
+#endif
 }
 
 void Program::handleMovement()
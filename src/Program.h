@@ -3,20 +3,32 @@
 #include "Camera.h"
 #include "ResourceManager.h"
 #include "Scene.h"
+#include "ShaderHotReload.h"
 #include "Swapchain.h"
+#include "TextureStreamer.h"
 #include "TransientCommandBuffer.h"
 
+#include "passes/AccumulationPass.h"
 #include "passes/BasePass.h"
+#include "passes/CullingPass.h"
+#include "passes/DenoisePass.h"
+#include "passes/GiPass.h"
 #include "passes/LightingPass.h"
 #include "passes/RestirPass.h"
+#include "passes/SkinningPass.h"
 #include "passes/SpatialReusePass.h"
+#include "passes/ToneMappingPass.h"
+#include "passes/UpscalePass.h"
 
 #include "Structs.h"
 
 class Program
 {
 public:
-    Program(const std::string& scene, uint32_t pointLightCount);
+    Program(const std::string& scene,
+            uint32_t           pointLightCount,
+            vk::DeviceSize     textureBudget,
+            const std::string& environment);
     ~Program();
 
     void mainLoop();
@@ -39,9 +51,13 @@ private:
 
     Camera _camera;
 
-    uint32_t _queueIndex = 0;
+    uint32_t                _queueIndex = 0;
+    std::optional<uint32_t> _transferQueueIndex;
 
     vk::Queue _queue;
+    vk::Queue _transferQueue;
+
+    bool _textureCompressionBC = false;
 
     vk::DynamicLoader _loader;
 
@@ -66,13 +82,30 @@ private:
 
     UniqueBuffer _restirUniformBuffer;
     UniqueBuffer _reservoirTemporaryBuffer;
+    UniqueBuffer _giSpatialReservoirBuffer;
 
     BasePass          _basePass;
+    CullingPass       _cullingPass;
     RestirPass        _restirPass;
     SpatialReusePass  _spatialReusePass;
+    GiPass            _giPass;
+    DenoisePass       _denoisePass;
+    AccumulationPass  _accumulationPass;
+    UpscalePass       _upscalePass;
     LightingPass      _lightingPass;
+    ToneMappingPass   _toneMappingPass;
+    SkinningPass      _skinningPass;
+
+    Scene           _scene;
+    TextureStreamer _textureStreamer;
+
+#ifdef ENABLE_SHADER_HOT_RELOAD
+    ShaderHotReload _shaderHotReload;
+#endif
 
-    Scene _scene;
+    // Skinning and scene node updates, submitted ahead of the main command buffer on frames that
+    // have any
+    vk::UniqueCommandBuffer _sceneUpdateCommandBuffer;
 
     std::vector<vk::UniqueSemaphore> _imageAvailableSemaphore;
     std::vector<vk::UniqueSemaphore> _renderFinishedSemaphore;
@@ -84,6 +117,41 @@ private:
     int32_t _lightSampleCount      = 32;
     bool    _enableVisibilityReuse = true;
     bool    _enableTemporalReuse   = true;
+    bool    _enableUnbiasedReuse   = false;
+    bool    _enableGi              = true;
+
+    // _lightSampleCount is then the average over the covered pixels
+    bool _enableAdaptiveCandidates = false;
+
+    // Indexed by SAMPLE_DIMENSION_*
+    std::array<int32_t, SAMPLE_DIMENSION_COUNT> _sampleSequences {SAMPLE_SEQUENCE_BLUE_NOISE,
+                                                                  SAMPLE_SEQUENCE_SOBOL,
+                                                                  SAMPLE_SEQUENCE_BLUE_NOISE};
+
+    bool _enableOcclusionCulling = true;
+    bool _previousDepthValid     = false;
+
+    // The history is only reprojected when the denoiser ran the frame before
+    bool _enableDenoiser       = false;
+    bool _denoiserHistoryValid = false;
+
+    // While the camera stands still frames are averaged, the result is saved once it has
+    // _accumulationSaveSamples of them. Key presses, scene updates and texture uploads restart it.
+    bool     _enableAccumulation      = false;
+    bool     _settingsChanged         = false;
+    uint32_t _accumulatedSamples      = 0;
+    uint32_t _accumulationSaveSamples = 1024;
+
+    // Everything before the lighting pass renders at a fraction of the window. Below full
+    // resolution the projection is jittered, in render pixels, and the upscaler rebuilds the rest.
+    static constexpr std::array<float, 3> RenderScales {1.0f, 0.67f, 0.5f};
+
+    std::size_t   _renderScaleIndex    = 0;
+    bool          _renderScaleChanged  = false;
+    vk::Extent2D  _renderSize;
+    uint32_t      _jitterIndex         = 0;
+    nvmath::vec2f _jitter              = {0.0f, 0.0f};
+    bool          _upscaleHistoryValid = false;
 
     int32_t _temporalReuseSampleMultiplier = 20;
 
@@ -92,10 +160,14 @@ private:
     float   _positionThreshold          = 0.1f;
     float   _normalThreshold            = 25.0f;
 
-    float _gamma = 1.1f;
+    // Exposure compensation is in stops, the adaptation speed is per second
+    int32_t  _toneMappingOperator     = TONE_MAPPING_ACES;
+    bool     _enableAutoExposure      = true;
+    float    _exposureCompensation    = 0.0f;
+    float    _exposureAdaptationSpeed = 1.5f;
+    uint32_t _savedFrames             = 0;
 
-    bool _viewParamChanged  = false;
-    bool _renderPathChanged = false;
+    bool _viewParamChanged = false;
 
     bool _disableMouse = false;
 
@@ -108,6 +180,7 @@ private:
     nvmath::vec2f _lastMouse;
     int32_t       _pressedMouseButton = -1;
     bool          _cameraUpdated      = true;
+    bool          _cameraSettling     = false;
 
     static void _onMouseMoveEvent(GLFWwindow* window, double x, double y);
     static void _onMouseButtonEvent(GLFWwindow* window, int button, int action, int mods);
@@ -118,11 +191,13 @@ private:
     void onKeyEvent(int key, int scancode, int action, int mods);
 
     vk::Extent2D getWindowSize();
+    void         updateRenderSize();
 
     void createSwapchainBuffers();
     void recordMainCommandBuffers();
     void updateRestirBuffers();
     void initializeLightingPassResources();
+    void reloadShaders();
 
     void handleMovement();
 
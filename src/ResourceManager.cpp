@@ -3,10 +3,39 @@
 #include <vk_mem_alloc.h>
 
 #include "ResourceManager.h"
+#include "TextureCompressor.h"
 #include "TransientCommandBuffer.h"
 
+#include <stb_image_write.h>
+
+#include <bit>
+#include <cmath>
 #include <fstream>
 
+namespace
+{
+float halfToFloat(uint16_t value)
+{
+    uint32_t sign     = static_cast<uint32_t>(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x03FFu;
+
+    if (exponent == 0x1Fu)
+    {
+        return std::bit_cast<float>(sign | 0x7F800000u | (mantissa << 13));
+    }
+
+    // Subnormal halves are normal floats
+    if (exponent == 0)
+    {
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+
+    return std::bit_cast<float>(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+}
+} // namespace
+
 vk::DeviceMemory UniqueBuffer::getMemory()
 {
     return _allocation->GetMemory();
@@ -89,6 +118,98 @@ ResourceManager::createBuffer(uint32_t size, vk::BufferUsageFlags usage, VmaMemo
         });
 }
 
+UniqueBuffer ResourceManager::createStaticBuffer(const void*             data,
+                                                 vk::DeviceSize          size,
+                                                 vk::BufferUsageFlags    usage,
+                                                 TransientCommandBuffer& transientCommandBuffer)
+{
+    return createStaticBuffer(size, usage, transientCommandBuffer, [data, size](void* mapped) {
+        std::memcpy(mapped, data, static_cast<std::size_t>(size));
+    });
+}
+
+UniqueBuffer
+ResourceManager::createStaticBuffer(vk::DeviceSize                    size,
+                                    vk::BufferUsageFlags              usage,
+                                    TransientCommandBuffer&           transientCommandBuffer,
+                                    const std::function<void(void*)>& fill)
+{
+    UniqueBuffer staging = createBuffer(
+        {
+            .size        = size,
+            .usage       = vk::BufferUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive,
+        },
+        {.usage = VMA_MEMORY_USAGE_CPU_ONLY});
+
+    fill(staging.map());
+    staging.unmap();
+    staging.flush();
+
+    // A dedicated transfer queue lives in its own family, so the result is shared with it rather
+    // than handed over with ownership transfer barriers
+    const std::vector<uint32_t>& sharedQueues = transientCommandBuffer.getSharedQueueFamilies();
+
+    vk::BufferCreateInfo bufferInfo {
+        .size        = size,
+        .usage       = usage | vk::BufferUsageFlagBits::eTransferDst,
+        .sharingMode = vk::SharingMode::eExclusive,
+    };
+    if (!sharedQueues.empty())
+    {
+        bufferInfo.setSharingMode(vk::SharingMode::eConcurrent).setQueueFamilyIndices(sharedQueues);
+    }
+
+    UniqueBuffer result = createBuffer(bufferInfo, {.usage = VMA_MEMORY_USAGE_GPU_ONLY});
+
+    vk::BufferCopy region {.size = size};
+
+    transientCommandBuffer.begin(TransientCommandBuffer::Lane::Transfer);
+    transientCommandBuffer->copyBuffer(*staging, *result, region);
+    transientCommandBuffer.retain(std::move(staging));
+    transientCommandBuffer.submit();
+
+    return result;
+}
+
+UniqueBuffer ResourceManager::createStagingBuffer(const void* data, vk::DeviceSize size)
+{
+    UniqueBuffer staging = createBuffer(
+        {
+            .size        = size,
+            .usage       = vk::BufferUsageFlagBits::eTransferSrc,
+            .sharingMode = vk::SharingMode::eExclusive,
+        },
+        {.usage = VMA_MEMORY_USAGE_CPU_ONLY});
+
+    void* mapped = staging.map();
+    std::memcpy(mapped, data, static_cast<std::size_t>(size));
+    staging.unmap();
+    staging.flush();
+
+    return staging;
+}
+
+void ResourceManager::logHeapUsage() const
+{
+    const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+    vmaGetMemoryProperties(_allocator, &memoryProperties);
+
+    std::vector<VmaBudget> budgets(memoryProperties->memoryHeapCount);
+    vmaGetHeapBudgets(_allocator, budgets.data());
+
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i)
+    {
+        bool deviceLocal =
+            (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+        std::cout << "Memory heap " << i << (deviceLocal ? " (device local): " : " (host): ")
+                  << budgets[i].statistics.allocationBytes << " bytes in "
+                  << budgets[i].statistics.allocationCount << " allocations, "
+                  << budgets[i].statistics.blockBytes << " bytes reserved" << std::endl;
+    }
+}
+
 UniqueImage ResourceManager::createImage(const vk::ImageCreateInfo&     createImageInfoIn,
                                          const VmaAllocationCreateInfo& allocationInfo)
 {
@@ -148,12 +269,14 @@ vk::UniqueImageView ResourceManager::createImageView2D(vk::Device           devi
                                                        uint32_t             baseMipLevel,
                                                        uint32_t             mipLevelCount,
                                                        uint32_t             baseArrayLayer,
-                                                       uint32_t             arrayLayerCount)
+                                                       uint32_t             arrayLayerCount,
+                                                       vk::ComponentMapping components)
 {
     return device.createImageViewUnique({
-        .image    = image,
-        .viewType = vk::ImageViewType::e2D,
-        .format   = format,
+        .image      = image,
+        .viewType   = vk::ImageViewType::e2D,
+        .format     = format,
+        .components = components,
         .subresourceRange =
             {
                                .aspectMask     = aspect,
@@ -358,17 +481,11 @@ UniqueImage ResourceManager::loadTexture(const unsigned char*    data,
                                          vk::Format              format,
                                          uint32_t                mipLevels,
                                          ResourceManager&        allocator,
-                                         TransientCommandBuffer& transientCommandBuffer)
+                                         TransientCommandBuffer& transientCommandBuffer,
+                                         uint32_t                texelSize)
 {
     UniqueBuffer buffer =
-        allocator.createTypedBuffer<unsigned char>(width * height * 4,
-                                                   vk::BufferUsageFlagBits::eTransferSrc,
-                                                   VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-    void* bufferData = buffer.map();
-    std::memcpy(bufferData, data, sizeof(unsigned char) * width * height * 4);
-    buffer.unmap();
-    buffer.flush();
+        allocator.createStagingBuffer(data, sizeof(unsigned char) * width * height * texelSize);
 
     vk::ImageUsageFlags usageFlags =
         vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
@@ -493,11 +610,92 @@ UniqueImage ResourceManager::loadTexture(const unsigned char*    data,
                               mipLevels);
     }
 
-    transientCommandBuffer.submitAndWait();
+    transientCommandBuffer.retain(std::move(buffer));
+    transientCommandBuffer.submit();
+
+    return image;
+}
+
+UniqueImage ResourceManager::loadCompressedTexture(const CompressedTexture& texture,
+                                                   uint32_t                 baseMip,
+                                                   ResourceManager&         allocator,
+                                                   TransientCommandBuffer&  transientCommandBuffer)
+{
+    UniqueBuffer buffer =
+        allocator.createStagingBuffer(texture.Data.data() + texture.MipOffsets[baseMip],
+                                      texture.Data.size() - texture.MipOffsets[baseMip]);
+
+    UniqueImage image = createMipChainImage(texture, baseMip, allocator);
+
+    transientCommandBuffer.begin();
+    copyMipChain(*transientCommandBuffer, *buffer, *image, texture, baseMip);
+    transientCommandBuffer.retain(std::move(buffer));
+    transientCommandBuffer.submit();
 
     return image;
 }
 
+UniqueImage ResourceManager::createMipChainImage(const CompressedTexture& texture,
+                                                 uint32_t                 baseMip,
+                                                 ResourceManager&         allocator)
+{
+    return allocator.createImage2D({.width  = std::max(texture.Size.width >> baseMip, 1u),
+                                    .height = std::max(texture.Size.height >> baseMip, 1u)},
+                                   texture.Format,
+                                   vk::ImageUsageFlagBits::eSampled |
+                                       vk::ImageUsageFlagBits::eTransferDst,
+                                   VMA_MEMORY_USAGE_GPU_ONLY,
+                                   vk::ImageTiling::eOptimal,
+                                   vk::ImageLayout::eUndefined,
+                                   texture.MipLevels - baseMip);
+}
+
+void ResourceManager::copyMipChain(vk::CommandBuffer        commandBuffer,
+                                   vk::Buffer               staging,
+                                   vk::Image                image,
+                                   const CompressedTexture& texture,
+                                   uint32_t                 baseMip)
+{
+    const uint32_t levelCount = texture.MipLevels - baseMip;
+
+    std::vector<vk::BufferImageCopy> regions(levelCount);
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        const uint32_t level = baseMip + i;
+
+        regions[i] = {
+            .bufferOffset     = texture.MipOffsets[level] - texture.MipOffsets[baseMip],
+            .imageSubresource = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                 .mipLevel       = i,
+                                 .baseArrayLayer = 0,
+                                 .layerCount     = 1},
+            .imageExtent      = {
+                                 .width  = std::max(texture.Size.width >> level, 1u),
+                                 .height = std::max(texture.Size.height >> level, 1u),
+                                 .depth  = 1,
+                                 }
+        };
+    }
+
+    transitionImageLayout(commandBuffer,
+                          image,
+                          texture.Format,
+                          vk::ImageLayout::eUndefined,
+                          vk::ImageLayout::eTransferDstOptimal,
+                          0,
+                          levelCount);
+
+    commandBuffer.copyBufferToImage(staging, image, vk::ImageLayout::eTransferDstOptimal, regions);
+
+    transitionImageLayout(commandBuffer,
+                          image,
+                          texture.Format,
+                          vk::ImageLayout::eTransferDstOptimal,
+                          vk::ImageLayout::eShaderReadOnlyOptimal,
+                          0,
+                          levelCount);
+}
+
 UniqueImage ResourceManager::loadTexture(const tinygltf::Image&  gltfImage,
                                          vk::Format              format,
                                          uint32_t                mipLevels,
@@ -513,6 +711,83 @@ UniqueImage ResourceManager::loadTexture(const tinygltf::Image&  gltfImage,
                        transientCommandBuffer);
 }
 
+void ResourceManager::saveImageHdr(vk::Image               image,
+                                   vk::Format              format,
+                                   vk::Extent2D            size,
+                                   vk::PipelineStageFlags  srcStage,
+                                   vk::AccessFlags         srcAccess,
+                                   ResourceManager&        allocator,
+                                   TransientCommandBuffer& transientCommandBuffer,
+                                   const std::string&      filename)
+{
+    assert(format == vk::Format::eR16G16B16A16Sfloat || format == vk::Format::eR32G32B32A32Sfloat);
+
+    const bool        halfFloat    = format == vk::Format::eR16G16B16A16Sfloat;
+    const std::size_t channelCount = std::size_t(size.width) * size.height * 4;
+
+    UniqueBuffer readback = allocator.createBuffer(
+        static_cast<uint32_t>(channelCount * (halfFloat ? sizeof(uint16_t) : sizeof(float))),
+        vk::BufferUsageFlagBits::eTransferDst,
+        VMA_MEMORY_USAGE_GPU_TO_CPU);
+
+    vk::MemoryBarrier imageBarrier {
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+    };
+
+    transientCommandBuffer.begin();
+    transientCommandBuffer->pipelineBarrier(srcStage,
+                                            vk::PipelineStageFlagBits::eTransfer,
+                                            {},
+                                            imageBarrier,
+                                            {},
+                                            {});
+    transientCommandBuffer->copyImageToBuffer(
+        image,
+        vk::ImageLayout::eGeneral,
+        *readback,
+        vk::BufferImageCopy {
+            .imageSubresource = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                 .mipLevel       = 0,
+                                 .baseArrayLayer = 0,
+                                 .layerCount     = 1},
+            .imageExtent      = {.width = size.width, .height = size.height, .depth = 1},
+    });
+    transientCommandBuffer.submitAndWait();
+
+    void* mapped = readback.map();
+    readback.invalidate();
+
+    std::vector<float> pixels(channelCount);
+    if (halfFloat)
+    {
+        const auto* halves = static_cast<const uint16_t*>(mapped);
+        for (std::size_t i = 0; i < channelCount; ++i)
+        {
+            pixels[i] = halfToFloat(halves[i]);
+        }
+    }
+    else
+    {
+        std::memcpy(pixels.data(), mapped, channelCount * sizeof(float));
+    }
+
+    readback.unmap();
+
+    if (stbi_write_hdr(filename.c_str(),
+                       static_cast<int>(size.width),
+                       static_cast<int>(size.height),
+                       4,
+                       pixels.data()) == 0)
+    {
+        std::cout << "Failed to save " << filename << std::endl;
+    }
+    else
+    {
+        std::cout << "Saved " << filename << std::endl;
+    }
+}
+
 std::vector<char> ResourceManager::readFile(const std::filesystem::path& path)
 {
     std::ifstream     fs(path, std::ios::ate | std::ios::binary);
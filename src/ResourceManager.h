@@ -4,10 +4,12 @@
 #include "vk_mem_alloc.h"
 
 #include <filesystem>
+#include <functional>
 #include <optional>
 
 class ResourceManager;
 class TransientCommandBuffer;
+struct CompressedTexture;
 
 template<typename T, typename Derived>
 struct UniqueHandle
@@ -219,7 +221,8 @@ public:
                                           uint32_t             baseMipLevel    = 0,
                                           uint32_t             mipLevelCount   = 1,
                                           uint32_t             baseArrayLayer  = 0,
-                                          uint32_t             arrayLayerCount = 1);
+                                          uint32_t             arrayLayerCount = 1,
+                                          vk::ComponentMapping components      = {});
 
     vk::UniqueSampler
     createSampler(vk::Device                   device,
@@ -258,6 +261,37 @@ public:
         return createBuffer(bufferInfo, allocationInfo);
     }
 
+    // Static data is uploaded once through a staging buffer and lives in device-local memory.
+    // Host-visible memory is reserved for buffers the CPU keeps rewriting after load.
+    // The copy is only queued on the transfer lane; wait on the transient command buffer before
+    // the GPU first reads the result.
+    UniqueBuffer createStaticBuffer(const void*             data,
+                                    vk::DeviceSize          size,
+                                    vk::BufferUsageFlags    usage,
+                                    TransientCommandBuffer& transientCommandBuffer);
+
+    // Fills the staging memory in place, for data that would otherwise be built in a temporary
+    // CPU array only to be copied again
+    UniqueBuffer createStaticBuffer(vk::DeviceSize                    size,
+                                    vk::BufferUsageFlags              usage,
+                                    TransientCommandBuffer&           transientCommandBuffer,
+                                    const std::function<void(void*)>& fill);
+
+    template<typename T>
+    UniqueBuffer createStaticTypedBuffer(const std::vector<T>&   elements,
+                                         vk::BufferUsageFlags    usage,
+                                         TransientCommandBuffer& transientCommandBuffer)
+    {
+        return createStaticBuffer(elements.data(),
+                                  sizeof(T) * elements.size(),
+                                  usage,
+                                  transientCommandBuffer);
+    }
+
+    UniqueBuffer createStagingBuffer(const void* data, vk::DeviceSize size);
+
+    void logHeapUsage() const;
+
     static void transitionImageLayout(vk::CommandBuffer commandBuffer,
                                       vk::Image         image,
                                       vk::Format        format,
@@ -266,13 +300,15 @@ public:
                                       uint32_t          baseMipLevel = 0,
                                       uint32_t          numMipLevels = 1);
 
+    // Queues the upload and mip generation without waiting for them. texelSize is in bytes.
     static UniqueImage loadTexture(const unsigned char*    data,
                                    uint32_t                width,
                                    uint32_t                height,
                                    vk::Format              format,
                                    uint32_t                mipLevels,
                                    ResourceManager&        allocator,
-                                   TransientCommandBuffer& transientCommandBuffer);
+                                   TransientCommandBuffer& transientCommandBuffer,
+                                   uint32_t                texelSize = 4);
 
     static UniqueImage loadTexture(const tinygltf::Image&  gltfImage,
                                    vk::Format              format,
@@ -280,6 +316,36 @@ public:
                                    ResourceManager&        allocator,
                                    TransientCommandBuffer& transientCommandBuffer);
 
+    // Uploads a texture's precomputed mip chain from baseMip down, without waiting. The image's
+    // level 0 is the texture's baseMip.
+    static UniqueImage loadCompressedTexture(const CompressedTexture& texture,
+                                             uint32_t                 baseMip,
+                                             ResourceManager&         allocator,
+                                             TransientCommandBuffer&  transientCommandBuffer);
+
+    static UniqueImage createMipChainImage(const CompressedTexture& texture,
+                                           uint32_t                 baseMip,
+                                           ResourceManager&         allocator);
+
+    // Copies mips baseMip onwards from a staging buffer holding them tightly packed and leaves
+    // the image ready for sampling
+    static void copyMipChain(vk::CommandBuffer        commandBuffer,
+                             vk::Buffer               staging,
+                             vk::Image                image,
+                             const CompressedTexture& texture,
+                             uint32_t                 baseMip);
+
+    // Reads back a color image in eGeneral layout and writes it as a Radiance HDR file. Only
+    // RGBA16F and RGBA32F are supported, srcStage and srcAccess are the image's last writes.
+    static void saveImageHdr(vk::Image               image,
+                             vk::Format              format,
+                             vk::Extent2D            size,
+                             vk::PipelineStageFlags  srcStage,
+                             vk::AccessFlags         srcAccess,
+                             ResourceManager&        allocator,
+                             TransientCommandBuffer& transientCommandBuffer,
+                             const std::string&      filename);
+
     static std::vector<char> readFile(const std::filesystem::path& path);
 
 private:
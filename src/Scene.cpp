@@ -1,36 +1,79 @@
 #include "Scene.h"
 
+#include "MappedFile.h"
 #include "ResourceManager.h"
 #include "ShaderInclude.h"
 #include "Structs.h"
+#include "TextureCompressor.h"
 #include "TransientCommandBuffer.h"
 
 #include <gltfscene.h>
 #include <nvmath_glsltypes.h>
+#include <stb_image.h>
 
+#include <algorithm>
+#include <cstring>
+#include <numbers>
+#include <numeric>
 #include <queue>
+#include <utility>
 
 Scene::Scene(const std::string&      filename,
              ResourceManager&        allocator,
              TransientCommandBuffer& transientCommandBuffer,
              vk::Device              device,
-             uint32_t                pointLightCount)
+             uint32_t                pointLightCount,
+             bool                    compressTextures,
+             const std::string&      environmentFilename)
 {
-    tinygltf::Model    model;
-    tinygltf::TinyGLTF context;
-    std::string        warn;
-    std::string        error;
-    if (!context.LoadASCIIFromFile(&model, &error, &warn, filename))
     {
-        std::cout << "Error while loading scene" << std::endl;
-        std::abort();
-    }
+        // Parse straight from the mapped file; tinygltf would otherwise read it into a heap
+        // buffer first. GLB files are recognised by their magic rather than the extension.
+        MappedFile               file(filename);
+        std::span<const uint8_t> bytes = file.data();
+
+        const std::string baseDirectory = std::filesystem::path(filename).parent_path().string();
+        const bool binary = bytes.size() >= 4 && std::memcmp(bytes.data(), "glTF", 4) == 0;
+
+        tinygltf::Model    model;
+        tinygltf::TinyGLTF context;
+        std::string        warn;
+        std::string        error;
+
+        const bool loaded =
+            binary ? context.LoadBinaryFromMemory(&model,
+                                                  &error,
+                                                  &warn,
+                                                  bytes.data(),
+                                                  static_cast<unsigned int>(bytes.size()),
+                                                  baseDirectory)
+                   : context.LoadASCIIFromString(&model,
+                                                 &error,
+                                                 &warn,
+                                                 reinterpret_cast<const char*>(bytes.data()),
+                                                 static_cast<unsigned int>(bytes.size()),
+                                                 baseDirectory);
+        if (!loaded)
+        {
+            std::cout << "Error while loading scene: " << error << std::endl;
+            std::abort();
+        }
+
+        nvh::GltfAttributes attributes =
+            nvh::GltfAttributes::Normal | nvh::GltfAttributes::Texcoord_0 |
+            nvh::GltfAttributes::Color_0 | nvh::GltfAttributes::Tangent;
+        if (!model.skins.empty())
+        {
+            attributes =
+                attributes | nvh::GltfAttributes::Joints_0 | nvh::GltfAttributes::Weights_0;
+        }
 
-    GltfScene.importDrawableNodes(model,
-                                  nvh::GltfAttributes::Normal | nvh::GltfAttributes::Texcoord_0 |
-                                      nvh::GltfAttributes::Color_0 | nvh::GltfAttributes::Tangent);
-    GltfScene.importMaterials(model);
-    GltfScene.importTexutureImages(model);
+        GltfScene.importDrawableNodes(model, attributes);
+        GltfScene.importMaterials(model);
+        GltfScene.importTexutureImages(model);
+
+        // The model's buffers and the mapping are released here, before any GPU uploads
+    }
 
     std::vector<shader::PointLight>    pointLights    = collectPointLights(GltfScene);
     std::vector<shader::TriangleLight> triangleLights = collectTriangleLights(GltfScene);
@@ -45,90 +88,296 @@ Scene::Scene(const std::string&      filename,
 
     std::vector<shader::Bucket> aliasTable = createAliasTable(pointLights, triangleLights);
 
-    Vertices = allocator.createTypedBuffer<Vertex>(
-        GltfScene.m_positions.size(),
-        vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
-            vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR,
-        VMA_MEMORY_USAGE_CPU_TO_GPU);
+    // Nodes are grouped by mesh so every mesh is drawn once with all of its instances. Skinned
+    // nodes deform their own copy of the mesh, so each of them is a group of its own.
+    std::vector<uint32_t> drawGroups(GltfScene.m_nodes.size());
+    uint32_t              skinnedGroup = static_cast<uint32_t>(GltfScene.m_primMeshes.size());
+    for (std::size_t i = 0; i < GltfScene.m_nodes.size(); ++i)
+    {
+        const nvh::GltfNode& node = GltfScene.m_nodes[i];
+        drawGroups[i] = isSkinned(node) ? skinnedGroup++ : static_cast<uint32_t>(node.primMesh);
+    }
+
+    std::vector<uint32_t> instanceNodes(GltfScene.m_nodes.size());
+    std::iota(instanceNodes.begin(), instanceNodes.end(), 0u);
+    std::stable_sort(instanceNodes.begin(),
+                     instanceNodes.end(),
+                     [&drawGroups](uint32_t a, uint32_t b) {
+                         return drawGroups[a] < drawGroups[b];
+                     });
 
-    Vertex* vertices = Vertices.mapAs<Vertex>();
-    for (std::size_t i = 0; i < GltfScene.m_positions.size(); ++i)
+    InstanceCount = static_cast<uint32_t>(instanceNodes.size());
+
+    _nodeInstances.resize(InstanceCount);
+    for (uint32_t i = 0; i < InstanceCount; ++i)
     {
-        Vertex& v  = vertices[i];
-        v.position = GltfScene.m_positions[i];
+        _nodeInstances[instanceNodes[i]] = i;
+    }
 
-        if (i < GltfScene.m_normals.size())
-        {
-            v.normal = GltfScene.m_normals[i];
-        }
+    std::vector<uint32_t> firstJoints(GltfScene.m_skins.size());
+    uint32_t              jointCount = 0;
+    for (std::size_t i = 0; i < GltfScene.m_skins.size(); ++i)
+    {
+        firstJoints[i] = jointCount;
+        jointCount += static_cast<uint32_t>(GltfScene.m_skins[i].joints.size());
+    }
 
-        if (i < GltfScene.m_colors0.size())
-        {
-            v.color = GltfScene.m_colors0[i];
-        }
-        else
-        {
-            v.color = nvmath::vec4(1.0f, 0.0f, 1.0f, 1.0f);
-        }
+    // Deformed copies are appended after the scene's own vertices, in instance order
+    const uint32_t baseVertexCount = static_cast<uint32_t>(GltfScene.m_positions.size());
+    uint32_t       vertexCount     = baseVertexCount;
 
-        if (i < GltfScene.m_texcoords0.size())
+    std::vector<shader::SkinJob> skinJobs;
+    for (uint32_t i = 0; i < InstanceCount; ++i)
+    {
+        const nvh::GltfNode& node = GltfScene.m_nodes[instanceNodes[i]];
+        if (!isSkinned(node))
         {
-            v.uv = GltfScene.m_texcoords0[i];
+            continue;
         }
 
-        if (i < GltfScene.m_tangents.size())
+        const nvh::GltfPrimMesh& mesh = GltfScene.m_primMeshes[node.primMesh];
+        skinJobs.push_back({
+            .sourceVertex = mesh.vertexOffset,
+            .targetVertex = vertexCount,
+            .vertexCount  = mesh.vertexCount,
+            .firstJoint   = firstJoints[node.skin],
+        });
+
+        _skinnedBlases.push_back({.primMesh = static_cast<uint32_t>(node.primMesh),
+                                  .firstVertex = vertexCount});
+
+        vertexCount += mesh.vertexCount;
+        SkinnedVertexCount = std::max(SkinnedVertexCount, mesh.vertexCount);
+    }
+
+    SkinJobCount = static_cast<uint32_t>(skinJobs.size());
+
+    // Skinned copies start out in the bind pose
+    auto copySkinnedVertices = [&skinJobs](auto* vertices) {
+        for (const shader::SkinJob& job : skinJobs)
         {
-            v.tangent = GltfScene.m_tangents[i];
+            std::copy_n(vertices + job.sourceVertex, job.vertexCount, vertices + job.targetVertex);
         }
+    };
+
+    const vk::BufferUsageFlags skinnedUsage =
+        skinJobs.empty() ? vk::BufferUsageFlags() : vk::BufferUsageFlagBits::eStorageBuffer;
+
+    // Needs the texture coordinates and the decoded images, both are released further down
+    std::vector<uint32_t> alphaTestIndices = classifyMaskedTriangles();
+    if (alphaTestIndices.empty())
+    {
+        alphaTestIndices.resize(3, 0);
     }
-    Vertices.unmap();
-    Vertices.flush();
 
-    Indices = allocator.createTypedBuffer<int32_t>(
-        GltfScene.m_indices.size(),
-        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
+    AlphaTestIndices = allocator.createStaticTypedBuffer(
+        alphaTestIndices,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
             vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR,
-        VMA_MEMORY_USAGE_CPU_TO_GPU);
+        transientCommandBuffer);
+
+    // Packed straight into staging memory; the unpacked arrays are not needed afterwards
+    Attributes = allocator.createStaticBuffer(
+        sizeof(VertexAttributes) * vertexCount,
+        vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+        transientCommandBuffer,
+        [this, &copySkinnedVertices](void* mapped) {
+            VertexAttributes* vertexAttributes = static_cast<VertexAttributes*>(mapped);
+            for (std::size_t i = 0; i < GltfScene.m_positions.size(); ++i)
+            {
+                nvmath::vec3 normal(0.0f, 0.0f, 1.0f);
+                nvmath::vec4 tangent(1.0f, 0.0f, 0.0f, 1.0f);
+                nvmath::vec4 color(1.0f, 0.0f, 1.0f, 1.0f);
+                nvmath::vec2 uv(0.0f, 0.0f);
+
+                if (i < GltfScene.m_normals.size())
+                {
+                    normal = GltfScene.m_normals[i];
+                }
+
+                if (i < GltfScene.m_colors0.size())
+                {
+                    color = GltfScene.m_colors0[i];
+                }
+
+                if (i < GltfScene.m_texcoords0.size())
+                {
+                    uv = GltfScene.m_texcoords0[i];
+                }
+
+                if (i < GltfScene.m_tangents.size())
+                {
+                    tangent = GltfScene.m_tangents[i];
+                }
+
+                vertexAttributes[i] = VertexAttributes::pack(normal, tangent, color, uv);
+            }
+
+            copySkinnedVertices(vertexAttributes);
+        });
+
+    std::vector<nvmath::vec3f>().swap(GltfScene.m_normals);
+    std::vector<nvmath::vec4f>().swap(GltfScene.m_tangents);
+    std::vector<nvmath::vec4f>().swap(GltfScene.m_colors0);
+    std::vector<nvmath::vec2f>().swap(GltfScene.m_texcoords0);
+
+    Positions = allocator.createStaticBuffer(
+        sizeof(nvmath::vec3f) * vertexCount,
+        vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
+            vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | skinnedUsage,
+        transientCommandBuffer,
+        [this, &copySkinnedVertices](void* mapped) {
+            nvmath::vec3f* positions = static_cast<nvmath::vec3f*>(mapped);
+            std::copy(GltfScene.m_positions.begin(), GltfScene.m_positions.end(), positions);
+            copySkinnedVertices(positions);
+        });
 
-    uint32_t* indices = Indices.mapAs<uint32_t>();
-    for (std::size_t i = 0; i < GltfScene.m_indices.size(); ++i)
+    if (!skinJobs.empty())
     {
-        indices[i] = GltfScene.m_indices[i];
+        SkinVertices = allocator.createStaticBuffer(
+            sizeof(shader::SkinVertex) * baseVertexCount,
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            transientCommandBuffer,
+            [this](void* mapped) {
+                shader::SkinVertex* skinVertices = static_cast<shader::SkinVertex*>(mapped);
+                for (std::size_t i = 0; i < GltfScene.m_joints0.size(); ++i)
+                {
+                    skinVertices[i] = {.joints  = GltfScene.m_joints0[i],
+                                       .weights = GltfScene.m_weights0[i]};
+                }
+            });
+
+        SkinJobs = allocator.createStaticTypedBuffer(skinJobs,
+                                                     vk::BufferUsageFlagBits::eStorageBuffer,
+                                                     transientCommandBuffer);
+
+        JointMatrices = allocator.createTypedBuffer<nvmath::mat4>(
+            jointCount, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+        // Rest pose from the node hierarchy until setSkinJoints says otherwise
+        nvmath::mat4* jointMatrices = JointMatrices.mapAs<nvmath::mat4>();
+        for (std::size_t i = 0; i < GltfScene.m_skins.size(); ++i)
+        {
+            const nvh::GltfSkin& skin = GltfScene.m_skins[i];
+            for (std::size_t j = 0; j < skin.joints.size(); ++j)
+            {
+                jointMatrices[firstJoints[i] + j] =
+                    GltfScene.m_nodeWorldMatrices[skin.joints[j]] * skin.inverseBindMatrices[j];
+            }
+        }
+        JointMatrices.unmap();
+        JointMatrices.flush();
+
+        _skinPoseChanged = true;
     }
-    Indices.unmap();
-    Indices.flush();
 
-    Matrices =
-        allocator.createTypedBuffer<shader::ModelMatrices>(GltfScene.m_nodes.size(),
-                                                           vk::BufferUsageFlagBits::eUniformBuffer,
-                                                           VMA_MEMORY_USAGE_CPU_TO_GPU);
+    _firstJoints = std::move(firstJoints);
 
-    auto* matrices = Matrices.mapAs<shader::ModelMatrices>();
-    for (std::size_t i = 0; i < GltfScene.m_nodes.size(); ++i)
+    std::vector<nvmath::vec4ui>().swap(GltfScene.m_joints0);
+    std::vector<nvmath::vec4f>().swap(GltfScene.m_weights0);
+
+    Indices = allocator.createStaticTypedBuffer(
+        GltfScene.m_indices,
+        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eShaderDeviceAddress |
+            vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR,
+        transientCommandBuffer);
+
+
+    std::vector<shader::Instance>               instances(InstanceCount);
+    std::vector<shader::InstanceBounds>         instanceBounds(InstanceCount);
+    std::vector<vk::DrawIndexedIndirectCommand> drawCommands;
+    uint32_t                                    skinnedInstance = 0;
+    for (uint32_t i = 0; i < InstanceCount; ++i)
     {
-        matrices[i].Transform = GltfScene.m_nodes[i].worldMatrix;
-        matrices[i].TransformInverseTransposed =
-            nvmath::transpose(nvmath::invert(matrices[i].Transform));
+        const nvh::GltfNode&     node = GltfScene.m_nodes[instanceNodes[i]];
+        const nvh::GltfPrimMesh& mesh = GltfScene.m_primMeshes[node.primMesh];
+
+        // Skinned vertices are already in world space, the node transform does not apply
+        const bool         skinned     = isSkinned(node);
+        const nvmath::mat4 worldMatrix = skinned ? nvmath::mat4(1) : node.worldMatrix;
+
+        if (i == 0 || drawGroups[instanceNodes[i - 1]] != drawGroups[instanceNodes[i]])
+        {
+            const uint32_t vertexOffset =
+                skinned ? skinJobs[skinnedInstance].targetVertex : mesh.vertexOffset;
+
+            // The culling pass fills in instanceCount every frame
+            drawCommands.push_back({
+                .indexCount    = mesh.indexCount,
+                .instanceCount = 0,
+                .firstIndex    = mesh.firstIndex,
+                .vertexOffset  = static_cast<int32_t>(vertexOffset),
+                .firstInstance = i,
+            });
+        }
+
+        const std::optional<MaskedTriangles>& masked = _maskedTriangles[node.primMesh];
+        const uint32_t alphaTestFirstIndex = masked ? masked->firstIndex + 3 * masked->opaqueCount
+                                                    : 0;
+
+        instances[i] = {
+            .Transform                  = worldMatrix,
+            .TransformInverseTransposed = nvmath::transpose(nvmath::invert(worldMatrix)),
+            .PreviousTransform          = worldMatrix,
+            .material                   = static_cast<uint32_t>(mesh.materialIndex),
+            .drawIndex                  = static_cast<uint32_t>(drawCommands.size() - 1),
+            .alphaTestFirstIndex        = alphaTestFirstIndex,
+            .vertexOffset               = static_cast<uint32_t>(drawCommands.back().vertexOffset),
+            .firstIndex                 = masked ? masked->firstIndex : mesh.firstIndex,
+        };
+
+        // The pose is only known on the GPU, so skinned instances are never culled
+        instanceBounds[i] =
+            skinned ? shader::InstanceBounds {} : computeWorldBounds(mesh, worldMatrix);
+        skinnedInstance += skinned ? 1 : 0;
     }
-    Matrices.unmap();
-    Matrices.flush();
 
-    Materials = allocator.createTypedBuffer<shader::MaterialUniforms>(
-        GltfScene.m_materials.size(),
-        vk::BufferUsageFlagBits::eUniformBuffer,
-        VMA_MEMORY_USAGE_CPU_TO_GPU);
+    MeshDrawCount = static_cast<uint32_t>(drawCommands.size());
+
+    Instances = allocator.createStaticTypedBuffer(
+        instances,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        transientCommandBuffer);
+
+    InstanceBounds = allocator.createStaticTypedBuffer(
+        instanceBounds,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        transientCommandBuffer);
+
+    // Host copies of both tables, setNodeTransform edits these and recordUpdate copies them over
+    _instanceStaging = allocator.createStagingBuffer(instances.data(),
+                                                     sizeof(shader::Instance) * instances.size());
+    _instanceBoundsStaging =
+        allocator.createStagingBuffer(instanceBounds.data(),
+                                      sizeof(shader::InstanceBounds) * instanceBounds.size());
+    _instanceMoved.assign(InstanceCount, false);
+
+    MeshDrawCommands = allocator.createStaticTypedBuffer(
+        drawCommands,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc,
+        transientCommandBuffer);
 
-    auto* mat_device = Materials.mapAs<shader::MaterialUniforms>();
+    const int32_t defaultWhiteTexture  = static_cast<int32_t>(GltfScene.m_textures.size());
+    const int32_t defaultNormalTexture = defaultWhiteTexture + 1;
+
+    auto textureOr = [](int32_t texture, int32_t fallback) {
+        return texture >= 0 ? texture : fallback;
+    };
+
+    std::vector<shader::MaterialUniforms> materials(GltfScene.m_materials.size());
     for (std::size_t i = 0; i < GltfScene.m_materials.size(); ++i)
     {
         const nvh::GltfMaterial&  mat    = GltfScene.m_materials[i];
-        shader::MaterialUniforms& outMat = mat_device[i];
+        shader::MaterialUniforms& outMat = materials[i];
 
         outMat.emissiveFactor     = mat.emissiveFactor;
         outMat.shadingModel       = mat.shadingModel;
         outMat.alphaMode          = mat.alphaMode;
         outMat.alphaCutoff        = mat.alphaCutoff;
         outMat.normalTextureScale = mat.normalTextureScale;
+        outMat.normalTexture      = textureOr(mat.normalTexture, defaultNormalTexture);
+        outMat.emissiveTexture    = textureOr(mat.emissiveTexture, defaultWhiteTexture);
 
         switch (outMat.shadingModel)
         {
@@ -136,98 +385,112 @@ Scene::Scene(const std::string&      filename,
                 outMat.colorParam      = mat.pbrBaseColorFactor;
                 outMat.materialParam.y = mat.pbrRoughnessFactor;
                 outMat.materialParam.z = mat.pbrMetallicFactor;
+                outMat.albedoTexture   = textureOr(mat.pbrBaseColorTexture, defaultWhiteTexture);
+                outMat.materialTexture =
+                    textureOr(mat.pbrMetallicRoughnessTexture, defaultWhiteTexture);
                 break;
             case SPECULAR_GLOSSINESS:
                 outMat.colorParam      = mat.khrDiffuseFactor;
                 outMat.materialParam   = mat.khrSpecularFactor;
                 outMat.materialParam.w = mat.khrGlossinessFactor;
+                outMat.albedoTexture   = textureOr(mat.khrDiffuseTexture, defaultWhiteTexture);
+                outMat.materialTexture =
+                    textureOr(mat.khrSpecularGlossinessTexture, defaultWhiteTexture);
+                break;
+        }
+    }
+
+    Materials = allocator.createStaticTypedBuffer(materials,
+                                                  vk::BufferUsageFlagBits::eStorageBuffer,
+                                                  transientCommandBuffer);
+
+    std::vector<uint8_t> pointLightBlock = packCountedArray<shader::PointLight, int32_t>(pointLights);
+
+    PointLightsSize = pointLightBlock.size();
+    PointLights     = allocator.createStaticTypedBuffer(pointLightBlock,
+                                                    vk::BufferUsageFlagBits::eStorageBuffer,
+                                                    transientCommandBuffer);
+
+    std::vector<uint8_t> triangleLightBlock =
+        packCountedArray<shader::TriangleLight, int32_t>(triangleLights);
+
+    TriangleLightsSize = triangleLightBlock.size();
+    TriangleLights     = allocator.createStaticTypedBuffer(triangleLightBlock,
+                                                       vk::BufferUsageFlagBits::eStorageBuffer,
+                                                       transientCommandBuffer);
+
+    std::vector<uint8_t> aliasTableBlock = packCountedArray<shader::Bucket, int32_t[4]>(aliasTable);
+
+    AliasTableSize = aliasTableBlock.size();
+    AliasTable     = allocator.createStaticTypedBuffer(aliasTableBlock,
+                                                   vk::BufferUsageFlagBits::eStorageBuffer,
+                                                   transientCommandBuffer);
+
+    loadEnvironment(environmentFilename,
+                    !aliasTable.empty(),
+                    allocator,
+                    transientCommandBuffer,
+                    device);
+
+    // Block formats depend on how materials sample an image; an image shared between roles
+    // falls back to the general colour encoding.
+    std::vector<std::optional<TextureUsage>> textureUsages(GltfScene.m_textures.size());
+    auto addUsage = [&textureUsages](int32_t texture, TextureUsage usage) {
+        if (texture < 0)
+        {
+            return;
+        }
+
+        std::optional<TextureUsage>& current = textureUsages[texture];
+        current = current && *current != usage ? TextureUsage::Color : usage;
+    };
+
+    for (const nvh::GltfMaterial& mat : GltfScene.m_materials)
+    {
+        addUsage(mat.normalTexture, TextureUsage::Normal);
+        addUsage(mat.emissiveTexture, TextureUsage::Color);
+
+        switch (mat.shadingModel)
+        {
+            case METALLIC_ROUGHNESS:
+                addUsage(mat.pbrBaseColorTexture, TextureUsage::Color);
+                addUsage(mat.pbrMetallicRoughnessTexture, TextureUsage::MetallicRoughness);
+                break;
+            case SPECULAR_GLOSSINESS:
+                addUsage(mat.khrDiffuseTexture, TextureUsage::Color);
+                addUsage(mat.khrSpecularGlossinessTexture, TextureUsage::Color);
                 break;
         }
     }
-    Materials.unmap();
-    Materials.flush();
-
-    PointLightsSize = alignPreArrayBlock<shader::PointLight, int32_t>() +
-                      sizeof(shader::PointLight) * pointLights.size();
-
-    PointLights = allocator.createBuffer(static_cast<uint32_t>(PointLightsSize),
-                                         vk::BufferUsageFlagBits::eStorageBuffer,
-                                         VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-    int32_t* pointLightPtr = PointLights.mapAs<int32_t>();
-    *pointLightPtr         = static_cast<int32_t>(pointLights.size());
-    auto* ptLights =
-        reinterpret_cast<shader::PointLight*>(reinterpret_cast<uintptr_t>(pointLightPtr) +
-                                              alignPreArrayBlock<shader::PointLight, int32_t>());
-    std::memcpy(ptLights, pointLights.data(), sizeof(shader::PointLight) * pointLights.size());
-    PointLights.unmap();
-    PointLights.flush();
-
-    TriangleLightsSize = alignPreArrayBlock<shader::TriangleLight, int32_t>() +
-                         sizeof(shader::TriangleLight) * triangleLights.size();
-
-    TriangleLights = allocator.createBuffer(static_cast<uint32_t>(TriangleLightsSize),
-                                            vk::BufferUsageFlagBits::eStorageBuffer,
-                                            VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-    int32_t* triangleLightsPtr = TriangleLights.mapAs<int32_t>();
-    *triangleLightsPtr         = static_cast<int32_t>(triangleLights.size());
-    auto* triLights            = reinterpret_cast<shader::TriangleLight*>(
-        reinterpret_cast<uintptr_t>(triangleLightsPtr) +
-        alignPreArrayBlock<shader::TriangleLight, int32_t>());
-    std::memcpy(triLights,
-                triangleLights.data(),
-                sizeof(shader::TriangleLight) * triangleLights.size());
-    TriangleLights.unmap();
-    TriangleLights.flush();
-
-    AliasTableSize = alignPreArrayBlock<shader::Bucket, int32_t[4]>() +
-                     sizeof(shader::Bucket) * aliasTable.size();
-
-    AliasTable = allocator.createBuffer(static_cast<uint32_t>(AliasTableSize),
-                                        vk::BufferUsageFlagBits::eStorageBuffer,
-                                        VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-    int32_t* aliasTablePtr = AliasTable.mapAs<int32_t>();
-    *aliasTablePtr         = static_cast<int32_t>(aliasTable.size());
-    auto* aliasTableContentPtr =
-        reinterpret_cast<shader::Bucket*>(reinterpret_cast<uintptr_t>(aliasTablePtr) +
-                                          alignPreArrayBlock<shader::Bucket, int32_t[4]>());
-    std::memcpy(aliasTableContentPtr,
-                aliasTable.data(),
-                sizeof(shader::Bucket) * aliasTable.size());
-    AliasTable.unmap();
-    AliasTable.flush();
 
+    const std::filesystem::path textureCacheDirectory =
+        std::filesystem::path(filename).parent_path() / "textureCache";
+
+    // Images are created by the TextureStreamer, which uploads only part of each mip chain
     Textures.resize(GltfScene.m_textures.size());
+    TextureSources.resize(GltfScene.m_textures.size());
     for (uint32_t i = 0; i < GltfScene.m_textures.size(); ++i)
     {
         tinygltf::Image& gltfImage = GltfScene.m_textures[i];
 
-        uint32_t numMipLevels = 1 + static_cast<uint32_t>(std::ceil(
-                                        std::log2(std::max(gltfImage.width, gltfImage.height))));
+        TextureSources[i] =
+            compressTextures
+                ? TextureCompressor::compress(gltfImage,
+                                              textureUsages[i].value_or(TextureUsage::Color),
+                                              textureCacheDirectory)
+                : TextureCompressor::uncompressed(gltfImage);
 
-        Textures[i].Image = ResourceManager::loadTexture(gltfImage,
-                                                         vk::Format::eR8G8B8A8Unorm,
-                                                         numMipLevels,
-                                                         allocator,
-                                                         transientCommandBuffer);
+        // The source holds every mip, the decoded image is not needed anymore
+        std::vector<unsigned char>().swap(gltfImage.image);
 
         Textures[i].Sampler = allocator.createSampler(device,
                                                       vk::Filter::eLinear,
                                                       vk::Filter::eLinear,
                                                       vk::SamplerMipmapMode::eLinear,
                                                       16.0f);
-
-        Textures[i].ImageView = allocator.createImageView2D(device,
-                                                            *Textures[i].Image,
-                                                            vk::Format::eR8G8B8A8Unorm,
-                                                            vk::ImageAspectFlagBits::eColor,
-                                                            0,
-                                                            numMipLevels);
     }
 
-    unsigned char defaultNormal[4] {255, 255, 255, 255};
+    unsigned char defaultNormal[4] {128, 128, 255, 255};
     DefaultNormalTexture.Image     = ResourceManager::loadTexture(defaultNormal,
                                                               1,
                                                               1,
@@ -255,46 +518,34 @@ Scene::Scene(const std::string&      filename,
                                                                 vk::Format::eR8G8B8A8Unorm,
                                                                 vk::ImageAspectFlagBits::eColor);
 
+    // Geometry uploads were only queued on the transfer lane; the builds below read them
+    transientCommandBuffer.waitIdle();
+
     _blases.resize(GltfScene.m_primMeshes.size());
     for (uint32_t i = 0; i < GltfScene.m_primMeshes.size(); ++i)
     {
         const nvh::GltfPrimMesh& primMesh = GltfScene.m_primMeshes[i];
 
-        vk::AccelerationStructureGeometryTrianglesDataKHR triangles {
-            .vertexFormat = vk::Format::eR32G32B32Sfloat,
-            .vertexData   = {.deviceAddress = device.getBufferAddress({.buffer = *Vertices})},
-            .vertexStride = sizeof(Vertex),
-            .maxVertex    = primMesh.vertexCount,
-            .indexType    = vk::IndexType::eUint32,
-            .indexData    = {.deviceAddress = device.getBufferAddress({.buffer = *Indices})},
-        };
-
-        vk::AccelerationStructureGeometryKHR blasAccelerationGeometry {
-            .geometryType = vk::GeometryTypeKHR::eTriangles,
-            .geometry     = {.triangles = {.vertexFormat = vk::Format::eR32G32B32Sfloat,
-                                           .vertexData   = {.deviceAddress = device.getBufferAddress(
-                                                          {.buffer = *Vertices})},
-                                           .vertexStride = sizeof(Vertex),
-                                           .maxVertex    = primMesh.vertexCount,
-                                           .indexType    = vk::IndexType::eUint32,
-                                           .indexData    = {.deviceAddress = device.getBufferAddress(
-                                                         {.buffer = *Indices})}}},
-            .flags        = vk::GeometryFlagBitsKHR::eOpaque,
-        };
+        BlasGeometries geometries;
+        BlasRanges     ranges;
+        const uint32_t geometryCount =
+            getBlasGeometries(device, i, primMesh.vertexOffset, geometries, ranges);
 
         vk::AccelerationStructureBuildGeometryInfoKHR blasAccelerationBuildGeometryInfo {
-            .type                     = vk::AccelerationStructureTypeKHR::eBottomLevel,
-            .flags                    = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace,
-            .dstAccelerationStructure = *_blases.at(i),
-            .geometryCount            = 1,
-            .pGeometries              = &blasAccelerationGeometry,
+            .type          = vk::AccelerationStructureTypeKHR::eBottomLevel,
+            .flags         = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace,
+            .geometryCount = geometryCount,
+            .pGeometries   = geometries.data(),
         };
 
+        std::array<uint32_t, 2> primitiveCounts {ranges[0].primitiveCount,
+                                                 ranges[1].primitiveCount};
+
         vk::AccelerationStructureBuildSizesInfoKHR sizeInfo =
             device.getAccelerationStructureBuildSizesKHR(
                 vk::AccelerationStructureBuildTypeKHR::eDevice,
                 blasAccelerationBuildGeometryInfo,
-                primMesh.indexCount / 3);
+                vk::ArrayProxy<const uint32_t>(geometryCount, primitiveCounts.data()));
 
         UniqueBuffer blasScratchBuffer = createScratchBuffer(sizeInfo.buildScratchSize, allocator);
 
@@ -313,77 +564,98 @@ Scene::Scene(const std::string&      filename,
 
         blasAccelerationBuildGeometryInfo.setDstAccelerationStructure(*_blases[i]);
 
-        vk::AccelerationStructureBuildRangeInfoKHR blasAccelerationBuildOffsetInfo {
-            .primitiveCount  = primMesh.indexCount / 3,
-            .primitiveOffset = static_cast<uint32_t>(primMesh.firstIndex * sizeof(uint32_t)),
-            .firstVertex     = primMesh.vertexOffset,
-            .transformOffset = 0};
-
         transientCommandBuffer.begin();
         transientCommandBuffer->buildAccelerationStructuresKHR(blasAccelerationBuildGeometryInfo,
-                                                               {&blasAccelerationBuildOffsetInfo});
-        transientCommandBuffer.submitAndWait();
+                                                               {ranges.data()});
+        transientCommandBuffer.retain(std::move(blasScratchBuffer));
+        transientCommandBuffer.submit();
     }
 
+    // Skinned instances own a BLAS over their deformed copy, refitted whenever the pose changes
+    for (SkinnedBlas& blas : _skinnedBlases)
+    {
+        BlasGeometries                                geometries;
+        BlasRanges                                    ranges;
+        vk::AccelerationStructureBuildGeometryInfoKHR buildInfo =
+            getSkinnedBlasBuildInfo(device, blas, geometries, ranges, false);
+
+        std::array<uint32_t, 2> primitiveCounts {ranges[0].primitiveCount,
+                                                 ranges[1].primitiveCount};
+
+        vk::AccelerationStructureBuildSizesInfoKHR sizeInfo =
+            device.getAccelerationStructureBuildSizesKHR(
+                vk::AccelerationStructureBuildTypeKHR::eDevice,
+                buildInfo,
+                vk::ArrayProxy<const uint32_t>(buildInfo.geometryCount, primitiveCounts.data()));
+
+        _asAllocations.emplace_back(
+            createAccelerationStructureBuffer(sizeInfo.accelerationStructureSize, allocator));
+
+        blas.structure = device.createAccelerationStructureKHRUnique(
+            {.buffer = *_asAllocations.back(),
+             .offset = 0,
+             .size   = sizeInfo.accelerationStructureSize,
+             .type   = vk::AccelerationStructureTypeKHR::eBottomLevel},
+            nullptr);
+
+        blas.scratch = createScratchBuffer(
+            std::max(sizeInfo.buildScratchSize, sizeInfo.updateScratchSize), allocator);
+    }
+
+    if (!_skinnedBlases.empty())
+    {
+        transientCommandBuffer.begin();
+        recordSkinnedBlasBuilds(device, *transientCommandBuffer, false);
+        transientCommandBuffer.submit();
+    }
+
+    // Built in instance table order, the custom index lets hit shaders find their instance
     std::vector<vk::AccelerationStructureInstanceKHR> tlasInstance;
-    tlasInstance.reserve(GltfScene.m_nodes.size());
-    for (auto& node : GltfScene.m_nodes)
+    tlasInstance.reserve(InstanceCount);
+    skinnedInstance = 0;
+    for (uint32_t i = 0; i < InstanceCount; ++i)
     {
-        vk::TransformMatrixKHR transformMatrix;
-        for (std::size_t y = 0; y < 3; ++y)
-        {
-            for (std::size_t x = 0; x < 4; ++x)
-            {
-                transformMatrix.matrix[y][x] = node.worldMatrix.mat_array[x * 4 + y];
-            }
-        }
+        const nvh::GltfNode& node    = GltfScene.m_nodes[instanceNodes[i]];
+        const bool           skinned = isSkinned(node);
+
+        const vk::AccelerationStructureKHR blas =
+            skinned ? *_skinnedBlases[skinnedInstance++].structure : *_blases[node.primMesh];
 
         tlasInstance.push_back(
-            {.transform                              = transformMatrix,
-             .instanceCustomIndex                    = static_cast<uint32_t>(node.primMesh),
+            {.transform = toTransformMatrix(skinned ? nvmath::mat4(1) : node.worldMatrix),
+             .instanceCustomIndex                    = i,
              .mask                                   = 0xFF,
              .instanceShaderBindingTableRecordOffset = 0,
              .flags                                  = static_cast<VkGeometryInstanceFlagsKHR>(
                  vk::GeometryInstanceFlagBitsKHR::eTriangleCullDisable),
-             .accelerationStructureReference = device.getAccelerationStructureAddressKHR(
-                 {.accelerationStructure = *_blases[node.primMesh]})});
+             .accelerationStructureReference =
+                 device.getAccelerationStructureAddressKHR({.accelerationStructure = blas})});
     }
 
-    uint32_t instanceBufferByteLength =
-        static_cast<uint32_t>(sizeof(vk::AccelerationStructureInstanceKHR) * tlasInstance.size());
-
-    _tlasInstanceBuffer = allocator.createBuffer(
-        {
-            .size  = instanceBufferByteLength,
-            .usage = vk::BufferUsageFlagBits::eShaderDeviceAddress |
-                     vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR,
-            .sharingMode = vk::SharingMode::eExclusive,
-        },
-        {.usage = VMA_MEMORY_USAGE_CPU_TO_GPU});
+    // Host visible, so transform updates are written in place and read by the next build
+    _tlasInstanceBuffer = allocator.createTypedBuffer<vk::AccelerationStructureInstanceKHR>(
+        tlasInstance.size(),
+        vk::BufferUsageFlagBits::eShaderDeviceAddress |
+            vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR,
+        VMA_MEMORY_USAGE_CPU_TO_GPU);
 
-    void* dstData = _tlasInstanceBuffer.map();
-    memcpy(dstData, tlasInstance.data(), instanceBufferByteLength);
+    std::memcpy(_tlasInstanceBuffer.map(),
+                tlasInstance.data(),
+                sizeof(vk::AccelerationStructureInstanceKHR) * tlasInstance.size());
     _tlasInstanceBuffer.unmap();
+    _tlasInstanceBuffer.flush();
 
-    vk::AccelerationStructureGeometryKHR tlasAccelerationGeometry {
-        .geometryType = vk::GeometryTypeKHR::eInstances,
-        .geometry     = {.instances = {.arrayOfPointers = VK_FALSE,
-                                       .data            = {.deviceAddress = device.getBufferAddress(
-                                                {.buffer = *_tlasInstanceBuffer})}}},
-        .flags        = vk::GeometryFlagBitsKHR::eOpaque,
-    };
+    // The TLAS build needs every BLAS build to have finished
+    transientCommandBuffer.waitIdle();
 
-    vk::AccelerationStructureBuildGeometryInfoKHR tlasAccelerationBuildGeometryInfo {
-        .type          = vk::AccelerationStructureTypeKHR::eTopLevel,
-        .flags         = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace,
-        .geometryCount = 1,
-        .pGeometries   = &tlasAccelerationGeometry,
-    };
+    vk::AccelerationStructureGeometryKHR          tlasAccelerationGeometry;
+    vk::AccelerationStructureBuildGeometryInfoKHR tlasAccelerationBuildGeometryInfo =
+        getTlasBuildInfo(device, tlasAccelerationGeometry, false);
 
     auto buildSize = device.getAccelerationStructureBuildSizesKHR(
         vk::AccelerationStructureBuildTypeKHR::eDevice,
         tlasAccelerationBuildGeometryInfo,
-        {static_cast<std::uint32_t>(tlasInstance.size())});
+        {InstanceCount});
 
     _asAllocations.emplace_back(
         createAccelerationStructureBuffer(buildSize.accelerationStructureSize, allocator));
@@ -394,23 +666,515 @@ Scene::Scene(const std::string&      filename,
          .type   = vk::AccelerationStructureTypeKHR::eTopLevel},
         nullptr);
 
-    tlasAccelerationBuildGeometryInfo.setDstAccelerationStructure(*TLAS);
+    // Kept for refits and rebuilds, which reuse the same scratch memory
+    _tlasScratchBuffer = createScratchBuffer(
+        std::max(buildSize.buildScratchSize, buildSize.updateScratchSize), allocator);
+
+    transientCommandBuffer.begin();
+    recordTlasBuild(device, *transientCommandBuffer, false);
+    transientCommandBuffer.submitAndWait();
+}
+
+void Scene::setNodeTransforms(std::span<const NodeTransform> transforms)
+{
+    shader::Instance*       instances      = _instanceStaging.mapAs<shader::Instance>();
+    shader::InstanceBounds* instanceBounds = _instanceBoundsStaging.mapAs<shader::InstanceBounds>();
+    vk::AccelerationStructureInstanceKHR* tlasInstances =
+        _tlasInstanceBuffer.mapAs<vk::AccelerationStructureInstanceKHR>();
+
+    for (const NodeTransform& transform : transforms)
+    {
+        const uint32_t           instance = _nodeInstances[transform.Node];
+        nvh::GltfNode&           node     = GltfScene.m_nodes[transform.Node];
+        const nvh::GltfPrimMesh& mesh     = GltfScene.m_primMeshes[node.primMesh];
+
+        node.worldMatrix = transform.WorldMatrix;
+
+        // Skinned meshes are placed by their joints
+        if (isSkinned(node))
+        {
+            continue;
+        }
+
+        // The staged transform is still the one the last frame was drawn with
+        if (!_instanceMoved[instance])
+        {
+            _instanceMoved[instance] = true;
+            _movedInstances.push_back(instance);
+            instances[instance].PreviousTransform = instances[instance].Transform;
+        }
+
+        instances[instance].Transform = transform.WorldMatrix;
+        instances[instance].TransformInverseTransposed =
+            nvmath::transpose(nvmath::invert(transform.WorldMatrix));
+        instanceBounds[instance]          = computeWorldBounds(mesh, transform.WorldMatrix);
+        tlasInstances[instance].transform = toTransformMatrix(transform.WorldMatrix);
+
+        _dirtyBegin = std::min(_dirtyBegin, instance);
+        _dirtyEnd   = std::max(_dirtyEnd, instance + 1);
+    }
+
+    _tlasInstanceBuffer.unmap();
+    _instanceBoundsStaging.unmap();
+    _instanceStaging.unmap();
+}
+
+void Scene::setSkinJoints(uint32_t skin, std::span<const nvmath::mat4> jointWorldMatrices)
+{
+    const nvh::GltfSkin& gltfSkin      = GltfScene.m_skins[skin];
+    nvmath::mat4*        jointMatrices = JointMatrices.mapAs<nvmath::mat4>() + _firstJoints[skin];
+
+    for (std::size_t i = 0; i < std::min(jointWorldMatrices.size(), gltfSkin.joints.size()); ++i)
+    {
+        jointMatrices[i] = jointWorldMatrices[i] * gltfSkin.inverseBindMatrices[i];
+    }
+
+    JointMatrices.unmap();
+    JointMatrices.flush();
+
+    _skinPoseChanged = true;
+}
+
+bool Scene::takeSkinPoseChange()
+{
+    return std::exchange(_skinPoseChanged, false);
+}
+
+bool Scene::recordUpdate(vk::Device device, vk::CommandBuffer commandBuffer, bool blasesChanged)
+{
+    const bool moved   = _dirtyBegin < _dirtyEnd;
+    const bool settled = settleInstances();
+    if (!moved && !settled && !blasesChanged)
+    {
+        return false;
+    }
+
+    _instanceStaging.flush();
+    _instanceBoundsStaging.flush();
+    _tlasInstanceBuffer.flush();
+
+    // The previous frame's culling, vertex and ray tracing reads of the tables and the TLAS
+    vk::MemoryBarrier readBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderRead,
+        .dstAccessMask =
+            vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexShader |
+                                      vk::PipelineStageFlagBits::eComputeShader |
+                                      vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                                  vk::PipelineStageFlagBits::eTransfer |
+                                      vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                  {},
+                                  readBarrier,
+                                  {},
+                                  {});
+
+    if (moved || settled)
+    {
+        const uint32_t dirtyCount = _dirtyEnd - _dirtyBegin;
+
+        commandBuffer.copyBuffer(*_instanceStaging,
+                                 *Instances,
+                                 vk::BufferCopy {
+                                     .srcOffset = sizeof(shader::Instance) * _dirtyBegin,
+                                     .dstOffset = sizeof(shader::Instance) * _dirtyBegin,
+                                     .size      = sizeof(shader::Instance) * dirtyCount,
+                                 });
+
+        commandBuffer.copyBuffer(*_instanceBoundsStaging,
+                                 *InstanceBounds,
+                                 vk::BufferCopy {
+                                     .srcOffset = sizeof(shader::InstanceBounds) * _dirtyBegin,
+                                     .dstOffset = sizeof(shader::InstanceBounds) * _dirtyBegin,
+                                     .size      = sizeof(shader::InstanceBounds) * dirtyCount,
+                                 });
+    }
+
+    // Refitting keeps the original hierarchy, which degrades as instances drift away from where
+    // they were at the last full build
+    if (moved || blasesChanged)
+    {
+        const bool refit = _tlasRefits < TlasRefitsPerRebuild;
+        _tlasRefits      = refit ? _tlasRefits + 1 : 0;
+        recordTlasBuild(device, commandBuffer, refit);
+    }
+
+    vk::MemoryBarrier writeBarrier {
+        .srcAccessMask =
+            vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+        .dstAccessMask =
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eAccelerationStructureReadKHR,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer |
+                                      vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                  vk::PipelineStageFlagBits::eVertexShader |
+                                      vk::PipelineStageFlagBits::eComputeShader |
+                                      vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                                  {},
+                                  writeBarrier,
+                                  {},
+                                  {});
+
+    _dirtyBegin = std::numeric_limits<uint32_t>::max();
+    _dirtyEnd   = 0;
+
+    return true;
+}
+
+bool Scene::settleInstances()
+{
+    if (_settlingInstances.empty() && _movedInstances.empty())
+    {
+        return false;
+    }
+
+    bool settled = false;
+
+    // Instances that moved last update but not this one still report last update's motion
+    shader::Instance* instances = _instanceStaging.mapAs<shader::Instance>();
+    for (uint32_t instance : _settlingInstances)
+    {
+        if (_instanceMoved[instance])
+        {
+            continue;
+        }
+
+        instances[instance].PreviousTransform = instances[instance].Transform;
+
+        _dirtyBegin = std::min(_dirtyBegin, instance);
+        _dirtyEnd   = std::max(_dirtyEnd, instance + 1);
+        settled     = true;
+    }
+    _instanceStaging.unmap();
+
+    for (uint32_t instance : _movedInstances)
+    {
+        _instanceMoved[instance] = false;
+    }
+
+    _settlingInstances.swap(_movedInstances);
+    _movedInstances.clear();
+
+    return settled;
+}
+
+shader::InstanceBounds Scene::computeWorldBounds(const nvh::GltfPrimMesh& mesh,
+                                                 const nvmath::mat4&      worldMatrix)
+{
+    nvmath::vec3 boxMin(std::numeric_limits<float>::max());
+    nvmath::vec3 boxMax(-std::numeric_limits<float>::max());
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        nvmath::vec4 corner((i & 1) ? mesh.posMax.x : mesh.posMin.x,
+                            (i & 2) ? mesh.posMax.y : mesh.posMin.y,
+                            (i & 4) ? mesh.posMax.z : mesh.posMin.z,
+                            1.0f);
+        nvmath::vec4 transformed = worldMatrix * corner;
+
+        boxMin = nvmath::nv_min(boxMin, nvmath::vec3(transformed));
+        boxMax = nvmath::nv_max(boxMax, nvmath::vec3(transformed));
+    }
+
+    return {.boxMin = nvmath::vec4(boxMin, 1.0f), .boxMax = nvmath::vec4(boxMax, 1.0f)};
+}
+
+vk::TransformMatrixKHR Scene::toTransformMatrix(const nvmath::mat4& worldMatrix)
+{
+    vk::TransformMatrixKHR transformMatrix;
+    for (std::size_t y = 0; y < 3; ++y)
+    {
+        for (std::size_t x = 0; x < 4; ++x)
+        {
+            transformMatrix.matrix[y][x] = worldMatrix.mat_array[x * 4 + y];
+        }
+    }
+
+    return transformMatrix;
+}
 
-    UniqueBuffer tlasScratchBuffer = createScratchBuffer(buildSize.buildScratchSize, allocator);
-    tlasAccelerationBuildGeometryInfo.scratchData.deviceAddress =
-        device.getBufferAddress({.buffer = *tlasScratchBuffer});
+vk::AccelerationStructureBuildGeometryInfoKHR
+Scene::getTlasBuildInfo(vk::Device                            device,
+                        vk::AccelerationStructureGeometryKHR& geometry,
+                        bool                                  update) const
+{
+    geometry = {
+        .geometryType = vk::GeometryTypeKHR::eInstances,
+        .geometry     = {.instances = {.arrayOfPointers = VK_FALSE,
+                                       .data            = {.deviceAddress = device.getBufferAddress(
+                                                {.buffer = *_tlasInstanceBuffer})}}},
+        .flags        = vk::GeometryFlagBitsKHR::eOpaque,
+    };
+
+    return {
+        .type  = vk::AccelerationStructureTypeKHR::eTopLevel,
+        .flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
+                 vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate,
+        .mode  = update ? vk::BuildAccelerationStructureModeKHR::eUpdate
+                        : vk::BuildAccelerationStructureModeKHR::eBuild,
+        .srcAccelerationStructure = update ? *TLAS : nullptr,
+        .dstAccelerationStructure = *TLAS,
+        .geometryCount            = 1,
+        .pGeometries              = &geometry,
+    };
+}
+
+void Scene::recordTlasBuild(vk::Device device, vk::CommandBuffer commandBuffer, bool update) const
+{
+    vk::AccelerationStructureGeometryKHR          geometry;
+    vk::AccelerationStructureBuildGeometryInfoKHR buildInfo =
+        getTlasBuildInfo(device, geometry, update);
+    buildInfo.scratchData.deviceAddress = device.getBufferAddress({.buffer = *_tlasScratchBuffer});
 
-    vk::AccelerationStructureBuildRangeInfoKHR tlasAccelerationBuildOffsetInfo {
-        .primitiveCount  = static_cast<uint32_t>(tlasInstance.size()),
+    vk::AccelerationStructureBuildRangeInfoKHR rangeInfo {
+        .primitiveCount  = InstanceCount,
         .primitiveOffset = 0,
         .firstVertex     = 0,
         .transformOffset = 0,
     };
 
-    transientCommandBuffer.begin();
-    transientCommandBuffer->buildAccelerationStructuresKHR(tlasAccelerationBuildGeometryInfo,
-                                                           &tlasAccelerationBuildOffsetInfo);
-    transientCommandBuffer.submitAndWait();
+    commandBuffer.buildAccelerationStructuresKHR(buildInfo, &rangeInfo);
+}
+
+void Scene::recordSkinnedBlasBuilds(vk::Device        device,
+                                    vk::CommandBuffer commandBuffer,
+                                    bool              update) const
+{
+    std::vector<BlasGeometries> geometries(_skinnedBlases.size());
+    std::vector<BlasRanges>     ranges(_skinnedBlases.size());
+
+    std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> buildInfos(_skinnedBlases.size());
+    std::vector<const vk::AccelerationStructureBuildRangeInfoKHR*> rangeInfoPointers;
+
+    for (std::size_t i = 0; i < _skinnedBlases.size(); ++i)
+    {
+        const SkinnedBlas& blas = _skinnedBlases[i];
+
+        buildInfos[i] = getSkinnedBlasBuildInfo(device, blas, geometries[i], ranges[i], update);
+        buildInfos[i].scratchData.deviceAddress =
+            device.getBufferAddress({.buffer = *blas.scratch});
+
+        rangeInfoPointers.push_back(ranges[i].data());
+    }
+
+    commandBuffer.buildAccelerationStructuresKHR(buildInfos, rangeInfoPointers);
+}
+
+vk::AccelerationStructureBuildGeometryInfoKHR
+Scene::getSkinnedBlasBuildInfo(vk::Device         device,
+                               const SkinnedBlas& blas,
+                               BlasGeometries&    geometries,
+                               BlasRanges&        ranges,
+                               bool               update) const
+{
+    const uint32_t geometryCount =
+        getBlasGeometries(device, blas.primMesh, blas.firstVertex, geometries, ranges);
+
+    // Fast builds suit structures that are refitted every frame and rebuilt regularly
+    return {
+        .type  = vk::AccelerationStructureTypeKHR::eBottomLevel,
+        .flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastBuild |
+                 vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate,
+        .mode  = update ? vk::BuildAccelerationStructureModeKHR::eUpdate
+                        : vk::BuildAccelerationStructureModeKHR::eBuild,
+        .srcAccelerationStructure = update ? *blas.structure : nullptr,
+        .dstAccelerationStructure = *blas.structure,
+        .geometryCount            = geometryCount,
+        .pGeometries              = geometries.data(),
+    };
+}
+
+uint32_t Scene::getBlasGeometries(vk::Device      device,
+                                  uint32_t        primMesh,
+                                  uint32_t        firstVertex,
+                                  BlasGeometries& geometries,
+                                  BlasRanges&     ranges) const
+{
+    const nvh::GltfPrimMesh&              mesh   = GltfScene.m_primMeshes[primMesh];
+    const std::optional<MaskedTriangles>& masked = _maskedTriangles[primMesh];
+
+    vk::AccelerationStructureGeometryTrianglesDataKHR triangles {
+        .vertexFormat = vk::Format::eR32G32B32Sfloat,
+        .vertexData   = {.deviceAddress = device.getBufferAddress({.buffer = *Positions})},
+        .vertexStride = sizeof(nvmath::vec3f),
+        .maxVertex    = mesh.vertexCount,
+        .indexType    = vk::IndexType::eUint32,
+        .indexData    = {.deviceAddress = device.getBufferAddress(
+                             {.buffer = masked ? *AlphaTestIndices : *Indices})},
+    };
+
+    geometries[0] = {
+        .geometryType = vk::GeometryTypeKHR::eTriangles,
+        .geometry     = {.triangles = triangles},
+        .flags        = vk::GeometryFlagBitsKHR::eOpaque,
+    };
+
+    if (!masked)
+    {
+        ranges[0] = {
+            .primitiveCount  = mesh.indexCount / 3,
+            .primitiveOffset = static_cast<uint32_t>(mesh.firstIndex * sizeof(uint32_t)),
+            .firstVertex     = firstVertex,
+            .transformOffset = 0,
+        };
+        ranges[1] = {};
+
+        return 1;
+    }
+
+    // Only this geometry invokes the any-hit shader, whose primitive ids count from its start
+    geometries[1] = {
+        .geometryType = vk::GeometryTypeKHR::eTriangles,
+        .geometry     = {.triangles = triangles},
+    };
+
+    const uint32_t testedFirstIndex = masked->firstIndex + 3 * masked->opaqueCount;
+
+    ranges[0] = {
+        .primitiveCount  = masked->opaqueCount,
+        .primitiveOffset = static_cast<uint32_t>(masked->firstIndex * sizeof(uint32_t)),
+        .firstVertex     = firstVertex,
+        .transformOffset = 0,
+    };
+    ranges[1] = {
+        .primitiveCount  = masked->testedCount,
+        .primitiveOffset = static_cast<uint32_t>(testedFirstIndex * sizeof(uint32_t)),
+        .firstVertex     = firstVertex,
+        .transformOffset = 0,
+    };
+
+    return 2;
+}
+
+std::vector<uint32_t> Scene::classifyMaskedTriangles()
+{
+    std::vector<uint32_t> alphaTestIndices;
+
+    _maskedTriangles.resize(GltfScene.m_primMeshes.size());
+    for (std::size_t i = 0; i < GltfScene.m_primMeshes.size(); ++i)
+    {
+        const nvh::GltfPrimMesh& mesh     = GltfScene.m_primMeshes[i];
+        const nvh::GltfMaterial& material = GltfScene.m_materials[mesh.materialIndex];
+        if (material.alphaMode != ALPHA_MODE_MASK)
+        {
+            continue;
+        }
+
+        const bool    metallicRoughness = material.shadingModel == METALLIC_ROUGHNESS;
+        const int32_t albedoTexture =
+            metallicRoughness ? material.pbrBaseColorTexture : material.khrDiffuseTexture;
+        const float alphaFactor =
+            metallicRoughness ? material.pbrBaseColorFactor.w : material.khrDiffuseFactor.w;
+        const tinygltf::Image* image =
+            albedoTexture >= 0 ? &GltfScene.m_textures[albedoTexture] : nullptr;
+
+        std::vector<uint32_t> opaque;
+        std::vector<uint32_t> tested;
+        for (uint32_t t = 0; t < mesh.indexCount; t += 3)
+        {
+            const uint32_t* triangle = &GltfScene.m_indices[mesh.firstIndex + t];
+
+            std::array<nvmath::vec2, 3> uvs;
+            for (uint32_t corner = 0; corner < 3; ++corner)
+            {
+                uvs[corner] = GltfScene.m_texcoords0[mesh.vertexOffset + triangle[corner]];
+            }
+
+            switch (classifyTriangle(image, alphaFactor, material.alphaCutoff, uvs))
+            {
+                case TriangleOpacity::Opaque:
+                    opaque.insert(opaque.end(), triangle, triangle + 3);
+                    break;
+                case TriangleOpacity::Tested:
+                    tested.insert(tested.end(), triangle, triangle + 3);
+                    break;
+                case TriangleOpacity::Transparent:
+                    break;
+            }
+        }
+
+        _maskedTriangles[i] = MaskedTriangles {
+            .firstIndex  = static_cast<uint32_t>(alphaTestIndices.size()),
+            .opaqueCount = static_cast<uint32_t>(opaque.size() / 3),
+            .testedCount = static_cast<uint32_t>(tested.size() / 3),
+        };
+
+        alphaTestIndices.insert(alphaTestIndices.end(), opaque.begin(), opaque.end());
+        alphaTestIndices.insert(alphaTestIndices.end(), tested.begin(), tested.end());
+    }
+
+    return alphaTestIndices;
+}
+
+Scene::TriangleOpacity Scene::classifyTriangle(const tinygltf::Image*             image,
+                                               float                              alphaFactor,
+                                               float                              alphaCutoff,
+                                               const std::array<nvmath::vec2, 3>& uvs)
+{
+    if (image == nullptr || image->component != 4 || image->image.empty())
+    {
+        return alphaFactor >= alphaCutoff ? TriangleOpacity::Opaque : TriangleOpacity::Transparent;
+    }
+
+    // Every texel under the triangle's uv bounds, widened by one for bilinear filtering. The
+    // bounds cover more than the triangle, which only ever makes the answer more conservative.
+    const nvmath::vec2 uvMin = nvmath::nv_min(nvmath::nv_min(uvs[0], uvs[1]), uvs[2]);
+    const nvmath::vec2 uvMax = nvmath::nv_max(nvmath::nv_max(uvs[0], uvs[1]), uvs[2]);
+
+    const int64_t width  = image->width;
+    const int64_t height = image->height;
+    const int64_t minX   = static_cast<int64_t>(std::floor(uvMin.x * width - 0.5f));
+    const int64_t minY   = static_cast<int64_t>(std::floor(uvMin.y * height - 0.5f));
+    const int64_t maxX   = static_cast<int64_t>(std::floor(uvMax.x * width - 0.5f)) + 1;
+    const int64_t maxY   = static_cast<int64_t>(std::floor(uvMax.y * height - 0.5f)) + 1;
+
+    if ((maxX - minX + 1) * (maxY - minY + 1) > MaxClassifiedTexels)
+    {
+        return TriangleOpacity::Tested;
+    }
+
+    bool anyOpaque      = false;
+    bool anyTransparent = false;
+    for (int64_t y = minY; y <= maxY; ++y)
+    {
+        for (int64_t x = minX; x <= maxX; ++x)
+        {
+            // Scene samplers repeat
+            const int64_t texelX = (x % width + width) % width;
+            const int64_t texelY = (y % height + height) % height;
+
+            const float alpha =
+                image->image[(texelY * width + texelX) * 4 + 3] / 255.0f * alphaFactor;
+            (alpha >= alphaCutoff ? anyOpaque : anyTransparent) = true;
+
+            if (anyOpaque && anyTransparent)
+            {
+                return TriangleOpacity::Tested;
+            }
+        }
+    }
+
+    return anyOpaque ? TriangleOpacity::Opaque : TriangleOpacity::Transparent;
+}
+
+bool Scene::isSkinned(const nvh::GltfNode& node) const
+{
+    return node.skin >= 0 && !GltfScene.m_skins.empty();
+}
+
+std::vector<vk::DescriptorImageInfo> Scene::getTextureArrayInfo() const
+{
+    std::vector<vk::DescriptorImageInfo> textureInfo;
+    textureInfo.reserve(Textures.size() + 2);
+    for (const SceneTexture& texture : Textures)
+    {
+        textureInfo.push_back(texture.getDescriptorInfo());
+    }
+    textureInfo.push_back(DefaultWhiteTexture.getDescriptorInfo());
+    textureInfo.push_back(DefaultNormalTexture.getDescriptorInfo());
+
+    return textureInfo;
 }
 
 UniqueBuffer Scene::createAccelerationStructureBuffer(vk::DeviceSize   size,
@@ -536,35 +1300,42 @@ std::vector<shader::Bucket>
 Scene::createAliasTable(std::vector<shader::PointLight>&    pointLights,
                         std::vector<shader::TriangleLight>& triangleLights)
 {
-    std::queue<uint32_t> bigger;
-    std::queue<uint32_t> smaller;
-    std::vector<float>   lightProbabilityVec;
-    float                luminanceSum = 0.0f;
-    uint32_t             lightNum     = 0;
+    std::vector<float> lightProbabilityVec;
 
     if (!pointLights.empty())
     {
-        lightNum = static_cast<uint32_t>(pointLights.size());
-
         for (auto& pointLight : pointLights)
         {
-            luminanceSum += pointLight.color_luminance.w;
             lightProbabilityVec.push_back(pointLight.color_luminance.w);
         }
     }
     else
     {
-        lightNum = static_cast<uint32_t>(triangleLights.size());
-
         for (auto& triangleLight : triangleLights)
         {
-            float triangleLightLuminance =
-                triangleLight.emission_luminance.w * triangleLight.normalArea.w;
-            luminanceSum += triangleLightLuminance;
-            lightProbabilityVec.push_back(triangleLightLuminance);
+            lightProbabilityVec.push_back(triangleLight.emission_luminance.w *
+                                          triangleLight.normalArea.w);
         }
     }
 
+    return createAliasTable(std::move(lightProbabilityVec));
+}
+
+std::vector<shader::Bucket> Scene::createAliasTable(std::vector<float> lightProbabilityVec)
+{
+    std::queue<uint32_t> bigger;
+    std::queue<uint32_t> smaller;
+    const uint32_t       lightNum     = static_cast<uint32_t>(lightProbabilityVec.size());
+    float                luminanceSum = std::accumulate(lightProbabilityVec.begin(),
+                                                        lightProbabilityVec.end(),
+                                                        0.0f);
+
+    if (luminanceSum <= 0.0f)
+    {
+        std::fill(lightProbabilityVec.begin(), lightProbabilityVec.end(), 1.0f);
+        luminanceSum = static_cast<float>(lightNum);
+    }
+
     std::vector<shader::Bucket> result(lightNum,
                                        shader::Bucket {
                                            .probability              = 0.0f,
@@ -633,3 +1404,97 @@ Scene::createAliasTable(std::vector<shader::PointLight>&    pointLights,
 
     return result;
 }
+
+void Scene::loadEnvironment(const std::string&      filename,
+                            bool                    hasLights,
+                            ResourceManager&        allocator,
+                            TransientCommandBuffer& transientCommandBuffer,
+                            vk::Device              device)
+{
+    int32_t            width  = 1;
+    int32_t            height = 1;
+    std::vector<float> texels(4, 0.0f);
+
+    if (!filename.empty())
+    {
+        int32_t channels;
+        float*  data = stbi_loadf(filename.c_str(), &width, &height, &channels, 4);
+        if (data == nullptr)
+        {
+            std::cout << "Error while loading environment: " << stbi_failure_reason()
+                      << std::endl;
+            std::abort();
+        }
+
+        texels.assign(data, data + 4 * static_cast<std::size_t>(width) * height);
+        stbi_image_free(data);
+    }
+
+    // Rows near the poles cover less solid angle than those at the horizon
+    std::vector<float>          rowWeights(height, 0.0f);
+    std::vector<shader::Bucket> texelBuckets;
+    texelBuckets.reserve(static_cast<std::size_t>(width) * height);
+    for (int32_t y = 0; y < height; ++y)
+    {
+        const float sinTheta = std::sin(std::numbers::pi_v<float> * (y + 0.5f) / height);
+
+        std::vector<float> texelWeights(width);
+        for (int32_t x = 0; x < width; ++x)
+        {
+            const float* texel = &texels[4 * (static_cast<std::size_t>(y) * width + x)];
+            texelWeights[x] =
+                (0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2]) * sinTheta;
+            rowWeights[y] += texelWeights[x];
+        }
+
+        std::vector<shader::Bucket> row = createAliasTable(std::move(texelWeights));
+        texelBuckets.insert(texelBuckets.end(), row.begin(), row.end());
+    }
+
+    std::vector<shader::Bucket> buckets = createAliasTable(std::move(rowWeights));
+    buckets.insert(buckets.end(), texelBuckets.begin(), texelBuckets.end());
+
+    float sampleProbability = 0.0f;
+    if (!filename.empty())
+    {
+        sampleProbability = hasLights ? EnvironmentSampleProbability : 1.0f;
+    }
+
+    shader::EnvironmentHeader header {
+        .width             = width,
+        .height            = height,
+        .sampleProbability = sampleProbability,
+    };
+
+    std::vector<uint8_t> distributionBlock(sizeof(header) +
+                                           sizeof(shader::Bucket) * buckets.size());
+    std::memcpy(distributionBlock.data(), &header, sizeof(header));
+    std::memcpy(distributionBlock.data() + sizeof(header),
+                buckets.data(),
+                sizeof(shader::Bucket) * buckets.size());
+
+    EnvironmentDistributionSize = distributionBlock.size();
+    EnvironmentDistribution =
+        allocator.createStaticTypedBuffer(distributionBlock,
+                                          vk::BufferUsageFlagBits::eStorageBuffer,
+                                          transientCommandBuffer);
+
+    // Sampled at the texel the distribution picked, so no filtering
+    const auto* texelBytes = reinterpret_cast<const unsigned char*>(texels.data());
+    Environment.Image     = ResourceManager::loadTexture(texelBytes,
+                                                     static_cast<uint32_t>(width),
+                                                     static_cast<uint32_t>(height),
+                                                     vk::Format::eR32G32B32A32Sfloat,
+                                                     1,
+                                                     allocator,
+                                                     transientCommandBuffer,
+                                                     static_cast<uint32_t>(4 * sizeof(float)));
+    Environment.Sampler   = allocator.createSampler(device,
+                                                  vk::Filter::eNearest,
+                                                  vk::Filter::eNearest,
+                                                  vk::SamplerMipmapMode::eNearest);
+    Environment.ImageView = allocator.createImageView2D(device,
+                                                        *Environment.Image,
+                                                        vk::Format::eR32G32B32A32Sfloat,
+                                                        vk::ImageAspectFlagBits::eColor);
+}
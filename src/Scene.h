@@ -4,8 +4,10 @@
 
 #include "ResourceManager.h"
 #include "ShaderInclude.h"
+#include "TextureCompressor.h"
 
 #include <random>
+#include <span>
 
 class TransientCommandBuffer;
 
@@ -30,38 +32,201 @@ public:
           ResourceManager&        allocator,
           TransientCommandBuffer& transientCommandBuffer,
           vk::Device              device,
-          uint32_t                pointLightCount);
+          uint32_t                pointLightCount,
+          bool                    compressTextures,
+          const std::string&      environmentFilename);
 
     nvh::GltfScene GltfScene;
 
-    UniqueBuffer Vertices;
+    UniqueBuffer Positions;
+    UniqueBuffer Attributes;
     UniqueBuffer Indices;
-    UniqueBuffer Matrices;
+
+    // Triangles of alpha masked meshes, reordered for their BLASes and the any-hit alpha test
+    UniqueBuffer AlphaTestIndices;
+    UniqueBuffer Instances;
+    UniqueBuffer InstanceBounds;
     UniqueBuffer Materials;
+
+    // One command per mesh with instanceCount left at zero. Its firstInstance is where the
+    // mesh's instances start in the instance table.
+    UniqueBuffer MeshDrawCommands;
     UniqueBuffer PointLights;
     UniqueBuffer TriangleLights;
     UniqueBuffer AliasTable;
 
-    std::vector<SceneTexture> Textures;
-    SceneTexture              DefaultNormalTexture;
-    SceneTexture              DefaultWhiteTexture;
+    // Equirectangular HDR sky, a single black texel when the scene has none. Its distribution
+    // is the header, an alias table over rows, then one over the texels of every row, weighted
+    // by luminance times solid angle.
+    SceneTexture Environment;
+    UniqueBuffer EnvironmentDistribution;
+
+    // Skinning inputs, only created when the scene has skinned nodes. SkinVertices is indexed
+    // like the bind pose vertices, JointMatrices holds every skin's joints back to back.
+    UniqueBuffer SkinVertices;
+    UniqueBuffer JointMatrices;
+    UniqueBuffer SkinJobs;
+
+    std::vector<SceneTexture>      Textures;
+    std::vector<CompressedTexture> TextureSources;
+    SceneTexture                   DefaultNormalTexture;
+    SceneTexture                   DefaultWhiteTexture;
+
+    uint32_t InstanceCount = 0;
+    uint32_t MeshDrawCount = 0;
+
+    // One job per skinned instance, and the vertex count of the largest one
+    uint32_t SkinJobCount       = 0;
+    uint32_t SkinnedVertexCount = 0;
 
     vk::DeviceSize PointLightsSize;
     vk::DeviceSize TriangleLightsSize;
     vk::DeviceSize AliasTableSize;
+    vk::DeviceSize EnvironmentDistributionSize;
 
     vk::UniqueAccelerationStructureKHR TLAS;
 
+    // Scene textures followed by the default white and default normal textures, in the order
+    // the material texture indices refer to.
+    std::vector<vk::DescriptorImageInfo> getTextureArrayInfo() const;
+
+    struct NodeTransform
+    {
+        uint32_t     Node;
+        nvmath::mat4 WorldMatrix;
+    };
+
+    // Moves nodes. The GPU copies only change with the next recordUpdate.
+    void setNodeTransforms(std::span<const NodeTransform> transforms);
+
+    // Poses a skin, jointWorldMatrices follows the order of the skin's joint list
+    void setSkinJoints(uint32_t skin, std::span<const nvmath::mat4> jointWorldMatrices);
+
+    // Whether a skin was posed since the last call, the rest pose set at load counts as one
+    bool takeSkinPoseChange();
+
+    // Records the instance table uploads and the TLAS refit for every node moved since the last
+    // call, or for BLASes changed by the commands already in commandBuffer. Returns false
+    // without touching commandBuffer when neither happened.
+    bool recordUpdate(vk::Device device, vk::CommandBuffer commandBuffer, bool blasesChanged);
+
+    // Rebuilds or refits the BLAS of every skinned instance from the current Positions
+    void recordSkinnedBlasBuilds(vk::Device        device,
+                                 vk::CommandBuffer commandBuffer,
+                                 bool              update) const;
+
 private:
+    static constexpr uint32_t TlasRefitsPerRebuild = 64;
+
+    // Triangles covering more texels than this are left to the any-hit shader unclassified
+    static constexpr int64_t MaxClassifiedTexels = 4096;
+
+    // Share of light candidates drawn from the environment when the scene has lights of its own
+    static constexpr float EnvironmentSampleProbability = 0.5f;
+
+    // Where an alpha masked mesh's triangles are in AlphaTestIndices: first those opaque
+    // everywhere, then those the any-hit shader has to test. Fully cut out ones are left out.
+    struct MaskedTriangles
+    {
+        uint32_t firstIndex;
+        uint32_t opaqueCount;
+        uint32_t testedCount;
+    };
+
+    enum class TriangleOpacity
+    {
+        Opaque,
+        Transparent,
+        Tested,
+    };
+
+    using BlasGeometries = std::array<vk::AccelerationStructureGeometryKHR, 2>;
+    using BlasRanges     = std::array<vk::AccelerationStructureBuildRangeInfoKHR, 2>;
+
+    struct SkinnedBlas
+    {
+        uint32_t                           primMesh;
+        uint32_t                           firstVertex;
+        vk::UniqueAccelerationStructureKHR structure;
+        UniqueBuffer                       scratch;
+    };
+
     UniqueBuffer                                    _tlasInstanceBuffer;
+    UniqueBuffer                                    _tlasScratchBuffer;
+    UniqueBuffer                                    _instanceStaging;
+    UniqueBuffer                                    _instanceBoundsStaging;
     std::vector<vk::UniqueAccelerationStructureKHR> _blases;
+    std::vector<SkinnedBlas>                        _skinnedBlases;
     std::vector<UniqueBuffer>                       _asAllocations;
 
+    // Instance table slot of every node
+    std::vector<uint32_t> _nodeInstances;
+
+    // Where every skin's joints start in JointMatrices
+    std::vector<uint32_t> _firstJoints;
+
+    // Per prim mesh, empty for meshes that are not alpha masked
+    std::vector<std::optional<MaskedTriangles>> _maskedTriangles;
+
+    // Instances moved since the last recordUpdate, and those moved in the update before it
+    std::vector<uint32_t> _movedInstances;
+    std::vector<uint32_t> _settlingInstances;
+    std::vector<bool>     _instanceMoved;
+
+    // Range of instances moved since the last recordUpdate
+    uint32_t _dirtyBegin = std::numeric_limits<uint32_t>::max();
+    uint32_t _dirtyEnd   = 0;
+    uint32_t _tlasRefits = 0;
+
+    bool _skinPoseChanged = false;
+
     static UniqueBuffer createAccelerationStructureBuffer(vk::DeviceSize size, ResourceManager&
                                                                              allocator);
 
     static UniqueBuffer createScratchBuffer(vk::DeviceSize size, ResourceManager& allocator);
 
+    static vk::TransformMatrixKHR toTransformMatrix(const nvmath::mat4& worldMatrix);
+
+    // Fills geometry, which the returned info points at
+    vk::AccelerationStructureBuildGeometryInfoKHR
+    getTlasBuildInfo(vk::Device                            device,
+                     vk::AccelerationStructureGeometryKHR& geometry,
+                     bool                                  update) const;
+
+    void recordTlasBuild(vk::Device device, vk::CommandBuffer commandBuffer, bool update) const;
+
+    // Catches PreviousTransform up for instances that stopped moving, returns whether any did
+    bool settleInstances();
+
+    // Fills geometries and ranges, which the returned info points at
+    vk::AccelerationStructureBuildGeometryInfoKHR
+    getSkinnedBlasBuildInfo(vk::Device         device,
+                            const SkinnedBlas& blas,
+                            BlasGeometries&    geometries,
+                            BlasRanges&        ranges,
+                            bool               update) const;
+
+    // An opaque geometry, plus one left to the any-hit shader for alpha masked meshes. Returns
+    // how many were filled.
+    uint32_t getBlasGeometries(vk::Device      device,
+                               uint32_t        primMesh,
+                               uint32_t        firstVertex,
+                               BlasGeometries& geometries,
+                               BlasRanges&     ranges) const;
+
+    // Sorts the triangles of alpha masked meshes by what their albedo alpha says about them,
+    // so most alpha tests are settled before any ray is traced
+    std::vector<uint32_t>  classifyMaskedTriangles();
+    static TriangleOpacity classifyTriangle(const tinygltf::Image*             image,
+                                            float                              alphaFactor,
+                                            float                              alphaCutoff,
+                                            const std::array<nvmath::vec2, 3>& uvs);
+
+    bool isSkinned(const nvh::GltfNode& node) const;
+
+    static shader::InstanceBounds computeWorldBounds(const nvh::GltfPrimMesh& mesh,
+                                                     const nvmath::mat4&      worldMatrix);
+
     static std::vector<shader::PointLight> collectPointLights(const nvh::GltfScene& scene);
     static std::vector<shader::PointLight> generateRandomPointLights(
         std::size_t                           count,
@@ -80,6 +245,15 @@ private:
     createAliasTable(std::vector<shader::PointLight>&    pointLights,
                      std::vector<shader::TriangleLight>& triangleLights);
 
+    // Weights that are all zero are sampled uniformly
+    static std::vector<shader::Bucket> createAliasTable(std::vector<float> weights);
+
+    void loadEnvironment(const std::string&      filename,
+                         bool                    hasLights,
+                         ResourceManager&        allocator,
+                         TransientCommandBuffer& transientCommandBuffer,
+                         vk::Device              device);
+
     template<typename T>
     constexpr T ceilDiv(T a, T b)
     {
@@ -91,4 +265,19 @@ private:
     {
         return ceilDiv(sizeof(PreArray), alignof(Struct)) * alignof(Struct);
     }
+
+    // Lays out an element count followed by the array, matching the shader-side
+    // `int count; ... Struct elements[];` storage blocks.
+    template<typename Struct, typename PreArray>
+    std::vector<uint8_t> packCountedArray(const std::vector<Struct>& elements)
+    {
+        const std::size_t arrayOffset = alignPreArrayBlock<Struct, PreArray>();
+
+        std::vector<uint8_t> result(arrayOffset + sizeof(Struct) * elements.size(), 0);
+        *reinterpret_cast<int32_t*>(result.data()) = static_cast<int32_t>(elements.size());
+        std::memcpy(result.data() + arrayOffset,
+                    elements.data(),
+                    sizeof(Struct) * elements.size());
+        return result;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "ShaderHotReload.h"
+
+#ifdef ENABLE_SHADER_HOT_RELOAD
+
+#include <shaderc/shaderc.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+
+namespace
+{
+std::optional<shaderc_shader_kind> toShaderKind(const std::filesystem::path& path)
+{
+    static const std::unordered_map<std::string, shaderc_shader_kind> kinds {
+        {".vert", shaderc_vertex_shader},
+        {".frag", shaderc_fragment_shader},
+        {".comp", shaderc_compute_shader},
+        {".rgen", shaderc_raygen_shader},
+        {".rchit", shaderc_closesthit_shader},
+        {".rahit", shaderc_anyhit_shader},
+        {".rmiss", shaderc_miss_shader},
+    };
+
+    auto kind = kinds.find(path.extension().string());
+    if (kind == kinds.end())
+    {
+        return std::nullopt;
+    }
+
+    return kind->second;
+}
+
+std::string readText(const std::filesystem::path& path)
+{
+    std::ifstream      file(path);
+    std::ostringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+// Includes are relative to the including file first and the shader root second
+std::filesystem::path resolveInclude(const std::filesystem::path& includer,
+                                     const std::string&           name,
+                                     const std::filesystem::path& root)
+{
+    std::filesystem::path path = includer.parent_path() / name;
+    if (!std::filesystem::exists(path))
+    {
+        path = root / name;
+    }
+
+    return std::filesystem::weakly_canonical(path);
+}
+
+class Includer : public shaderc::CompileOptions::IncluderInterface
+{
+public:
+    explicit Includer(std::filesystem::path root)
+        : _root(std::move(root))
+    {}
+
+    shaderc_include_result* GetInclude(const char* requestedSource,
+                                       shaderc_include_type /*type*/,
+                                       const char* requestingSource,
+                                       size_t /*depth*/) override
+    {
+        auto* include = new Include;
+
+        std::filesystem::path path = resolveInclude(requestingSource, requestedSource, _root);
+        if (std::filesystem::exists(path))
+        {
+            include->name    = path.string();
+            include->content = readText(path);
+        }
+        else
+        {
+            // An empty name tells shaderc the include failed, the content is the error
+            include->content = "Cannot find " + std::string(requestedSource);
+        }
+
+        include->result = {
+            .source_name        = include->name.data(),
+            .source_name_length = include->name.size(),
+            .content            = include->content.data(),
+            .content_length     = include->content.size(),
+            .user_data          = include,
+        };
+
+        return &include->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* result) override
+    {
+        delete static_cast<Include*>(result->user_data);
+    }
+
+private:
+    struct Include
+    {
+        std::string            name;
+        std::string            content;
+        shaderc_include_result result;
+    };
+
+    std::filesystem::path _root;
+};
+} // namespace
+
+ShaderHotReload::ShaderHotReload(const std::filesystem::path& sourceDirectory,
+                                 const std::filesystem::path& outputDirectory)
+    : _sourceDirectory(sourceDirectory)
+    , _outputDirectory(outputDirectory)
+    , _lastPoll(std::chrono::steady_clock::now())
+{
+    // The build already compiled whatever is on disk now
+    collectChanges();
+}
+
+std::vector<std::string> ShaderHotReload::poll()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - _lastPoll < PollInterval)
+    {
+        return {};
+    }
+    _lastPoll = now;
+
+    std::unordered_set<std::string> changes = collectChanges();
+    if (changes.empty())
+    {
+        return {};
+    }
+
+    std::vector<std::string> reloaded;
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::directory_iterator(_sourceDirectory))
+    {
+        if (!entry.is_regular_file() || !toShaderKind(entry.path()) ||
+            !dependsOn(entry.path(), changes))
+        {
+            continue;
+        }
+
+        if (compile(entry.path()))
+        {
+            reloaded.push_back(entry.path().filename().string());
+        }
+    }
+
+    return reloaded;
+}
+
+std::unordered_set<std::string> ShaderHotReload::collectChanges()
+{
+    std::unordered_set<std::string> changes;
+
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::recursive_directory_iterator(_sourceDirectory, error))
+    {
+        if (!entry.is_regular_file())
+        {
+            continue;
+        }
+
+        // Editors save by truncating and rewriting, a failed query is retried next poll
+        std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+        if (error)
+        {
+            continue;
+        }
+
+        std::string path = std::filesystem::weakly_canonical(entry.path()).string();
+        auto [time, inserted] = _writeTimes.try_emplace(path, writeTime);
+        if (!inserted && time->second != writeTime)
+        {
+            time->second = writeTime;
+            changes.insert(path);
+        }
+    }
+
+    return changes;
+}
+
+bool ShaderHotReload::dependsOn(const std::filesystem::path&          shader,
+                                const std::unordered_set<std::string>& files) const
+{
+    std::vector<std::filesystem::path> pending {std::filesystem::weakly_canonical(shader)};
+    std::unordered_set<std::string>    visited;
+
+    while (!pending.empty())
+    {
+        std::filesystem::path file = std::move(pending.back());
+        pending.pop_back();
+
+        if (!visited.insert(file.string()).second)
+        {
+            continue;
+        }
+
+        if (files.contains(file.string()))
+        {
+            return true;
+        }
+
+        for (const std::filesystem::path& include : parseIncludes(file))
+        {
+            pending.push_back(resolveInclude(file, include.string(), _sourceDirectory));
+        }
+    }
+
+    return false;
+}
+
+bool ShaderHotReload::compile(const std::filesystem::path& shader) const
+{
+    shaderc::Compiler       compiler;
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+    options.SetIncluder(std::make_unique<Includer>(_sourceDirectory));
+
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(readText(shader),
+                                                                     *toShaderKind(shader),
+                                                                     shader.string().c_str(),
+                                                                     options);
+
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+    {
+        std::cout << "Failed to compile " << shader.filename().string() << ":" << std::endl
+                  << result.GetErrorMessage() << std::endl;
+        return false;
+    }
+
+    std::filesystem::path output = _outputDirectory / (shader.filename().string() + ".spv");
+    std::ofstream         file(output, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(result.cbegin()),
+               (result.cend() - result.cbegin()) * sizeof(uint32_t));
+
+    return true;
+}
+
+std::vector<std::filesystem::path> ShaderHotReload::parseIncludes(const std::filesystem::path& file)
+{
+    std::vector<std::filesystem::path> includes;
+
+    std::ifstream stream(file);
+    std::string   line;
+    while (std::getline(stream, line))
+    {
+        std::size_t directive = line.find("#include");
+        if (directive == std::string::npos)
+        {
+            continue;
+        }
+
+        std::size_t begin = line.find('"', directive);
+        std::size_t end   = line.find('"', begin + 1);
+        if (begin != std::string::npos && end != std::string::npos)
+        {
+            includes.emplace_back(line.substr(begin + 1, end - begin - 1));
+        }
+    }
+
+    return includes;
+}
+
+#endif
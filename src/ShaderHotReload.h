@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Watches the GLSL sources and recompiles every shader whose file, or any file it includes, was
+// modified. The SPIR-V is written over the build output so passes can recreate their pipelines
+// from the usual paths.
+class ShaderHotReload
+{
+public:
+    ShaderHotReload() = default;
+    ShaderHotReload(const std::filesystem::path& sourceDirectory,
+                    const std::filesystem::path& outputDirectory);
+
+    // Returns the file names of the shaders that were recompiled successfully, e.g. restir.rgen.
+    // Shaders that fail to compile keep their previous binary.
+    std::vector<std::string> poll();
+
+private:
+    static constexpr std::chrono::milliseconds PollInterval {250};
+
+    std::filesystem::path _sourceDirectory;
+    std::filesystem::path _outputDirectory;
+
+    std::unordered_map<std::string, std::filesystem::file_time_type> _writeTimes;
+    std::chrono::steady_clock::time_point                            _lastPoll;
+
+    std::unordered_set<std::string> collectChanges();
+    bool dependsOn(const std::filesystem::path&          shader,
+                   const std::unordered_set<std::string>& files) const;
+    bool compile(const std::filesystem::path& shader) const;
+
+    static std::vector<std::filesystem::path> parseIncludes(const std::filesystem::path& file);
+};
@@ -2,6 +2,10 @@
 
 #include "TransientCommandBuffer.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
 bool    Formats::_initialized = false;
 Formats Formats::_framebufferFormats;
 
@@ -35,6 +39,11 @@ void Formats::initialize(vk::PhysicalDevice physicalDevice)
                             physicalDevice,
                             vk::ImageTiling::eOptimal,
                             vk::FormatFeatureFlagBits::eColorAttachment);
+    _framebufferFormats.MotionVector =
+        findSupportedFormat({vk::Format::eR16G16B16A16Sfloat, vk::Format::eR32G32B32A32Sfloat},
+                            physicalDevice,
+                            vk::ImageTiling::eOptimal,
+                            vk::FormatFeatureFlagBits::eColorAttachment);
     _framebufferFormats.DepthAspectFlags = vk::ImageAspectFlagBits::eDepth;
     if (_framebufferFormats.Depth != vk::Format::eD32Sfloat)
     {
@@ -92,12 +101,14 @@ void Framebuffer::resize(ResourceManager&        allocator,
     NormalView.reset();
     MaterialPropertiesView.reset();
     WorldPositionView.reset();
+    MotionVectorView.reset();
     DepthView.reset();
 
     AlbedoImage.reset();
     NormalImage.reset();
     MaterialPropertiesImage.reset();
     WorldPositionImage.reset();
+    MotionVectorImage.reset();
     DepthImage.reset();
 
     const Formats& formats = Formats::get();
@@ -118,6 +129,10 @@ void Framebuffer::resize(ResourceManager&        allocator,
                                                  formats.WorldPosition,
                                                  vk::ImageUsageFlagBits::eColorAttachment |
                                                      vk::ImageUsageFlagBits::eSampled);
+    MotionVectorImage       = allocator.createImage2D(screenSize,
+                                                formats.MotionVector,
+                                                vk::ImageUsageFlagBits::eColorAttachment |
+                                                    vk::ImageUsageFlagBits::eSampled);
     DepthImage              = allocator.createImage2D(screenSize,
                                          formats.Depth,
                                          vk::ImageUsageFlagBits::eDepthStencilAttachment |
@@ -139,14 +154,19 @@ void Framebuffer::resize(ResourceManager&        allocator,
                                                     *WorldPositionImage,
                                                     formats.WorldPosition,
                                                     vk::ImageAspectFlagBits::eColor);
+    MotionVectorView       = allocator.createImageView2D(device,
+                                                   *MotionVectorImage,
+                                                   formats.MotionVector,
+                                                   vk::ImageAspectFlagBits::eColor);
     DepthView =
         allocator.createImageView2D(device, *DepthImage, formats.Depth, formats.DepthAspectFlags);
 
-    std::array<vk::ImageView, 5> attachments {
+    std::array<vk::ImageView, 6> attachments {
         *AlbedoView,
         *NormalView,
         *MaterialPropertiesView,
         *WorldPositionView,
+        *MotionVectorView,
         *DepthView,
     };
 
@@ -181,6 +201,11 @@ void Framebuffer::transitionFramebufferLayouts(TransientCommandBuffer& transient
                                            Formats::get().WorldPosition,
                                            vk::ImageLayout::eUndefined,
                                            vk::ImageLayout::eShaderReadOnlyOptimal);
+    ResourceManager::transitionImageLayout(*transientCommandBuffer,
+                                           *MotionVectorImage,
+                                           Formats::get().MotionVector,
+                                           vk::ImageLayout::eUndefined,
+                                           vk::ImageLayout::eShaderReadOnlyOptimal);
     ResourceManager::transitionImageLayout(*transientCommandBuffer,
                                            *DepthImage,
                                            Formats::get().Depth,
@@ -188,4 +213,91 @@ void Framebuffer::transitionFramebufferLayouts(TransientCommandBuffer& transient
                                            vk::ImageLayout::eShaderReadOnlyOptimal);
 
     transientCommandBuffer.submitAndWait();
-}
\ No newline at end of file
+}
+
+VertexAttributes VertexAttributes::pack(const nvmath::vec3& normal,
+                                        const nvmath::vec4& tangent,
+                                        const nvmath::vec4& color,
+                                        const nvmath::vec2& uv)
+{
+    auto toSnorm16 = [](float value) {
+        return static_cast<uint32_t>(static_cast<uint16_t>(
+            static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f))));
+    };
+    auto toUnorm = [](float value, float maxValue) {
+        return static_cast<uint32_t>(std::round(std::clamp(value, 0.0f, 1.0f) * maxValue));
+    };
+
+    nvmath::vec2 octNormal  = octahedralEncode(normal);
+    nvmath::vec2 octTangent = octahedralEncode(nvmath::vec3(tangent.x, tangent.y, tangent.z));
+
+    VertexAttributes result;
+    result.normal  = toSnorm16(octNormal.x) | (toSnorm16(octNormal.y) << 16);
+    result.tangent = toUnorm(octTangent.x * 0.5f + 0.5f, 65535.0f) |
+                     (toUnorm(octTangent.y * 0.5f + 0.5f, 32767.0f) << 16) |
+                     (tangent.w < 0.0f ? 0x80000000u : 0u);
+    result.color   = toUnorm(color.x, 255.0f) | (toUnorm(color.y, 255.0f) << 8) |
+                     (toUnorm(color.z, 255.0f) << 16) | (toUnorm(color.w, 255.0f) << 24);
+    result.uv      = static_cast<uint32_t>(floatToHalf(uv.x)) |
+                     (static_cast<uint32_t>(floatToHalf(uv.y)) << 16);
+    return result;
+}
+
+nvmath::vec2 VertexAttributes::octahedralEncode(const nvmath::vec3& direction)
+{
+    float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (length == 0.0f)
+    {
+        return nvmath::vec2(0.0f, 0.0f);
+    }
+
+    nvmath::vec2 encoded(direction.x / length, direction.y / length);
+    if (direction.z < 0.0f)
+    {
+        encoded = nvmath::vec2((1.0f - std::abs(encoded.y)) * (encoded.x >= 0.0f ? 1.0f : -1.0f),
+                               (1.0f - std::abs(encoded.x)) * (encoded.y >= 0.0f ? 1.0f : -1.0f));
+    }
+
+    return encoded;
+}
+
+uint16_t VertexAttributes::floatToHalf(float value)
+{
+    uint32_t bits     = std::bit_cast<uint32_t>(value);
+    uint32_t sign     = (bits >> 16) & 0x8000u;
+    uint32_t mantissa = bits & 0x007FFFFFu;
+    int32_t  exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+
+    if (((bits >> 23) & 0xFFu) == 0xFFu)
+    {
+        return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x0200u : 0u));
+    }
+
+    if (exponent >= 31)
+    {
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+
+    // Round to nearest even on the bits shifted out; a carry out of the mantissa correctly
+    // bumps the exponent.
+    auto round = [](uint32_t half, uint32_t source, uint32_t shift) {
+        uint32_t remainder = source & ((1u << shift) - 1u);
+        uint32_t halfway   = 1u << (shift - 1u);
+        return half + ((remainder > halfway || (remainder == halfway && (half & 1u))) ? 1u : 0u);
+    };
+
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+
+        mantissa |= 0x00800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        return static_cast<uint16_t>(sign | round(mantissa >> shift, mantissa, shift));
+    }
+
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    return static_cast<uint16_t>(sign | round(half, mantissa, 13));
+}
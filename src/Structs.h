@@ -27,12 +27,14 @@ public:
     UniqueImage NormalImage;
     UniqueImage MaterialPropertiesImage;
     UniqueImage WorldPositionImage;
+    UniqueImage MotionVectorImage;
     UniqueImage DepthImage;
 
     vk::UniqueImageView AlbedoView;
     vk::UniqueImageView NormalView;
     vk::UniqueImageView MaterialPropertiesView;
     vk::UniqueImageView WorldPositionView;
+    vk::UniqueImageView MotionVectorView;
     vk::UniqueImageView DepthView;
 
 private:
@@ -46,12 +48,23 @@ struct FramebufferData
     vk::UniqueCommandBuffer MainCommandBuffer;
 
     UniqueBuffer            ReservoirBuffer;
+    UniqueBuffer            GiReservoirBuffer;
+    UniqueBuffer            CandidateBudgetBuffer;
 
     vk::UniqueDescriptorSet SpatialReuseDescriptor;
     vk::UniqueDescriptorSet SpatialReuseSecondDescriptor;
     vk::UniqueDescriptorSet LightingPassDescriptorSet;
     vk::UniqueDescriptorSet RestirFrameDescriptor;
-    vk::UniqueDescriptorSet UnbiasedReusePassFrameDescriptor;
+    vk::UniqueDescriptorSet HiZSeedDescriptor;
+    vk::UniqueDescriptorSet GiFrameDescriptor;
+    vk::UniqueDescriptorSet GiSpatialReuseDescriptor;
+    vk::UniqueDescriptorSet DenoiseShadeDescriptor;
+    vk::UniqueDescriptorSet DenoiseTemporalDescriptor;
+    vk::UniqueDescriptorSet AccumulationDescriptor;
+    vk::UniqueDescriptorSet UpscaleDescriptor;
+
+    // One per a-trous iteration
+    std::vector<vk::UniqueDescriptorSet> DenoiseAtrousDescriptors;
 };
 
 struct Formats
@@ -61,6 +74,7 @@ struct Formats
     vk::Format           Depth;
     vk::Format           MaterialProperties;
     vk::Format           WorldPosition;
+    vk::Format           MotionVector;
     vk::ImageAspectFlags DepthAspectFlags;
 
     static void           initialize(vk::PhysicalDevice);
@@ -75,11 +89,21 @@ private:
     static Formats _framebufferFormats;
 };
 
-struct Vertex
+// Per-vertex shading attributes, streamed alongside the tightly packed float3 positions the
+// acceleration structures are built from.
+struct VertexAttributes
 {
-    nvmath::vec4 position;
-    nvmath::vec4 normal;
-    nvmath::vec4 tangent;
-    nvmath::vec4 color;
-    nvmath::vec2 uv;
+    uint32_t normal;  // Octahedral, 2x snorm16
+    uint32_t tangent; // Octahedral, unorm16 + unorm15, bitangent sign in the top bit
+    uint32_t color;   // RGBA8 unorm
+    uint32_t uv;      // 2x half
+
+    static VertexAttributes pack(const nvmath::vec3& normal,
+                                 const nvmath::vec4& tangent,
+                                 const nvmath::vec4& color,
+                                 const nvmath::vec2& uv);
+
+private:
+    static nvmath::vec2 octahedralEncode(const nvmath::vec3& direction);
+    static uint16_t     floatToHalf(float value);
 };
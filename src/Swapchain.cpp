@@ -29,31 +29,11 @@ Swapchain::Swapchain(vk::Device         device,
     Images          = device.getSwapchainImagesKHR(*UniqueSwapchain);
 }
 
-std::vector<Swapchain::BufferSet> Swapchain::getBuffers(vk::Device       device,
-                                                        vk::RenderPass   renderPass,
-                                                        vk::CommandPool  commandPool,
-                                                        ResourceManager& allocator) const
+std::vector<Swapchain::BufferSet> Swapchain::getBuffers(vk::Device      device,
+                                                        vk::CommandPool commandPool) const
 {
     std::vector<BufferSet> result(Images.size());
 
-    for (std::size_t i = 0; i < result.size(); ++i)
-    {
-        result[i].imageView = allocator.createImageView2D(device,
-                                                          Images[i],
-                                                          ScreenFormat,
-                                                          vk::ImageAspectFlagBits::eColor);
-
-        std::vector<vk::ImageView> attachments {*result[i].imageView};
-        result[i].framebuffer = device.createFramebufferUnique({
-            .renderPass      = renderPass,
-            .attachmentCount = static_cast<uint32_t>(attachments.size()),
-            .pAttachments    = attachments.data(),
-            .width           = ScreenSize.width,
-            .height          = ScreenSize.height,
-            .layers          = 1,
-        });
-    }
-
     std::vector<vk::UniqueCommandBuffer> commandBuffers = device.allocateCommandBuffersUnique({
         .commandPool        = commandPool,
         .level              = vk::CommandBufferLevel::ePrimary,
@@ -7,10 +7,9 @@
 class Swapchain
 {
 public:
+    // The tone mapping pass blits into the images, nothing renders to them directly
     struct BufferSet
     {
-        vk::UniqueImageView     imageView;
-        vk::UniqueFramebuffer   framebuffer;
         vk::UniqueCommandBuffer commandBuffer;
     };
 
@@ -20,10 +19,7 @@ public:
               vk::SurfaceKHR     surface,
               GLFWwindow*        window);
 
-    std::vector<BufferSet> getBuffers(vk::Device       device,
-                                      vk::RenderPass   renderPass,
-                                      vk::CommandPool  commandPool,
-                                      ResourceManager& allocator) const;
+    std::vector<BufferSet> getBuffers(vk::Device device, vk::CommandPool commandPool) const;
 
     void reset();
 
@@ -0,0 +1,639 @@
+#include "TextureCompressor.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <fstream>
+
+namespace
+{
+struct DdsPixelFormat
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rBitMask;
+    uint32_t gBitMask;
+    uint32_t bBitMask;
+    uint32_t aBitMask;
+};
+
+struct DdsHeader
+{
+    uint32_t       size;
+    uint32_t       flags;
+    uint32_t       height;
+    uint32_t       width;
+    uint32_t       pitchOrLinearSize;
+    uint32_t       depth;
+    uint32_t       mipMapCount;
+    uint32_t       reserved1[11];
+    DdsPixelFormat pixelFormat;
+    uint32_t       caps;
+    uint32_t       caps2;
+    uint32_t       caps3;
+    uint32_t       caps4;
+    uint32_t       reserved2;
+};
+
+struct DdsHeaderDx10
+{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DdsHeader) == 124);
+static_assert(sizeof(DdsHeaderDx10) == 20);
+
+constexpr uint32_t DdsMagic   = 0x20534444; // "DDS "
+constexpr uint32_t Dx10FourCC = 0x30315844; // "DX10"
+
+constexpr uint32_t DdsFlags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+constexpr uint32_t DdsCaps  = 0x8 | 0x1000 | 0x400000;
+
+constexpr uint32_t DdpfFourCC               = 0x4;
+constexpr uint32_t D3D10ResourceTexture2D   = 3;
+constexpr uint32_t DxgiFormatBC4Unorm       = 80;
+constexpr uint32_t DxgiFormatBC5Unorm       = 83;
+constexpr uint32_t DxgiFormatBC7Unorm       = 98;
+} // namespace
+
+CompressedTexture TextureCompressor::compress(const tinygltf::Image&       image,
+                                              TextureUsage                 usage,
+                                              const std::filesystem::path& cacheDirectory)
+{
+    const Encoding encoding = selectEncoding(image, usage);
+
+    const uint32_t width  = static_cast<uint32_t>(image.width);
+    const uint32_t height = static_cast<uint32_t>(image.height);
+
+    CompressedTexture texture {
+        .Format     = toFormat(encoding),
+        .Components = toComponents(encoding, usage),
+        .Size       = {.width = width, .height = height},
+        .MipLevels  = static_cast<uint32_t>(std::bit_width(std::max(width, height))),
+    };
+
+    const std::filesystem::path cachePath =
+        cacheDirectory / std::format("{:016x}.dds", hash(image, encoding, usage));
+
+    if (readCache(cachePath, texture))
+    {
+        return texture;
+    }
+
+    const std::array<uint32_t, 2> channels =
+        usage == TextureUsage::MetallicRoughness ? std::array<uint32_t, 2> {1, 2}
+                                                 : std::array<uint32_t, 2> {0, 1};
+
+    for (const Mip& mip : generateMips(image))
+    {
+        texture.MipOffsets.push_back(texture.Data.size());
+        encodeMip(mip, encoding, channels, texture.Data);
+    }
+
+    writeCache(cachePath, texture);
+
+    return texture;
+}
+
+CompressedTexture TextureCompressor::uncompressed(const tinygltf::Image& image)
+{
+    const uint32_t width  = static_cast<uint32_t>(image.width);
+    const uint32_t height = static_cast<uint32_t>(image.height);
+
+    CompressedTexture texture {
+        .Format    = vk::Format::eR8G8B8A8Unorm,
+        .Size      = {.width = width, .height = height},
+        .MipLevels = static_cast<uint32_t>(std::bit_width(std::max(width, height))),
+    };
+
+    for (const Mip& mip : generateMips(image))
+    {
+        texture.MipOffsets.push_back(texture.Data.size());
+        texture.Data.insert(texture.Data.end(), mip.rgba.begin(), mip.rgba.end());
+    }
+
+    return texture;
+}
+
+TextureCompressor::Encoding TextureCompressor::selectEncoding(const tinygltf::Image& image,
+                                                              TextureUsage           usage)
+{
+    if (usage != TextureUsage::Color)
+    {
+        return Encoding::BC5;
+    }
+
+    // Opaque greyscale images only carry one channel worth of data
+    const std::vector<unsigned char>& pixels = image.image;
+    for (std::size_t i = 0; i + 3 < pixels.size(); i += 4)
+    {
+        if (pixels[i] != pixels[i + 1] || pixels[i] != pixels[i + 2] || pixels[i + 3] != 255)
+        {
+            return Encoding::BC7;
+        }
+    }
+
+    return Encoding::BC4;
+}
+
+vk::Format TextureCompressor::toFormat(Encoding encoding)
+{
+    switch (encoding)
+    {
+        case Encoding::BC7:
+            return vk::Format::eBc7UnormBlock;
+        case Encoding::BC5:
+            return vk::Format::eBc5UnormBlock;
+        case Encoding::BC4:
+            return vk::Format::eBc4UnormBlock;
+    }
+
+    return vk::Format::eUndefined;
+}
+
+vk::ComponentMapping TextureCompressor::toComponents(Encoding encoding, TextureUsage usage)
+{
+    // Swizzles put the stored channels back where base.frag expects them
+    if (encoding == Encoding::BC4)
+    {
+        return {
+            .r = vk::ComponentSwizzle::eR,
+            .g = vk::ComponentSwizzle::eR,
+            .b = vk::ComponentSwizzle::eR,
+            .a = vk::ComponentSwizzle::eOne,
+        };
+    }
+
+    if (usage == TextureUsage::MetallicRoughness)
+    {
+        return {
+            .r = vk::ComponentSwizzle::eZero,
+            .g = vk::ComponentSwizzle::eR,
+            .b = vk::ComponentSwizzle::eG,
+            .a = vk::ComponentSwizzle::eOne,
+        };
+    }
+
+    return {};
+}
+
+uint32_t TextureCompressor::toDxgiFormat(vk::Format format)
+{
+    switch (format)
+    {
+        case vk::Format::eBc4UnormBlock:
+            return DxgiFormatBC4Unorm;
+        case vk::Format::eBc5UnormBlock:
+            return DxgiFormatBC5Unorm;
+        case vk::Format::eBc7UnormBlock:
+            return DxgiFormatBC7Unorm;
+        default:
+            return 0;
+    }
+}
+
+uint32_t TextureCompressor::blockBytes(vk::Format format)
+{
+    return format == vk::Format::eBc4UnormBlock ? 8 : 16;
+}
+
+std::vector<vk::DeviceSize> TextureCompressor::computeMipOffsets(const CompressedTexture& texture,
+                                                                 vk::DeviceSize&          totalSize)
+{
+    std::vector<vk::DeviceSize> offsets(texture.MipLevels);
+
+    uint32_t width  = texture.Size.width;
+    uint32_t height = texture.Size.height;
+    totalSize       = 0;
+    for (uint32_t i = 0; i < texture.MipLevels; ++i)
+    {
+        offsets[i] = totalSize;
+        totalSize += static_cast<vk::DeviceSize>((width + 3) / 4) * ((height + 3) / 4) *
+                     blockBytes(texture.Format);
+
+        width  = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+
+    return offsets;
+}
+
+std::vector<TextureCompressor::Mip> TextureCompressor::generateMips(const tinygltf::Image& image)
+{
+    std::vector<Mip> mips;
+    mips.push_back({
+        .width  = static_cast<uint32_t>(image.width),
+        .height = static_cast<uint32_t>(image.height),
+        .rgba   = std::vector<uint8_t>(image.image.begin(), image.image.end()),
+    });
+
+    while (mips.back().width > 1 || mips.back().height > 1)
+    {
+        const Mip& source = mips.back();
+
+        Mip mip {
+            .width  = std::max(source.width / 2, 1u),
+            .height = std::max(source.height / 2, 1u),
+        };
+        mip.rgba.resize(static_cast<std::size_t>(mip.width) * mip.height * 4);
+
+        // 2x2 box filter, the trailing row or column of odd sizes is clamped
+        for (uint32_t y = 0; y < mip.height; ++y)
+        {
+            const uint32_t y0 = std::min(y * 2, source.height - 1);
+            const uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+            for (uint32_t x = 0; x < mip.width; ++x)
+            {
+                const uint32_t x0 = std::min(x * 2, source.width - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    const uint32_t sum = source.rgba[(y0 * source.width + x0) * 4 + c] +
+                                         source.rgba[(y0 * source.width + x1) * 4 + c] +
+                                         source.rgba[(y1 * source.width + x0) * 4 + c] +
+                                         source.rgba[(y1 * source.width + x1) * 4 + c];
+
+                    mip.rgba[(y * mip.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+
+        mips.push_back(std::move(mip));
+    }
+
+    return mips;
+}
+
+void TextureCompressor::encodeMip(const Mip&                     mip,
+                                  Encoding                       encoding,
+                                  const std::array<uint32_t, 2>& channels,
+                                  std::vector<uint8_t>&          out)
+{
+    const uint32_t blocksX = (mip.width + 3) / 4;
+    const uint32_t blocksY = (mip.height + 3) / 4;
+    const uint32_t size    = encoding == Encoding::BC4 ? 8 : 16;
+
+    std::size_t offset = out.size();
+    out.resize(offset + static_cast<std::size_t>(blocksX) * blocksY * size);
+
+    for (uint32_t by = 0; by < blocksY; ++by)
+    {
+        for (uint32_t bx = 0; bx < blocksX; ++bx)
+        {
+            // Blocks hanging over the edge repeat the last row and column
+            std::array<std::array<uint8_t, 4>, 16> texels;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                const uint32_t x = std::min(bx * 4 + i % 4, mip.width - 1);
+                const uint32_t y = std::min(by * 4 + i / 4, mip.height - 1);
+                std::copy_n(&mip.rgba[(y * mip.width + x) * 4], 4, texels[i].begin());
+            }
+
+            uint8_t* block = &out[offset];
+            if (encoding == Encoding::BC7)
+            {
+                encodeBC7Block(texels, block);
+            }
+            else
+            {
+                const uint32_t channelCount = encoding == Encoding::BC5 ? 2 : 1;
+                for (uint32_t c = 0; c < channelCount; ++c)
+                {
+                    std::array<uint8_t, 16> values;
+                    for (uint32_t i = 0; i < 16; ++i)
+                    {
+                        values[i] = texels[i][channels[c]];
+                    }
+                    encodeBC4Block(values, block + c * 8);
+                }
+            }
+
+            offset += size;
+        }
+    }
+}
+
+void TextureCompressor::encodeBC7Block(const std::array<std::array<uint8_t, 4>, 16>& texels,
+                                       uint8_t*                                      out)
+{
+    // Mode 6 only: one subset, RGBA endpoints with 7 bits and a p-bit each, 4-bit indices.
+    // Endpoints are fitted along the principal axis of the block's colours.
+    std::array<float, 4> mean {};
+    for (const std::array<uint8_t, 4>& texel : texels)
+    {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            mean[c] += texel[c] / 16.0f;
+        }
+    }
+
+    std::array<std::array<float, 4>, 4> covariance {};
+    for (const std::array<uint8_t, 4>& texel : texels)
+    {
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+            }
+        }
+    }
+
+    std::array<float, 4> axis {1.0f, 1.0f, 1.0f, 1.0f};
+    for (uint32_t iteration = 0; iteration < 8; ++iteration)
+    {
+        std::array<float, 4> next {};
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                next[i] += covariance[i][j] * axis[j];
+            }
+        }
+
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] +
+                                 next[3] * next[3]);
+        if (length < 1e-6f)
+        {
+            break;
+        }
+
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            axis[i] = next[i] / length;
+        }
+    }
+
+    float minProjection = std::numeric_limits<float>::max();
+    float maxProjection = -std::numeric_limits<float>::max();
+    for (const std::array<uint8_t, 4>& texel : texels)
+    {
+        float projection = 0.0f;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            projection += (texel[c] - mean[c]) * axis[c];
+        }
+
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    std::array<std::array<uint32_t, 4>, 2> quantized;
+    std::array<uint32_t, 2>                pBits;
+    for (uint32_t e = 0; e < 2; ++e)
+    {
+        const float projection = e == 0 ? minProjection : maxProjection;
+
+        float bestError = std::numeric_limits<float>::max();
+        for (uint32_t p = 0; p < 2; ++p)
+        {
+            std::array<uint32_t, 4> candidate;
+            float                   error = 0.0f;
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const float endpoint = std::clamp(mean[c] + projection * axis[c], 0.0f, 255.0f);
+                candidate[c]         = static_cast<uint32_t>(
+                    std::clamp(std::lround((endpoint - p) / 2.0f), 0l, 127l));
+
+                const float decoded = static_cast<float>((candidate[c] << 1) | p);
+                error += (decoded - endpoint) * (decoded - endpoint);
+            }
+
+            if (error < bestError)
+            {
+                bestError    = error;
+                quantized[e] = candidate;
+                pBits[e]     = p;
+            }
+        }
+    }
+
+    constexpr std::array<uint32_t, 16> weights {
+        0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    std::array<std::array<int32_t, 4>, 16> palette;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            const uint32_t e0 = (quantized[0][c] << 1) | pBits[0];
+            const uint32_t e1 = (quantized[1][c] << 1) | pBits[1];
+            palette[i][c] =
+                static_cast<int32_t>(((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6);
+        }
+    }
+
+    std::array<uint32_t, 16> indices;
+    for (uint32_t t = 0; t < 16; ++t)
+    {
+        int32_t bestError = std::numeric_limits<int32_t>::max();
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            int32_t error = 0;
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const int32_t difference = palette[i][c] - texels[t][c];
+                error += difference * difference;
+            }
+
+            if (error < bestError)
+            {
+                bestError  = error;
+                indices[t] = i;
+            }
+        }
+    }
+
+    // The anchor index drops its top bit, so it has to land in the lower half of the palette
+    if (indices[0] & 8)
+    {
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (uint32_t& index : indices)
+        {
+            index = 15 - index;
+        }
+    }
+
+    std::fill_n(out, 16, uint8_t(0));
+    uint32_t position = 0;
+    auto     write    = [&](uint32_t value, uint32_t bits) {
+        for (uint32_t b = 0; b < bits; ++b, ++position)
+        {
+            if ((value >> b) & 1)
+            {
+                out[position / 8] |= static_cast<uint8_t>(1 << (position % 8));
+            }
+        }
+    };
+
+    write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; ++c)
+    {
+        write(quantized[0][c], 7);
+        write(quantized[1][c], 7);
+    }
+    write(pBits[0], 1);
+    write(pBits[1], 1);
+    write(indices[0], 3);
+    for (uint32_t i = 1; i < 16; ++i)
+    {
+        write(indices[i], 4);
+    }
+}
+
+void TextureCompressor::encodeBC4Block(const std::array<uint8_t, 16>& values, uint8_t* out)
+{
+    const auto [minIt, maxIt] = std::minmax_element(values.begin(), values.end());
+    const uint32_t red0       = *maxIt;
+    const uint32_t red1       = *minIt;
+
+    out[0] = static_cast<uint8_t>(red0);
+    out[1] = static_cast<uint8_t>(red1);
+
+    // red0 > red1 selects the eight-value palette; a flat block decodes to red0 at index 0
+    std::array<float, 8> palette {static_cast<float>(red0), static_cast<float>(red1)};
+    for (uint32_t i = 2; i < 8; ++i)
+    {
+        palette[i] = ((8 - i) * red0 + (i - 1) * red1) / 7.0f;
+    }
+
+    uint64_t bits = 0;
+    if (red0 != red1)
+    {
+        for (uint32_t t = 0; t < 16; ++t)
+        {
+            uint32_t best      = 0;
+            float    bestError = std::numeric_limits<float>::max();
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                const float error = std::abs(palette[i] - values[t]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best      = i;
+                }
+            }
+
+            bits |= static_cast<uint64_t>(best) << (3 * t);
+        }
+    }
+
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+uint64_t TextureCompressor::hash(const tinygltf::Image& image,
+                                 Encoding               encoding,
+                                 TextureUsage           usage)
+{
+    // FNV-1a, stable across runs and compilers unlike std::hash
+    uint64_t result = 0xcbf29ce484222325ull;
+    auto     mix    = [&result](const uint8_t* data, std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            result = (result ^ data[i]) * 0x100000001b3ull;
+        }
+    };
+
+    const std::array<uint32_t, 5> key {CacheVersion,
+                                       static_cast<uint32_t>(image.width),
+                                       static_cast<uint32_t>(image.height),
+                                       static_cast<uint32_t>(encoding),
+                                       static_cast<uint32_t>(usage)};
+    mix(reinterpret_cast<const uint8_t*>(key.data()), sizeof(key));
+    mix(image.image.data(), image.image.size());
+
+    return result;
+}
+
+bool TextureCompressor::readCache(const std::filesystem::path& path, CompressedTexture& texture)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    uint32_t      magic = 0;
+    DdsHeader     header {};
+    DdsHeaderDx10 headerDx10 {};
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    file.read(reinterpret_cast<char*>(&headerDx10), sizeof(headerDx10));
+
+    if (!file || magic != DdsMagic || header.pixelFormat.fourCC != Dx10FourCC ||
+        headerDx10.dxgiFormat != toDxgiFormat(texture.Format) ||
+        header.width != texture.Size.width || header.height != texture.Size.height ||
+        header.mipMapCount != texture.MipLevels)
+    {
+        return false;
+    }
+
+    vk::DeviceSize              totalSize;
+    std::vector<vk::DeviceSize> offsets = computeMipOffsets(texture, totalSize);
+
+    std::vector<uint8_t> data(static_cast<std::size_t>(totalSize));
+    file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (file.gcount() != static_cast<std::streamsize>(data.size()))
+    {
+        return false;
+    }
+
+    texture.Data       = std::move(data);
+    texture.MipOffsets = std::move(offsets);
+    return true;
+}
+
+void TextureCompressor::writeCache(const std::filesystem::path& path,
+                                   const CompressedTexture&     texture)
+{
+    // The cache is an optimisation only, a read-only scene directory just means re-encoding
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    if (error)
+    {
+        return;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return;
+    }
+
+    const DdsHeader header {
+        .size              = sizeof(DdsHeader),
+        .flags             = DdsFlags,
+        .height            = texture.Size.height,
+        .width             = texture.Size.width,
+        .pitchOrLinearSize = static_cast<uint32_t>(
+            texture.MipLevels > 1 ? texture.MipOffsets[1] : texture.Data.size()),
+        .mipMapCount       = texture.MipLevels,
+        .pixelFormat       = {.size   = sizeof(DdsPixelFormat),
+                              .flags  = DdpfFourCC,
+                              .fourCC = Dx10FourCC},
+        .caps              = DdsCaps,
+    };
+
+    const DdsHeaderDx10 headerDx10 {
+        .dxgiFormat        = toDxgiFormat(texture.Format),
+        .resourceDimension = D3D10ResourceTexture2D,
+        .arraySize         = 1,
+    };
+
+    file.write(reinterpret_cast<const char*>(&DdsMagic), sizeof(DdsMagic));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(&headerDx10), sizeof(headerDx10));
+    file.write(reinterpret_cast<const char*>(texture.Data.data()),
+               static_cast<std::streamsize>(texture.Data.size()));
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <gltfscene.h>
+
+#include <filesystem>
+
+// How a material samples a texture, which decides the block format it is transcoded to
+enum class TextureUsage
+{
+    Color,             // Albedo, emissive, specular-glossiness
+    Normal,            // Tangent space xy, z is reconstructed in the shader
+    MetallicRoughness, // glTF packing, roughness in green and metallic in blue
+};
+
+struct CompressedTexture
+{
+    vk::Format           Format;
+    vk::ComponentMapping Components;
+    vk::Extent2D         Size;
+    uint32_t             MipLevels;
+
+    // Tightly packed blocks of every mip level, largest first
+    std::vector<uint8_t>        Data;
+    std::vector<vk::DeviceSize> MipOffsets;
+};
+
+// Transcodes RGBA8 glTF images to BC7, BC5 or BC4 with a precomputed mip chain. Results are
+// cached as DDS files keyed by a hash of the source pixels, so the encoder only runs once.
+class TextureCompressor
+{
+public:
+    static CompressedTexture compress(const tinygltf::Image&       image,
+                                      TextureUsage                 usage,
+                                      const std::filesystem::path& cacheDirectory);
+
+    // The same mip chain layout kept as RGBA8, for devices without BC support
+    static CompressedTexture uncompressed(const tinygltf::Image& image);
+
+private:
+    enum class Encoding
+    {
+        BC7,
+        BC5,
+        BC4,
+    };
+
+    struct Mip
+    {
+        uint32_t             width;
+        uint32_t             height;
+        std::vector<uint8_t> rgba;
+    };
+
+    static constexpr uint32_t CacheVersion = 1;
+
+    static Encoding             selectEncoding(const tinygltf::Image& image, TextureUsage usage);
+    static vk::Format           toFormat(Encoding encoding);
+    static vk::ComponentMapping toComponents(Encoding encoding, TextureUsage usage);
+    static uint32_t             toDxgiFormat(vk::Format format);
+    static uint32_t             blockBytes(vk::Format format);
+
+    static std::vector<vk::DeviceSize> computeMipOffsets(const CompressedTexture& texture,
+                                                         vk::DeviceSize&          totalSize);
+
+    static std::vector<Mip> generateMips(const tinygltf::Image& image);
+    static void             encodeMip(const Mip&                     mip,
+                                      Encoding                       encoding,
+                                      const std::array<uint32_t, 2>& channels,
+                                      std::vector<uint8_t>&          out);
+
+    static void encodeBC7Block(const std::array<std::array<uint8_t, 4>, 16>& texels, uint8_t* out);
+    static void encodeBC4Block(const std::array<uint8_t, 16>& values, uint8_t* out);
+
+    static uint64_t hash(const tinygltf::Image& image, Encoding encoding, TextureUsage usage);
+
+    static bool readCache(const std::filesystem::path& path, CompressedTexture& texture);
+    static void writeCache(const std::filesystem::path& path, const CompressedTexture& texture);
+};
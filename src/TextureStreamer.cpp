@@ -0,0 +1,268 @@
+#include "TextureStreamer.h"
+
+#include "Scene.h"
+
+#include <algorithm>
+
+TextureStreamer::TextureStreamer(vk::Device              device,
+                                 ResourceManager&        allocator,
+                                 Scene&                  scene,
+                                 TransientCommandBuffer& transientCommandBuffer,
+                                 vk::DeviceSize          memoryBudget)
+    : _scene(&scene)
+    , _memoryBudget(memoryBudget)
+{
+    _states.resize(scene.TextureSources.size());
+    for (uint32_t i = 0; i < scene.TextureSources.size(); ++i)
+    {
+        const CompressedTexture& source = scene.TextureSources[i];
+
+        uint32_t top = 0;
+        while (top + 1 < source.MipLevels &&
+               std::max(source.Size.width >> top, source.Size.height >> top) > InitialResolution)
+        {
+            ++top;
+        }
+
+        _states[i] = {.residentTop = top, .initialTop = top};
+
+        scene.Textures[i].Image = ResourceManager::loadCompressedTexture(source,
+                                                                         top,
+                                                                         allocator,
+                                                                         transientCommandBuffer);
+
+        scene.Textures[i].ImageView = allocator.createImageView2D(device,
+                                                                  *scene.Textures[i].Image,
+                                                                  source.Format,
+                                                                  vk::ImageAspectFlagBits::eColor,
+                                                                  0,
+                                                                  source.MipLevels - top,
+                                                                  0,
+                                                                  1,
+                                                                  source.Components);
+    }
+
+    transientCommandBuffer.waitIdle();
+
+    _worker         = std::make_unique<Worker>();
+    _worker->thread = std::thread(work,
+                                  std::ref(*_worker),
+                                  std::ref(allocator),
+                                  std::cref(scene.TextureSources));
+}
+
+TextureStreamer::Worker::~Worker()
+{
+    {
+        std::lock_guard lock(mutex);
+        stop = true;
+    }
+    condition.notify_all();
+
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+std::vector<uint32_t> TextureStreamer::update(vk::Device              device,
+                                              ResourceManager&        allocator,
+                                              TransientCommandBuffer& transientCommandBuffer,
+                                              UniqueBuffer&           feedback)
+{
+    std::vector<uint32_t> updated;
+
+    for (std::size_t i = 0; i < _pendingSwaps.size();)
+    {
+        if (!transientCommandBuffer.isComplete(_pendingSwaps[i].submission))
+        {
+            ++i;
+            continue;
+        }
+
+        swapIn(device, allocator, _pendingSwaps[i]);
+        updated.push_back(_pendingSwaps[i].texture);
+
+        if (i + 1 != _pendingSwaps.size())
+        {
+            _pendingSwaps[i] = std::move(_pendingSwaps.back());
+        }
+        _pendingSwaps.pop_back();
+    }
+
+    std::vector<PreparedJob> prepared;
+    {
+        std::lock_guard lock(_worker->mutex);
+        prepared.swap(_worker->prepared);
+    }
+
+    for (PreparedJob& job : prepared)
+    {
+        transientCommandBuffer.begin();
+        ResourceManager::copyMipChain(*transientCommandBuffer,
+                                      *job.staging,
+                                      *job.image,
+                                      _scene->TextureSources[job.texture],
+                                      job.topMip);
+        transientCommandBuffer.retain(std::move(job.staging));
+
+        _pendingSwaps.push_back({
+            .texture    = job.texture,
+            .topMip     = job.topMip,
+            .image      = std::move(job.image),
+            .submission = transientCommandBuffer.submit(),
+        });
+    }
+    transientCommandBuffer.flush();
+
+    // Memory already spoken for, counting in-flight jobs at their larger size
+    vk::DeviceSize committed = 0;
+    for (uint32_t i = 0; i < _states.size(); ++i)
+    {
+        const TextureState& state = _states[i];
+        committed += residentSize(i, std::min(state.residentTop, state.targetTop.value_or(~0u)));
+    }
+
+    std::vector<Job> evictions;
+    std::vector<Job> upgrades;
+
+    feedback.invalidate();
+    const int32_t* requested = feedback.mapAs<int32_t>();
+    for (uint32_t i = 0; i < _states.size(); ++i)
+    {
+        TextureState& state      = _states[i];
+        uint32_t      desiredTop = state.residentTop;
+
+        // Requests are relative to the image that was bound, whose level 0 is residentTop
+        if (requested[i] != NotRequested)
+        {
+            state.framesUnseen = 0;
+
+            const int64_t top = static_cast<int64_t>(state.residentTop) + requested[i];
+            desiredTop = static_cast<uint32_t>(std::clamp<int64_t>(top, 0, state.residentTop));
+        }
+        else if (++state.framesUnseen > EvictionFrames)
+        {
+            desiredTop = state.initialTop;
+        }
+
+        if (state.targetTop || desiredTop == state.residentTop)
+        {
+            continue;
+        }
+
+        (desiredTop > state.residentTop ? evictions : upgrades).push_back({i, desiredTop});
+    }
+    feedback.unmap();
+
+    // The most under-resolved textures go first
+    std::sort(upgrades.begin(), upgrades.end(), [this](const Job& a, const Job& b) {
+        return _states[a.texture].residentTop - a.topMip >
+               _states[b.texture].residentTop - b.topMip;
+    });
+
+    std::vector<Job> jobs;
+    for (const Job& job : evictions)
+    {
+        if (jobs.size() == MaxJobsPerFrame)
+        {
+            break;
+        }
+        jobs.push_back(job);
+    }
+
+    for (const Job& job : upgrades)
+    {
+        if (jobs.size() == MaxJobsPerFrame)
+        {
+            break;
+        }
+
+        const vk::DeviceSize cost = residentSize(job.texture, job.topMip) -
+                                    residentSize(job.texture, _states[job.texture].residentTop);
+        if (committed + cost > _memoryBudget)
+        {
+            continue;
+        }
+
+        committed += cost;
+        jobs.push_back(job);
+    }
+
+    if (!jobs.empty())
+    {
+        {
+            std::lock_guard lock(_worker->mutex);
+            for (const Job& job : jobs)
+            {
+                _states[job.texture].targetTop = job.topMip;
+                _worker->jobs.push_back(job);
+            }
+        }
+        _worker->condition.notify_one();
+    }
+
+    return updated;
+}
+
+vk::DeviceSize TextureStreamer::residentSize(uint32_t texture, uint32_t topMip) const
+{
+    const CompressedTexture& source = _scene->TextureSources[texture];
+    return source.Data.size() - source.MipOffsets[topMip];
+}
+
+void TextureStreamer::swapIn(vk::Device device, ResourceManager& allocator, PendingSwap& swap)
+{
+    const CompressedTexture& source  = _scene->TextureSources[swap.texture];
+    Scene::SceneTexture&     texture = _scene->Textures[swap.texture];
+
+    // The old view is destroyed before the image it was created from
+    texture.ImageView = allocator.createImageView2D(device,
+                                                    *swap.image,
+                                                    source.Format,
+                                                    vk::ImageAspectFlagBits::eColor,
+                                                    0,
+                                                    source.MipLevels - swap.topMip,
+                                                    0,
+                                                    1,
+                                                    source.Components);
+    texture.Image     = std::move(swap.image);
+
+    _states[swap.texture].residentTop = swap.topMip;
+    _states[swap.texture].targetTop.reset();
+}
+
+void TextureStreamer::work(Worker&                               worker,
+                           ResourceManager&                      allocator,
+                           const std::vector<CompressedTexture>& sources)
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock lock(worker.mutex);
+            worker.condition.wait(lock, [&worker] { return worker.stop || !worker.jobs.empty(); });
+            if (worker.stop)
+            {
+                return;
+            }
+
+            job = worker.jobs.front();
+            worker.jobs.pop_front();
+        }
+
+        const CompressedTexture& source = sources[job.texture];
+        const vk::DeviceSize     offset = source.MipOffsets[job.topMip];
+
+        PreparedJob prepared {
+            .texture = job.texture,
+            .topMip  = job.topMip,
+            .staging = allocator.createStagingBuffer(source.Data.data() + offset,
+                                                     source.Data.size() - offset),
+            .image   = ResourceManager::createMipChainImage(source, job.topMip, allocator),
+        };
+
+        std::lock_guard lock(worker.mutex);
+        worker.prepared.push_back(std::move(prepared));
+    }
+}
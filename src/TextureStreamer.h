@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ResourceManager.h"
+#include "TransientCommandBuffer.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class Scene;
+
+// Keeps scene textures partially resident. Every texture starts with its low mips only; base.frag
+// writes the finest mip it wanted into a feedback buffer and higher mips are streamed in while
+// they fit the memory budget. Textures that go unseen drop back to their low mips.
+class TextureStreamer
+{
+public:
+    // Feedback entries nobody sampled keep this value
+    static constexpr int32_t NotRequested = std::numeric_limits<int32_t>::max();
+
+    TextureStreamer() = default;
+    TextureStreamer(vk::Device              device,
+                    ResourceManager&        allocator,
+                    Scene&                  scene,
+                    TransientCommandBuffer& transientCommandBuffer,
+                    vk::DeviceSize          memoryBudget);
+
+    // Call while no frame using the scene textures is in flight. Returns the textures whose
+    // image view changed and need their descriptors rewritten.
+    std::vector<uint32_t> update(vk::Device              device,
+                                 ResourceManager&        allocator,
+                                 TransientCommandBuffer& transientCommandBuffer,
+                                 UniqueBuffer&           feedback);
+
+private:
+    // Largest top mip every texture starts with
+    static constexpr uint32_t InitialResolution = 128;
+    static constexpr uint32_t MaxJobsPerFrame   = 4;
+    static constexpr uint32_t EvictionFrames    = 120;
+
+    struct TextureState
+    {
+        uint32_t                residentTop;
+        uint32_t                initialTop;
+        std::optional<uint32_t> targetTop;
+        uint32_t                framesUnseen = 0;
+    };
+
+    struct Job
+    {
+        uint32_t texture;
+        uint32_t topMip;
+    };
+
+    struct PreparedJob
+    {
+        uint32_t     texture;
+        uint32_t     topMip;
+        UniqueBuffer staging;
+        UniqueImage  image;
+    };
+
+    struct PendingSwap
+    {
+        uint32_t                           texture;
+        uint32_t                           topMip;
+        UniqueImage                        image;
+        TransientCommandBuffer::Submission submission;
+    };
+
+    // Fills staging buffers and allocates images off the render thread
+    struct Worker
+    {
+        std::thread              thread;
+        std::mutex               mutex;
+        std::condition_variable  condition;
+        std::deque<Job>          jobs;
+        std::vector<PreparedJob> prepared;
+        bool                     stop = false;
+
+        ~Worker();
+    };
+
+    Scene*         _scene        = nullptr;
+    vk::DeviceSize _memoryBudget = 0;
+
+    std::vector<TextureState> _states;
+    std::vector<PendingSwap>  _pendingSwaps;
+    std::unique_ptr<Worker>   _worker;
+
+    vk::DeviceSize residentSize(uint32_t texture, uint32_t topMip) const;
+    void           swapIn(vk::Device device, ResourceManager& allocator, PendingSwap& swap);
+
+    static void work(Worker&                               worker,
+                     ResourceManager&                      allocator,
+                     const std::vector<CompressedTexture>& sources);
+};
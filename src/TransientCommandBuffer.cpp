@@ -1,48 +1,217 @@
 #include "TransientCommandBuffer.h"
 
-TransientCommandBuffer::TransientCommandBuffer(vk::Device device,
-                                               vk::Queue  queue,
-                                               uint32_t   queueIndex)
+TransientCommandBuffer::TransientCommandBuffer(vk::Device              device,
+                                               vk::Queue               queue,
+                                               uint32_t                queueIndex,
+                                               vk::Queue               transferQueue,
+                                               std::optional<uint32_t> transferQueueIndex)
     : _device(device)
-    , _queue(queue)
 {
-    _pool = _device.createCommandPoolUnique(
-        {.flags = vk::CommandPoolCreateFlagBits::eTransient, .queueFamilyIndex = queueIndex});
+    initializeLane(_graphicsLane, queue, queueIndex);
+
+    if (transferQueue && transferQueueIndex && *transferQueueIndex != queueIndex)
+    {
+        initializeLane(_transferLane, transferQueue, *transferQueueIndex);
+        _hasTransferLane     = true;
+        _sharedQueueFamilies = {queueIndex, *transferQueueIndex};
+    }
+}
+
+void TransientCommandBuffer::begin(Lane lane)
+{
+    LaneState& state = laneFor(lane);
+    if (state.batches[state.openBatch].used == BatchSize)
+    {
+        flushLane(state);
+    }
+
+    Batch& batch = state.batches[state.openBatch];
+
+    _buffer     = *batch.commandBuffers[batch.used];
+    _bufferLane = lane;
+    _buffer.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
 }
 
-void TransientCommandBuffer::begin()
+TransientCommandBuffer::Submission TransientCommandBuffer::submit()
 {
-    _buffer =
-        std::move(_device.allocateCommandBuffersUnique({.commandPool = *_pool,
-                                                        .level = vk::CommandBufferLevel::ePrimary,
-                                                        .commandBufferCount = 1})[0]);
+    _buffer.end();
+    _buffer = nullptr;
 
-    _fence = _device.createFenceUnique({});
-    _buffer->begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    LaneState& state = laneFor(_bufferLane);
+    Batch&     batch = state.batches[state.openBatch];
+    ++batch.used;
+
+    return {.lane = _bufferLane, .batch = batch.id};
 }
 
 void TransientCommandBuffer::submitAndWait()
 {
-    _buffer->end();
+    wait(submit());
+}
 
-    std::array<vk::CommandBuffer, 1> buffers {*_buffer};
-    vk::SubmitInfo                   submitInfo;
-    submitInfo.setCommandBuffers(buffers);
-    _queue.submit(submitInfo, *_fence);
-    while (_device.waitForFences(*_fence, true, std::numeric_limits<uint64_t>::max()) ==
-           vk::Result::eTimeout)
-    {}
+void TransientCommandBuffer::flush()
+{
+    flushLane(_graphicsLane);
+    if (_hasTransferLane)
+    {
+        flushLane(_transferLane);
+    }
+}
+
+void TransientCommandBuffer::wait(Submission submission)
+{
+    if (submission.batch == 0)
+    {
+        return;
+    }
 
-    _buffer.reset();
-    _fence.reset();
+    LaneState& state = laneFor(submission.lane);
+    for (Batch& batch : state.batches)
+    {
+        if (batch.id == submission.batch)
+        {
+            if (!batch.submitted)
+            {
+                flushLane(state);
+            }
+
+            waitForBatch(batch);
+            batch.retainedBuffers.clear();
+            return;
+        }
+    }
+
+    // Batches are only recycled after their fence has signalled, so a missing id is complete
+}
+
+bool TransientCommandBuffer::isComplete(Submission submission) const
+{
+    if (submission.batch == 0)
+    {
+        return true;
+    }
+
+    const LaneState& state = submission.lane == Lane::Transfer && _hasTransferLane
+                                 ? _transferLane
+                                 : _graphicsLane;
+    for (const Batch& batch : state.batches)
+    {
+        if (batch.id == submission.batch)
+        {
+            return batch.submitted && _device.getFenceStatus(*batch.fence) == vk::Result::eSuccess;
+        }
+    }
+
+    return true;
+}
+
+void TransientCommandBuffer::waitIdle()
+{
+    flush();
+
+    for (LaneState* state : {&_graphicsLane, &_transferLane})
+    {
+        for (Batch& batch : state->batches)
+        {
+            if (batch.submitted)
+            {
+                waitForBatch(batch);
+                batch.retainedBuffers.clear();
+            }
+        }
+    }
+}
+
+void TransientCommandBuffer::retain(UniqueBuffer&& buffer)
+{
+    LaneState& state = laneFor(_bufferLane);
+    state.batches[state.openBatch].retainedBuffers.push_back(std::move(buffer));
+}
+
+const std::vector<uint32_t>& TransientCommandBuffer::getSharedQueueFamilies() const
+{
+    return _sharedQueueFamilies;
 }
 
 vk::CommandBuffer TransientCommandBuffer::operator*() const
 {
-    return *_buffer;
+    return _buffer;
 }
 
 const vk::CommandBuffer* TransientCommandBuffer::operator->() const
 {
-    return &*_buffer;
-}
\ No newline at end of file
+    return &_buffer;
+}
+
+TransientCommandBuffer::LaneState& TransientCommandBuffer::laneFor(Lane lane)
+{
+    return lane == Lane::Transfer && _hasTransferLane ? _transferLane : _graphicsLane;
+}
+
+void TransientCommandBuffer::initializeLane(LaneState& lane, vk::Queue queue, uint32_t queueIndex)
+{
+    lane.queue = queue;
+    lane.pool  = _device.createCommandPoolUnique({
+         .flags = vk::CommandPoolCreateFlagBits::eTransient |
+                 vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+         .queueFamilyIndex = queueIndex,
+    });
+
+    for (Batch& batch : lane.batches)
+    {
+        batch.commandBuffers = _device.allocateCommandBuffersUnique({
+            .commandPool        = *lane.pool,
+            .level              = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = BatchSize,
+        });
+        batch.fence          = _device.createFenceUnique({});
+    }
+
+    lane.openBatch                  = 0;
+    lane.batches[lane.openBatch].id = _nextBatchId++;
+}
+
+void TransientCommandBuffer::flushLane(LaneState& lane)
+{
+    Batch& batch = lane.batches[lane.openBatch];
+    if (batch.used == 0)
+    {
+        return;
+    }
+
+    std::vector<vk::CommandBuffer> buffers(batch.used);
+    for (uint32_t i = 0; i < batch.used; ++i)
+    {
+        buffers[i] = *batch.commandBuffers[i];
+    }
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBuffers(buffers);
+    lane.queue.submit(submitInfo, *batch.fence);
+    batch.submitted = true;
+
+    lane.openBatch = (lane.openBatch + 1) % BatchCount;
+    recycle(lane.batches[lane.openBatch]);
+}
+
+void TransientCommandBuffer::recycle(Batch& batch)
+{
+    if (batch.submitted)
+    {
+        waitForBatch(batch);
+        _device.resetFences(*batch.fence);
+    }
+
+    // Beginning a command buffer from a resettable pool implicitly resets it
+    batch.retainedBuffers.clear();
+    batch.used      = 0;
+    batch.submitted = false;
+    batch.id        = _nextBatchId++;
+}
+
+void TransientCommandBuffer::waitForBatch(const Batch& batch) const
+{
+    while (_device.waitForFences(*batch.fence, true, std::numeric_limits<uint64_t>::max()) ==
+           vk::Result::eTimeout)
+    {}
+}
@@ -1,21 +1,94 @@
 #pragma once
 
+#include "ResourceManager.h"
+
+// Short-lived command buffers for uploads and one-off work. Command buffers and fences are
+// allocated once and recycled in batches; a batch goes to the GPU with a single submit.
 class TransientCommandBuffer
 {
 public:
+    enum class Lane
+    {
+        Graphics,
+        // Copies only. Runs on a dedicated transfer queue when the device has one, otherwise
+        // falls back to the graphics queue.
+        Transfer,
+    };
+
+    // Identifies the batch a command buffer was submitted with. A default constructed
+    // submission counts as already complete.
+    struct Submission
+    {
+        Lane     lane  = Lane::Graphics;
+        uint64_t batch = 0;
+    };
+
     TransientCommandBuffer() = default;
-    TransientCommandBuffer(vk::Device device, vk::Queue queue, uint32_t queueIndex);
+    TransientCommandBuffer(vk::Device              device,
+                           vk::Queue               queue,
+                           uint32_t                queueIndex,
+                           vk::Queue               transferQueue      = nullptr,
+                           std::optional<uint32_t> transferQueueIndex = std::nullopt);
+
+    void begin(Lane lane = Lane::Graphics);
+
+    // Ends the current command buffer and queues it in the open batch of its lane. The batch is
+    // submitted on flush(), when it fills up or when it is waited on.
+    Submission submit();
+    void       submitAndWait();
+
+    void flush();
+    void wait(Submission submission);
+    void waitIdle();
+
+    // Non-blocking; a submission still waiting for its batch to be flushed is not complete
+    bool isComplete(Submission submission) const;
 
-    void begin();
-    void submitAndWait();
+    // Keeps a buffer alive until the batch holding the current command buffer has completed
+    void retain(UniqueBuffer&& buffer);
+
+    // Queue families that have to share buffers written on the transfer lane, empty when both
+    // lanes run on the same family
+    const std::vector<uint32_t>& getSharedQueueFamilies() const;
 
     vk::CommandBuffer operator*() const;
     const vk::CommandBuffer* operator->() const;
 
 private:
-    vk::UniqueCommandBuffer _buffer;
-    vk::Device             _device;
-    vk::UniqueFence        _fence;
-    vk::Queue              _queue;
-    vk::UniqueCommandPool  _pool;
+    static constexpr std::size_t BatchCount = 4;
+    static constexpr uint32_t    BatchSize  = 16;
+
+    struct Batch
+    {
+        std::vector<vk::UniqueCommandBuffer> commandBuffers;
+        std::vector<UniqueBuffer>            retainedBuffers;
+        vk::UniqueFence                      fence;
+        uint64_t                             id        = 0;
+        uint32_t                             used      = 0;
+        bool                                 submitted = false;
+    };
+
+    struct LaneState
+    {
+        vk::Queue                     queue;
+        vk::UniqueCommandPool         pool;
+        std::array<Batch, BatchCount> batches;
+        std::size_t                   openBatch = 0;
+    };
+
+    vk::Device            _device;
+    LaneState             _graphicsLane;
+    LaneState             _transferLane;
+    bool                  _hasTransferLane = false;
+    std::vector<uint32_t> _sharedQueueFamilies;
+    uint64_t              _nextBatchId = 1;
+
+    vk::CommandBuffer _buffer;
+    Lane              _bufferLane = Lane::Graphics;
+
+    LaneState& laneFor(Lane lane);
+    void       initializeLane(LaneState& lane, vk::Queue queue, uint32_t queueIndex);
+    void       flushLane(LaneState& lane);
+    void       recycle(Batch& batch);
+    void       waitForBatch(const Batch& batch) const;
 };
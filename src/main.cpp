@@ -19,14 +19,28 @@ int main(int argc, char** argv)
 {
     if (argc < 3)
     {
-        std::cout << "Usage: PathTracer.exe <pathToScene> <pointLightsToGenerate>" << std::endl;
+        std::cout << "Usage: PathTracer.exe <pathToScene> <pointLightsToGenerate> "
+                     "[textureBudgetMiB] [environment.hdr]"
+                  << std::endl;
         return -1;
     }
 
     std::string scene           = std::string(argv[1]);
     uint32_t    pointLightCount = std::atoi(argv[2]);
 
-    Program app(scene, pointLightCount);
+    vk::DeviceSize textureBudget = 1024;
+    if (argc > 3)
+    {
+        textureBudget = std::atoi(argv[3]);
+    }
+
+    std::string environment;
+    if (argc > 4)
+    {
+        environment = std::string(argv[4]);
+    }
+
+    Program app(scene, pointLightCount, textureBudget << 20, environment);
     app.mainLoop();
     return 0;
 }
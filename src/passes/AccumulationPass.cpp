@@ -0,0 +1,314 @@
+#include "AccumulationPass.h"
+
+#include "../Scene.h"
+#include "../ShaderInclude.h"
+#include "../Structs.h"
+#include "../TransientCommandBuffer.h"
+#include "BasePass.h"
+
+AccumulationPass::AccumulationPass(vk::Device              device,
+                                   vk::DescriptorPool      staticDescriptorPool,
+                                   ResourceManager&        allocator,
+                                   vk::Extent2D            screenSize,
+                                   std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                                   TransientCommandBuffer& transientCommandBuffer)
+{
+    _sampler = allocator.createSampler(device,
+                                       vk::Filter::eNearest,
+                                       vk::Filter::eNearest,
+                                       vk::SamplerMipmapMode::eNearest);
+
+    std::array<vk::DescriptorSetLayoutBinding, 7> bindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eUniformBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eUniformBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 5,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 6,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _descriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings    = bindings.data(),
+    });
+
+    _pipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = 1,
+        .pSetLayouts    = &*_descriptorLayout,
+    });
+
+    reloadShaders(device);
+
+    UniformBuffer = allocator.createTypedBuffer<shader::AccumulationUniforms>(
+        1,
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+    DispatchBuffer = allocator.createTypedBuffer<vk::DispatchIndirectCommand>(
+        1,
+        vk::BufferUsageFlagBits::eIndirectBuffer,
+        VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+    std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> setLayouts;
+    for (vk::DescriptorSetLayout& setLayout : setLayouts)
+    {
+        setLayout = *_descriptorLayout;
+    }
+
+    std::vector<vk::UniqueDescriptorSet> descriptorSets = device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(setLayouts.size()),
+        .pSetLayouts        = setLayouts.data(),
+    });
+
+    for (size_t i = 0; i < framebufferData.size(); ++i)
+    {
+        framebufferData[i].AccumulationDescriptor = std::move(descriptorSets[i]);
+    }
+
+    onResized(device, allocator, screenSize, transientCommandBuffer);
+}
+
+void AccumulationPass::reloadShaders(vk::Device device)
+{
+    _shader =
+        Shader(device, "shaders/accumulate.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+
+    auto [result, pipeline] = device.createComputePipelineUnique(nullptr,
+                                                                 {
+                                                                     .stage  = *_shader,
+                                                                     .layout = *_pipelineLayout,
+                                                                 });
+
+    if (result != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create compute pipeline!" << std::endl;
+        std::abort();
+    }
+
+    _pipeline = std::move(pipeline);
+}
+
+void AccumulationPass::issueCommands(vk::CommandBuffer commandBuffer,
+                                     vk::DescriptorSet accumulationDescriptor) const
+{
+    // The illumination has to be shaded, and the previous frame's lighting pass has to be done
+    // reading the average
+    vk::MemoryBarrier illuminationBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader |
+                                      vk::PipelineStageFlagBits::eFragmentShader,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  illuminationBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_pipelineLayout,
+                                     0,
+                                     {accumulationDescriptor},
+                                     {});
+    commandBuffer.dispatchIndirect(*DispatchBuffer, 0);
+
+    vk::MemoryBarrier lightingBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eFragmentShader,
+                                  {},
+                                  lightingBarrier,
+                                  {},
+                                  {});
+}
+
+void AccumulationPass::update(bool enabled, uint32_t sampleCount)
+{
+    auto* uniforms        = UniformBuffer.mapAs<shader::AccumulationUniforms>();
+    uniforms->sampleCount = sampleCount;
+    UniformBuffer.unmap();
+    UniformBuffer.flush();
+
+    auto* command = DispatchBuffer.mapAs<vk::DispatchIndirectCommand>();
+    command->x    = enabled ? ceilDiv(_screenSize.width, 8) : 0;
+    command->y    = enabled ? ceilDiv(_screenSize.height, 8) : 0;
+    command->z    = 1;
+    DispatchBuffer.unmap();
+    DispatchBuffer.flush();
+}
+
+void AccumulationPass::onResized(vk::Device              device,
+                                 ResourceManager&        allocator,
+                                 vk::Extent2D            screenSize,
+                                 TransientCommandBuffer& transientCommandBuffer)
+{
+    _screenSize = screenSize;
+
+    _accumulated = allocator.createImage2D(screenSize,
+                                           vk::Format::eR32G32B32A32Sfloat,
+                                           vk::ImageUsageFlagBits::eStorage |
+                                               vk::ImageUsageFlagBits::eSampled |
+                                               vk::ImageUsageFlagBits::eTransferSrc);
+
+    _accumulatedView = allocator.createImageView2D(device,
+                                                   *_accumulated,
+                                                   vk::Format::eR32G32B32A32Sfloat,
+                                                   vk::ImageAspectFlagBits::eColor);
+
+    transientCommandBuffer.begin();
+    ResourceManager::transitionImageLayout(*transientCommandBuffer,
+                                           *_accumulated,
+                                           vk::Format::eR32G32B32A32Sfloat,
+                                           vk::ImageLayout::eUndefined,
+                                           vk::ImageLayout::eGeneral);
+    transientCommandBuffer.submitAndWait();
+}
+
+void AccumulationPass::initializeDescriptorSetFor(const Framebuffer& framebuffer,
+                                                  const Scene&       scene,
+                                                  vk::Buffer         lightingUniformBuffer,
+                                                  vk::ImageView      illuminationView,
+                                                  vk::Device         device,
+                                                  vk::DescriptorSet  set)
+{
+    vk::DescriptorBufferInfo lightingUniformInfo {
+        .buffer = lightingUniformBuffer,
+        .offset = 0,
+        .range  = sizeof(shader::LightingPassUniforms),
+    };
+
+    vk::DescriptorBufferInfo uniformInfo {
+        .buffer = *UniformBuffer,
+        .offset = 0,
+        .range  = sizeof(shader::AccumulationUniforms),
+    };
+
+    vk::DescriptorImageInfo albedoInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.AlbedoView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo normalInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.NormalView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo illuminationInfo {
+        .sampler     = *_sampler,
+        .imageView   = illuminationView,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    vk::DescriptorImageInfo environmentInfo = scene.Environment.getDescriptorInfo();
+
+    vk::DescriptorImageInfo accumulatedInfo {
+        .imageView   = *_accumulatedView,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    device.updateDescriptorSets(
+        {
+            {{.dstSet          = set,
+              .dstBinding      = 0,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eUniformBuffer,
+              .pBufferInfo     = &lightingUniformInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 1,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eUniformBuffer,
+              .pBufferInfo     = &uniformInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 2,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &albedoInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 3,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &normalInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 4,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &illuminationInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 5,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &environmentInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 6,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageImage,
+              .pImageInfo      = &accumulatedInfo}}
+    },
+        {});
+}
+
+void AccumulationPass::save(ResourceManager&        allocator,
+                            TransientCommandBuffer& transientCommandBuffer,
+                            const std::string&      filename) const
+{
+    ResourceManager::saveImageHdr(*_accumulated,
+                                  vk::Format::eR32G32B32A32Sfloat,
+                                  _screenSize,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::AccessFlagBits::eShaderWrite,
+                                  allocator,
+                                  transientCommandBuffer,
+                                  filename);
+}
+
+vk::ImageView AccumulationPass::getAccumulatedView() const
+{
+    return *_accumulatedView;
+}
+
+constexpr uint32_t AccumulationPass::ceilDiv(uint32_t a, uint32_t b) const
+{
+    return (a + b - 1) / b;
+}
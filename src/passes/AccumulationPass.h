@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../ResourceManager.h"
+#include "../Shader.h"
+
+class Framebuffer;
+class Scene;
+struct FramebufferData;
+
+// Averages the final radiance over the frames that show the same image, so a still camera
+// converges toward a reference
+class AccumulationPass
+{
+public:
+    AccumulationPass() = default;
+    AccumulationPass(vk::Device                                      device,
+                     vk::DescriptorPool                              staticDescriptorPool,
+                     ResourceManager&                                allocator,
+                     vk::Extent2D                                    screenSize,
+                     std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                     TransientCommandBuffer&                         transientCommandBuffer);
+
+    // Rebuilds the pipeline from the .spv file on disk
+    void reloadShaders(vk::Device device);
+
+    // Dispatches through DispatchBuffer, so nothing runs while accumulation is off
+    void issueCommands(vk::CommandBuffer commandBuffer,
+                       vk::DescriptorSet accumulationDescriptor) const;
+
+    // A sample count of zero restarts the average with this frame
+    void update(bool enabled, uint32_t sampleCount);
+
+    void onResized(vk::Device              device,
+                   ResourceManager&        allocator,
+                   vk::Extent2D            screenSize,
+                   TransientCommandBuffer& transientCommandBuffer);
+
+    void initializeDescriptorSetFor(const Framebuffer& framebuffer,
+                                    const Scene&       scene,
+                                    vk::Buffer         lightingUniformBuffer,
+                                    vk::ImageView      illuminationView,
+                                    vk::Device         device,
+                                    vk::DescriptorSet  set);
+
+    // Reads the average back and writes it as a Radiance HDR file
+    void save(ResourceManager&        allocator,
+              TransientCommandBuffer& transientCommandBuffer,
+              const std::string&      filename) const;
+
+    vk::ImageView getAccumulatedView() const;
+
+    UniqueBuffer UniformBuffer;
+    UniqueBuffer DispatchBuffer;
+
+private:
+    Shader _shader;
+
+    vk::UniqueSampler             _sampler;
+    vk::UniqueDescriptorSetLayout _descriptorLayout;
+    vk::UniquePipelineLayout      _pipelineLayout;
+    vk::UniquePipeline            _pipeline;
+
+    vk::Extent2D        _screenSize;
+    UniqueImage         _accumulated;
+    vk::UniqueImageView _accumulatedView;
+
+    constexpr uint32_t ceilDiv(uint32_t a, uint32_t b) const;
+};
@@ -2,6 +2,9 @@
 
 #include "../Scene.h"
 #include "../Structs.h"
+#include "../TextureStreamer.h"
+
+#include <algorithm>
 
 BasePass::BasePass(vk::Device            device,
                    vk::Extent2D          extent,
@@ -12,22 +15,31 @@ BasePass::BasePass(vk::Device            device,
                    const Scene&          scene)
     : _screenSize(extent)
 {
-    _vert = Shader(device, "shaders/base.vert.spv", "main", vk::ShaderStageFlagBits::eVertex);
-    _frag = Shader(device, "shaders/base.frag.spv", "main", vk::ShaderStageFlagBits::eFragment);
+    loadShaders(device);
 
-    std::array<vk::DescriptorSetLayoutBinding, 3> bindings {
+    std::array<vk::DescriptorSetLayoutBinding, 5> bindings {
         {{.binding         = 0,
           .descriptorType  = vk::DescriptorType::eUniformBuffer,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eVertex},
 
          {.binding         = 1,
-          .descriptorType  = vk::DescriptorType::eUniformBufferDynamic,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eVertex},
 
          {.binding         = 2,
-          .descriptorType  = vk::DescriptorType::eUniformBufferDynamic,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eFragment},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eVertex},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eFragment}}
     };
@@ -37,29 +49,32 @@ BasePass::BasePass(vk::Device            device,
         .pBindings    = bindings.data(),
     });
 
-    std::array<vk::DescriptorSetLayoutBinding, 4> textureDescriptorBindings {
-        {{.binding         = 0,
-          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-          .descriptorCount = 1,
-          .stageFlags      = vk::ShaderStageFlagBits::eFragment},
-         {.binding         = 1,
-          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-          .descriptorCount = 1,
-          .stageFlags      = vk::ShaderStageFlagBits::eFragment},
-         {.binding         = 2,
-          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-          .descriptorCount = 1,
-          .stageFlags      = vk::ShaderStageFlagBits::eFragment},
-         {.binding         = 3,
-          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-          .descriptorCount = 1,
-          .stageFlags      = vk::ShaderStageFlagBits::eFragment}}
+    // Every scene texture plus the default white and normal textures, indexed by material
+    vk::DescriptorSetLayoutBinding textureArrayBinding {
+        .binding         = 0,
+        .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+        .descriptorCount = static_cast<uint32_t>(gltfScene.m_textures.size() + 2),
+        .stageFlags      = vk::ShaderStageFlagBits::eFragment |
+                      vk::ShaderStageFlagBits::eAnyHitKHR |
+                      vk::ShaderStageFlagBits::eClosestHitKHR,
     };
 
-    _textureDescriptorSetLayout = device.createDescriptorSetLayoutUnique({
-        .bindingCount = static_cast<uint32_t>(textureDescriptorBindings.size()),
-        .pBindings    = textureDescriptorBindings.data(),
-    });
+    // The texture streamer swaps image views between frames, after the command buffers using
+    // them were recorded
+    vk::DescriptorBindingFlags textureArrayBindingFlags =
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+
+    vk::StructureChain<vk::DescriptorSetLayoutCreateInfo,
+                       vk::DescriptorSetLayoutBindingFlagsCreateInfo>
+        textureLayoutInfo {
+            {.flags        = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+             .bindingCount = 1,
+             .pBindings    = &textureArrayBinding},
+            {.bindingCount = 1, .pBindingFlags = &textureArrayBindingFlags}
+    };
+
+    _textureDescriptorSetLayout = device.createDescriptorSetLayoutUnique(
+        textureLayoutInfo.get<vk::DescriptorSetLayoutCreateInfo>());
 
     std::array<vk::DescriptorSetLayout, 2> descriptorSetLayouts {
         *_setLayout,
@@ -79,20 +94,27 @@ BasePass::BasePass(vk::Device            device,
                                                         vk::BufferUsageFlagBits::eUniformBuffer,
                                                         VMA_MEMORY_USAGE_CPU_TO_GPU);
 
+    TextureFeedback = allocator.createTypedBuffer<int32_t>(
+        gltfScene.m_textures.size() + 2,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        VMA_MEMORY_USAGE_GPU_TO_CPU);
+
+    int32_t* feedback = TextureFeedback.mapAs<int32_t>();
+    std::fill_n(feedback, gltfScene.m_textures.size() + 2, TextureStreamer::NotRequested);
+    TextureFeedback.unmap();
+    TextureFeedback.flush();
+
     _descriptorSet = std::move(device.allocateDescriptorSetsUnique({
         .descriptorPool     = staticDescriptorPool,
         .descriptorSetCount = 1,
         .pSetLayouts        = &*_setLayout,
     })[0]);
 
-    std::vector<vk::DescriptorSetLayout> texturesLayout(gltfScene.m_materials.size());
-    std::fill(texturesLayout.begin(), texturesLayout.end(), *_textureDescriptorSetLayout);
-
-    _texturesDescriptors = device.allocateDescriptorSetsUnique({
+    _textureDescriptorSet = std::move(device.allocateDescriptorSetsUnique({
         .descriptorPool     = textureDescriptorPool,
-        .descriptorSetCount = static_cast<uint32_t>(texturesLayout.size()),
-        .pSetLayouts        = texturesLayout.data(),
-    });
+        .descriptorSetCount = 1,
+        .pSetLayouts        = &*_textureDescriptorSetLayout,
+    })[0]);
 
     _gltfScene = &gltfScene;
     _scene     = &scene;
@@ -100,22 +122,55 @@ BasePass::BasePass(vk::Device            device,
     initializeResourcesFor(gltfScene, scene, device);
 };
 
+void BasePass::reloadShaders(vk::Device device)
+{
+    loadShaders(device);
+    createGraphicsPipeline(device);
+}
+
+void BasePass::loadShaders(vk::Device device)
+{
+    _vert = Shader(device, "shaders/base.vert.spv", "main", vk::ShaderStageFlagBits::eVertex);
+    _frag = Shader(device, "shaders/base.frag.spv", "main", vk::ShaderStageFlagBits::eFragment);
+}
+
 void BasePass::onResized(vk::Device device, vk::Extent2D screenSizes)
 {
     _screenSize = screenSizes;
     createGraphicsPipeline(device);
 }
 
-void BasePass::issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffer framebuffer) const
+void BasePass::issueCommands(vk::CommandBuffer commandBuffer,
+                             vk::Framebuffer   framebuffer,
+                             vk::Buffer        drawCommands,
+                             uint32_t          drawCount) const
 {
-    std::array<vk::ClearValue, 5> clearValues {
+    std::array<vk::ClearValue, 6> clearValues {
         {{.color = {std::array<float, 4> {0.0f, 0.0f, 0.0f, 1.0f}}},
          {.color = {std::array<float, 4> {0.0f, 0.0f, 0.0f, 1.0f}}},
          {.color = {std::array<float, 4> {0.0f, 0.0f, 0.0f, 1.0f}}},
          {.color = {std::array<float, 4> {0.0f, 0.0f, 0.0f, 1.0f}}},
+         {.color = {std::array<float, 4> {0.0f, 0.0f, 0.0f, 1.0f}}},
          {.depthStencil = {1.0f}}}
     };
 
+    commandBuffer.fillBuffer(*TextureFeedback,
+                             0,
+                             VK_WHOLE_SIZE,
+                             static_cast<uint32_t>(TextureStreamer::NotRequested));
+
+    vk::MemoryBarrier fillBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                  vk::PipelineStageFlagBits::eFragmentShader,
+                                  {},
+                                  fillBarrier,
+                                  nullptr,
+                                  nullptr);
+
     commandBuffer.beginRenderPass(
         {
             .renderPass      = *RenderPass,
@@ -127,35 +182,78 @@ void BasePass::issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffer fr
         vk::SubpassContents::eInline);
 
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *_pipeline);
-    commandBuffer.bindVertexBuffers(0, {*_scene->Vertices}, {0});
+    commandBuffer.bindVertexBuffers(0, {*_scene->Positions, *_scene->Attributes}, {0, 0});
     commandBuffer.bindIndexBuffer(*_scene->Indices, 0, vk::IndexType::eUint32);
 
-    for (std::size_t i = 0; i < _gltfScene->m_nodes.size(); ++i)
-    {
-        const nvh::GltfNode&     node = _gltfScene->m_nodes[i];
-        const nvh::GltfPrimMesh& mesh = _gltfScene->m_primMeshes[node.primMesh];
-
-        commandBuffer.bindDescriptorSets(
-            vk::PipelineBindPoint::eGraphics,
-            *_pipelineLayout,
-            0,
-            {
-                *_descriptorSet,
-                *_texturesDescriptors[mesh.materialIndex],
-            },
-            {
-                static_cast<uint32_t>(i * sizeof(shader::ModelMatrices)),
-                static_cast<uint32_t>(mesh.materialIndex * sizeof(shader::MaterialUniforms)),
-            });
-
-        commandBuffer.drawIndexed(mesh.indexCount,
-                                  1,
-                                  mesh.firstIndex,
-                                  static_cast<uint32_t>(mesh.vertexOffset),
-                                  0);
-    }
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                     *_pipelineLayout,
+                                     0,
+                                     {*_descriptorSet, *_textureDescriptorSet},
+                                     {});
+
+    commandBuffer.drawIndexedIndirect(drawCommands,
+                                      0,
+                                      drawCount,
+                                      sizeof(vk::DrawIndexedIndirectCommand));
 
     commandBuffer.endRenderPass();
+
+    vk::MemoryBarrier feedbackBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eHostRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+                                  vk::PipelineStageFlagBits::eHost,
+                                  {},
+                                  feedbackBarrier,
+                                  nullptr,
+                                  nullptr);
+}
+
+void BasePass::bindVisibleInstances(vk::Device device, vk::Buffer visibleInstances)
+{
+    vk::DescriptorBufferInfo visibleInstancesInfo {
+        .buffer = visibleInstances,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::WriteDescriptorSet write {
+        .dstSet          = *_descriptorSet,
+        .dstBinding      = 3,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo     = &visibleInstancesInfo,
+    };
+
+    device.updateDescriptorSets(write, {});
+}
+
+vk::DescriptorSetLayout BasePass::getTextureDescriptorSetLayout() const
+{
+    return *_textureDescriptorSetLayout;
+}
+
+vk::DescriptorSet BasePass::getTextureDescriptorSet() const
+{
+    return *_textureDescriptorSet;
+}
+
+void BasePass::updateTexture(vk::Device                     device,
+                             uint32_t                       texture,
+                             const vk::DescriptorImageInfo& imageInfo)
+{
+    vk::WriteDescriptorSet write {
+        .dstSet          = *_textureDescriptorSet,
+        .dstBinding      = 0,
+        .dstArrayElement = texture,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+        .pImageInfo      = &imageInfo,
+    };
+
+    device.updateDescriptorSets(write, {});
 }
 
 void BasePass::initializeResourcesFor(const nvh::GltfScene& targetScene,
@@ -181,120 +279,57 @@ void BasePass::initializeResourcesFor(const nvh::GltfScene& targetScene,
         .pBufferInfo     = &uniformBufferInfo,
     });
 
-    vk::DescriptorBufferInfo matricesBufferInfo {
-        .buffer = *buffers.Matrices,
+    vk::DescriptorBufferInfo instancesBufferInfo {
+        .buffer = *buffers.Instances,
         .offset = 0,
-        .range  = sizeof(shader::ModelMatrices),
+        .range  = VK_WHOLE_SIZE,
     };
 
     bufferWrite.push_back({
         .dstSet          = *_descriptorSet,
         .dstBinding      = 1,
         .descriptorCount = 1,
-        .descriptorType  = vk::DescriptorType::eUniformBufferDynamic,
-        .pBufferInfo     = &matricesBufferInfo,
+        .descriptorType  = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo     = &instancesBufferInfo,
     });
 
     vk::DescriptorBufferInfo materialsBufferInfo {
         .buffer = *buffers.Materials,
         .offset = 0,
-        .range  = sizeof(shader::MaterialUniforms),
+        .range  = VK_WHOLE_SIZE,
     };
 
     bufferWrite.push_back({
         .dstSet          = *_descriptorSet,
         .dstBinding      = 2,
         .descriptorCount = 1,
-        .descriptorType  = vk::DescriptorType::eUniformBufferDynamic,
+        .descriptorType  = vk::DescriptorType::eStorageBuffer,
         .pBufferInfo     = &materialsBufferInfo,
     });
 
-    std::vector<vk::DescriptorImageInfo> materialTextureInfo(buffers.Textures.size());
-    vk::DescriptorImageInfo defaultNormalInfo = buffers.DefaultNormalTexture.getDescriptorInfo();
-    vk::DescriptorImageInfo defaultWhiteInfo  = buffers.DefaultWhiteTexture.getDescriptorInfo();
-    for (std::size_t i = 0; i < buffers.Textures.size(); ++i)
-    {
-        materialTextureInfo[i] = buffers.Textures[i].getDescriptorInfo();
-    }
-    for (std::size_t i = 0; i < targetScene.m_materials.size(); ++i)
-    {
-        vk::DescriptorSet        set = *_texturesDescriptors[i];
-        const nvh::GltfMaterial& mat = targetScene.m_materials[i];
+    vk::DescriptorBufferInfo textureFeedbackBufferInfo {
+        .buffer = *TextureFeedback,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
 
-        switch (mat.shadingModel)
-        {
-            case METALLIC_ROUGHNESS: {
-                bufferWrite.push_back({
-                    .dstSet          = set,
-                    .dstBinding      = 0,
-                    .descriptorCount = 1,
-                    .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-                    .pImageInfo      = mat.pbrBaseColorTexture >= 0
-                                           ? &materialTextureInfo[mat.pbrBaseColorTexture]
-                                           : &defaultWhiteInfo,
-                });
-                break;
-            }
-            case SPECULAR_GLOSSINESS: {
-                bufferWrite.push_back({
-                    .dstSet          = set,
-                    .dstBinding      = 0,
-                    .descriptorCount = 1,
-                    .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-                    .pImageInfo      = mat.khrDiffuseTexture >= 0
-                                           ? &materialTextureInfo[mat.khrDiffuseTexture]
-                                           : &defaultWhiteInfo,
-                });
-                break;
-            }
-        }
-
-        bufferWrite.push_back({
-            .dstSet          = set,
-            .dstBinding      = 1,
-            .descriptorCount = 1,
-            .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-            .pImageInfo      = mat.normalTexture >= 0 ? &materialTextureInfo[mat.normalTexture]
-                                                      : &defaultNormalInfo,
-        });
-
-        switch (mat.shadingModel)
-        {
-            case METALLIC_ROUGHNESS: {
-                bufferWrite.push_back({
-                    .dstSet          = set,
-                    .dstBinding      = 2,
-                    .descriptorCount = 1,
-                    .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-                    .pImageInfo      = mat.pbrMetallicRoughnessTexture >= 0
-                                           ? &materialTextureInfo[mat.pbrMetallicRoughnessTexture]
-                                           : &defaultWhiteInfo,
-                });
-                break;
-            }
-            case SPECULAR_GLOSSINESS: {
-                bufferWrite.push_back({
-                    .dstSet          = set,
-                    .dstBinding      = 2,
-                    .descriptorCount = 1,
-                    .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-                    .pImageInfo      = mat.khrSpecularGlossinessTexture >= 0
-                                           ? &materialTextureInfo[mat.khrSpecularGlossinessTexture]
-                                           : &defaultWhiteInfo,
-                });
-                break;
-            }
-        }
-
-        bufferWrite.push_back({
-            .dstSet          = set,
-            .dstBinding      = 3,
-            .descriptorCount = 1,
-            .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-            .pImageInfo      = mat.emissiveTexture >= 0 ? &materialTextureInfo[mat.emissiveTexture]
-                                                        : &defaultWhiteInfo,
-        });
-    }
+    bufferWrite.push_back({
+        .dstSet          = *_descriptorSet,
+        .dstBinding      = 4,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo     = &textureFeedbackBufferInfo,
+    });
+
+    std::vector<vk::DescriptorImageInfo> textureArrayInfo = buffers.getTextureArrayInfo();
+
+    bufferWrite.push_back({
+        .dstSet          = *_textureDescriptorSet,
+        .dstBinding      = 0,
+        .descriptorCount = static_cast<uint32_t>(textureArrayInfo.size()),
+        .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+        .pImageInfo      = textureArrayInfo.data(),
+    });
 
     device.updateDescriptorSets(bufferWrite, {});
 }
@@ -305,37 +340,40 @@ void BasePass::createGraphicsPipeline(vk::Device device)
         {*_frag, *_vert}
     };
 
-    std::array<vk::VertexInputBindingDescription, 1> vertexInputBindingStorage {{{
-        .binding   = 0,
-        .stride    = static_cast<uint32_t>(sizeof(Vertex)),
-        .inputRate = vk::VertexInputRate::eVertex,
-    }}};
+    std::array<vk::VertexInputBindingDescription, 2> vertexInputBindingStorage {
+        {{
+             .binding   = 0,
+             .stride    = static_cast<uint32_t>(sizeof(nvmath::vec3f)),
+             .inputRate = vk::VertexInputRate::eVertex,
+         }, {
+             .binding   = 1,
+             .stride    = static_cast<uint32_t>(sizeof(VertexAttributes)),
+             .inputRate = vk::VertexInputRate::eVertex,
+         }}
+    };
 
     std::array<vk::VertexInputAttributeDescription, 5> vertexInputAttributeStorage {
-        {{.location = 0,
-          .binding  = 0,
-          .format   = vk::Format::eR32G32B32Sfloat,
-          .offset   = static_cast<uint32_t>(offsetof(Vertex, position))},
+        {{.location = 0, .binding = 0, .format = vk::Format::eR32G32B32Sfloat, .offset = 0},
 
          {.location = 1,
-          .binding  = 0,
-          .format   = vk::Format::eR32G32B32Sfloat,
-          .offset   = static_cast<uint32_t>(offsetof(Vertex, normal))},
+          .binding  = 1,
+          .format   = vk::Format::eR16G16Snorm,
+          .offset   = static_cast<uint32_t>(offsetof(VertexAttributes, normal))},
 
          {.location = 2,
-          .binding  = 0,
-          .format   = vk::Format::eR32G32B32A32Sfloat,
-          .offset   = static_cast<uint32_t>(offsetof(Vertex, tangent))},
+          .binding  = 1,
+          .format   = vk::Format::eR32Uint,
+          .offset   = static_cast<uint32_t>(offsetof(VertexAttributes, tangent))},
 
          {.location = 3,
-          .binding  = 0,
-          .format   = vk::Format::eR32G32B32A32Sfloat,
-          .offset   = static_cast<uint32_t>(offsetof(Vertex, color))},
+          .binding  = 1,
+          .format   = vk::Format::eR8G8B8A8Unorm,
+          .offset   = static_cast<uint32_t>(offsetof(VertexAttributes, color))},
 
          {.location = 4,
-          .binding  = 0,
-          .format   = vk::Format::eR32G32Sfloat,
-          .offset   = static_cast<uint32_t>(offsetof(Vertex, uv))}}
+          .binding  = 1,
+          .format   = vk::Format::eR16G16Sfloat,
+          .offset   = static_cast<uint32_t>(offsetof(VertexAttributes, uv))}}
     };
 
     vk::PipelineVertexInputStateCreateInfo vertexInputState {
@@ -397,6 +435,9 @@ void BasePass::createGraphicsPipeline(vk::Device device)
          {.blendEnable    = false,
           .colorWriteMask = vk::ColorComponentFlagBits::eA | vk::ColorComponentFlagBits::eR |
                             vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB},
+         {.blendEnable    = false,
+          .colorWriteMask = vk::ColorComponentFlagBits::eA | vk::ColorComponentFlagBits::eR |
+                            vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB},
          {.blendEnable    = false,
           .colorWriteMask = vk::ColorComponentFlagBits::eA | vk::ColorComponentFlagBits::eR |
                             vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB}}
@@ -439,7 +480,7 @@ void BasePass::createPass(vk::Device device)
 {
     const Formats& formats = Formats::get();
 
-    std::array<vk::AttachmentDescription, 5> attachments {
+    std::array<vk::AttachmentDescription, 6> attachments {
         {
          {.format         = formats.Albedo,
              .samples        = vk::SampleCountFlagBits::e1,
@@ -477,6 +518,15 @@ void BasePass::createPass(vk::Device device)
              .initialLayout  = vk::ImageLayout::eUndefined,
              .finalLayout    = vk::ImageLayout::eShaderReadOnlyOptimal},
 
+         {.format         = formats.MotionVector,
+             .samples        = vk::SampleCountFlagBits::e1,
+             .loadOp         = vk::AttachmentLoadOp::eClear,
+             .storeOp        = vk::AttachmentStoreOp::eStore,
+             .stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
+             .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
+             .initialLayout  = vk::ImageLayout::eUndefined,
+             .finalLayout    = vk::ImageLayout::eShaderReadOnlyOptimal},
+
          {.format         = formats.Depth,
              .samples        = vk::SampleCountFlagBits::e1,
              .loadOp         = vk::AttachmentLoadOp::eClear,
@@ -488,15 +538,16 @@ void BasePass::createPass(vk::Device device)
          }
     };
 
-    std::array<vk::AttachmentReference, 4> colorAttachmentReferences {
+    std::array<vk::AttachmentReference, 5> colorAttachmentReferences {
         {{.attachment = 0, .layout = vk::ImageLayout::eColorAttachmentOptimal},
          {.attachment = 1, .layout = vk::ImageLayout::eColorAttachmentOptimal},
          {.attachment = 2, .layout = vk::ImageLayout::eColorAttachmentOptimal},
-         {.attachment = 3, .layout = vk::ImageLayout::eColorAttachmentOptimal}}
+         {.attachment = 3, .layout = vk::ImageLayout::eColorAttachmentOptimal},
+         {.attachment = 4, .layout = vk::ImageLayout::eColorAttachmentOptimal}}
     };
 
     const vk::AttachmentReference depthAttachmentReference {
-        .attachment = 4,
+        .attachment = 5,
         .layout     = vk::ImageLayout::eDepthStencilAttachmentOptimal,
     };
 
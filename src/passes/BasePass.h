@@ -13,6 +13,7 @@ public:
     struct Uniforms
     {
         nvmath::mat4 projectionViewMatrix;
+        nvmath::mat4 prevFrameProjectionViewMatrix;
     };
 
     BasePass() = default;
@@ -24,23 +25,44 @@ public:
              const nvh::GltfScene& gltfScene,
              const Scene&          scene);
 
-    void issueCommands(vk::CommandBuffer  commandBuffer,
-                       vk::Framebuffer    framebuffer) const;
+    // Draws every mesh once with the instance count the culling pass left in drawCommands
+    void issueCommands(vk::CommandBuffer commandBuffer,
+                       vk::Framebuffer   framebuffer,
+                       vk::Buffer        drawCommands,
+                       uint32_t          drawCount) const;
 
     void onResized(vk::Device device, vk::Extent2D screenSizes);
 
+    // Rebuilds the pipeline from the .spv files on disk
+    void reloadShaders(vk::Device device);
+
+    // The instance list the culling pass writes, indexed by gl_InstanceIndex
+    void bindVisibleInstances(vk::Device device, vk::Buffer visibleInstances);
+
+    // Points one entry of the texture array at a newly streamed image
+    void updateTexture(vk::Device                     device,
+                       uint32_t                       texture,
+                       const vk::DescriptorImageInfo& imageInfo);
+
     void initializeResourcesFor(const nvh::GltfScene&, const Scene&, vk::Device);
 
+    // The scene texture array, shared with the alpha tested shadow rays
+    vk::DescriptorSetLayout getTextureDescriptorSetLayout() const;
+    vk::DescriptorSet       getTextureDescriptorSet() const;
+
     vk::UniqueRenderPass RenderPass;
 
     UniqueBuffer UniformBuffer;
 
+    // Finest mip level base.frag asked for per texture, relative to the bound image
+    UniqueBuffer TextureFeedback;
+
 private:
     const nvh::GltfScene* _gltfScene = nullptr;
     const Scene*          _scene     = nullptr;
 
-    vk::UniqueDescriptorSet              _descriptorSet;
-    std::vector<vk::UniqueDescriptorSet> _texturesDescriptors;
+    vk::UniqueDescriptorSet _descriptorSet;
+    vk::UniqueDescriptorSet _textureDescriptorSet;
 
     vk::UniqueDescriptorSetLayout _setLayout;
     vk::UniqueDescriptorSetLayout _textureDescriptorSetLayout;
@@ -52,6 +74,7 @@ private:
     vk::UniquePipelineLayout _pipelineLayout;
     vk::UniquePipeline       _pipeline;
 
+    void loadShaders(vk::Device device);
     void createPass(vk::Device device);
     void createGraphicsPipeline(vk::Device device);
 };
@@ -0,0 +1,505 @@
+#include "CullingPass.h"
+
+#include "../Scene.h"
+#include "../ShaderInclude.h"
+#include "../Structs.h"
+#include "../TransientCommandBuffer.h"
+
+CullingPass::CullingPass(vk::Device                                      device,
+                         vk::DescriptorPool                              staticDescriptorPool,
+                         ResourceManager&                                allocator,
+                         const Scene&                                    scene,
+                         vk::Extent2D                                    screenSize,
+                         std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                         TransientCommandBuffer&                         transientCommandBuffer)
+    : DrawCount(scene.MeshDrawCount)
+    , _scene(&scene)
+    , _instanceCount(scene.InstanceCount)
+    , _descriptorPool(staticDescriptorPool)
+{
+    _downsampleShader = Shader(device,
+                               "shaders/hiZDownsample.comp.spv",
+                               "main",
+                               vk::ShaderStageFlagBits::eCompute);
+    _cullShader = Shader(device, "shaders/cull.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+
+    _sampler = allocator.createSampler(device,
+                                       vk::Filter::eNearest,
+                                       vk::Filter::eNearest,
+                                       vk::SamplerMipmapMode::eNearest);
+
+    std::array<vk::DescriptorSetLayoutBinding, 2> downsampleBindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _downsampleDescriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(downsampleBindings.size()),
+        .pBindings    = downsampleBindings.data(),
+    });
+
+    std::array<vk::DescriptorSetLayoutBinding, 6> cullBindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eUniformBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 5,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _cullDescriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(cullBindings.size()),
+        .pBindings    = cullBindings.data(),
+    });
+
+    _downsamplePipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = 1,
+        .pSetLayouts    = &*_downsampleDescriptorLayout,
+    });
+
+    _cullPipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = 1,
+        .pSetLayouts    = &*_cullDescriptorLayout,
+    });
+
+    auto [downsampleResult, downsamplePipeline] =
+        device.createComputePipelineUnique(nullptr,
+                                           {
+                                               .stage  = *_downsampleShader,
+                                               .layout = *_downsamplePipelineLayout,
+                                           });
+
+    auto [cullResult, cullPipeline] =
+        device.createComputePipelineUnique(nullptr,
+                                           {
+                                               .stage  = *_cullShader,
+                                               .layout = *_cullPipelineLayout,
+                                           });
+
+    if (downsampleResult != vk::Result::eSuccess || cullResult != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create compute pipeline!" << std::endl;
+        std::abort();
+    }
+
+    _downsamplePipeline = std::move(downsamplePipeline);
+    _cullPipeline       = std::move(cullPipeline);
+
+    UniformBuffer = allocator.createTypedBuffer<shader::CullingUniforms>(
+        1,
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+    VisibleDrawCommands = allocator.createTypedBuffer<vk::DrawIndexedIndirectCommand>(
+        std::max(DrawCount, 1u),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferDst,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    VisibleInstances = allocator.createTypedBuffer<uint32_t>(
+        std::max(_instanceCount, 1u),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> setLayouts;
+    for (vk::DescriptorSetLayout& setLayout : setLayouts)
+    {
+        setLayout = *_downsampleDescriptorLayout;
+    }
+
+    std::vector<vk::UniqueDescriptorSet> seedSets = device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(setLayouts.size()),
+        .pSetLayouts        = setLayouts.data(),
+    });
+
+    for (size_t i = 0; i < framebufferData.size(); ++i)
+    {
+        framebufferData[i].HiZSeedDescriptor = std::move(seedSets[i]);
+    }
+
+    _cullDescriptor = std::move(device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts        = &*_cullDescriptorLayout,
+    })[0]);
+
+    onResized(device, allocator, screenSize, framebufferData, transientCommandBuffer);
+}
+
+void CullingPass::issueCommands(vk::CommandBuffer commandBuffer,
+                                vk::DescriptorSet hiZSeedDescriptor) const
+{
+    // The previous frame's depth writes, pyramid reads, indirect reads and instance list reads
+    // all have to finish before this frame starts overwriting their inputs
+    vk::MemoryBarrier depthBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests |
+                                      vk::PipelineStageFlagBits::eDrawIndirect |
+                                      vk::PipelineStageFlagBits::eVertexShader |
+                                      vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eComputeShader |
+                                      vk::PipelineStageFlagBits::eTransfer,
+                                  {},
+                                  depthBarrier,
+                                  {},
+                                  {});
+
+    // Resets every mesh's instance count to zero
+    if (DrawCount > 0)
+    {
+        commandBuffer.copyBuffer(*_scene->MeshDrawCommands,
+                                 *VisibleDrawCommands,
+                                 vk::BufferCopy {
+                                     .size = DrawCount * sizeof(vk::DrawIndexedIndirectCommand),
+                                 });
+    }
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_downsamplePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_downsamplePipelineLayout,
+                                     0,
+                                     {hiZSeedDescriptor},
+                                     {});
+    commandBuffer.dispatch(ceilDiv(_hiZMipSizes[0].width, 8),
+                           ceilDiv(_hiZMipSizes[0].height, 8),
+                           1);
+
+    vk::MemoryBarrier mipBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    for (std::size_t i = 0; i < _downsampleDescriptors.size(); ++i)
+    {
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                      vk::PipelineStageFlagBits::eComputeShader,
+                                      {},
+                                      mipBarrier,
+                                      {},
+                                      {});
+
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                         *_downsamplePipelineLayout,
+                                         0,
+                                         {*_downsampleDescriptors[i]},
+                                         {});
+        commandBuffer.dispatch(ceilDiv(_hiZMipSizes[i + 1].width, 8),
+                               ceilDiv(_hiZMipSizes[i + 1].height, 8),
+                               1);
+    }
+
+    vk::MemoryBarrier cullInputBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader |
+                                      vk::PipelineStageFlagBits::eTransfer,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  cullInputBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_cullPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_cullPipelineLayout,
+                                     0,
+                                     {*_cullDescriptor},
+                                     {});
+    commandBuffer.dispatch(ceilDiv(_instanceCount, 64), 1, 1);
+
+    vk::MemoryBarrier indirectBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eDrawIndirect |
+                                      vk::PipelineStageFlagBits::eVertexShader,
+                                  {},
+                                  indirectBarrier,
+                                  {},
+                                  {});
+}
+
+void CullingPass::onResized(vk::Device                                      device,
+                            ResourceManager&                                allocator,
+                            vk::Extent2D                                    screenSize,
+                            std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                            TransientCommandBuffer&                         transientCommandBuffer)
+{
+    createHiZImage(device, allocator, screenSize, transientCommandBuffer);
+    initializeDescriptorSets(device, framebufferData);
+
+    auto* uniforms          = UniformBuffer.mapAs<shader::CullingUniforms>();
+    uniforms->screenSize    = nvmath::uvec2(screenSize.width, screenSize.height);
+    uniforms->instanceCount = _instanceCount;
+    UniformBuffer.unmap();
+    UniformBuffer.flush();
+}
+
+void CullingPass::createHiZImage(vk::Device              device,
+                                 ResourceManager&        allocator,
+                                 vk::Extent2D            screenSize,
+                                 TransientCommandBuffer& transientCommandBuffer)
+{
+    _hiZMipViews.clear();
+    _hiZMipSizes.clear();
+    _hiZView.reset();
+    _hiZImage.reset();
+
+    // Mip 0 is already a 2x2 reduction of the depth buffer
+    vk::Extent2D mipSize {
+        .width  = std::max(screenSize.width >> 1, 1u),
+        .height = std::max(screenSize.height >> 1, 1u),
+    };
+
+    uint32_t mipLevels =
+        1 + static_cast<uint32_t>(std::floor(std::log2(std::max(mipSize.width, mipSize.height))));
+
+    _hiZImage = allocator.createImage2D(mipSize,
+                                        vk::Format::eR32Sfloat,
+                                        vk::ImageUsageFlagBits::eStorage |
+                                            vk::ImageUsageFlagBits::eSampled,
+                                        VMA_MEMORY_USAGE_GPU_ONLY,
+                                        vk::ImageTiling::eOptimal,
+                                        vk::ImageLayout::eUndefined,
+                                        mipLevels);
+
+    _hiZView = allocator.createImageView2D(device,
+                                           *_hiZImage,
+                                           vk::Format::eR32Sfloat,
+                                           vk::ImageAspectFlagBits::eColor,
+                                           0,
+                                           mipLevels);
+
+    for (uint32_t i = 0; i < mipLevels; ++i)
+    {
+        _hiZMipViews.push_back(allocator.createImageView2D(device,
+                                                           *_hiZImage,
+                                                           vk::Format::eR32Sfloat,
+                                                           vk::ImageAspectFlagBits::eColor,
+                                                           i,
+                                                           1));
+        _hiZMipSizes.push_back(mipSize);
+
+        mipSize = {
+            .width  = std::max(mipSize.width >> 1, 1u),
+            .height = std::max(mipSize.height >> 1, 1u),
+        };
+    }
+
+    transientCommandBuffer.begin();
+    ResourceManager::transitionImageLayout(*transientCommandBuffer,
+                                           *_hiZImage,
+                                           vk::Format::eR32Sfloat,
+                                           vk::ImageLayout::eUndefined,
+                                           vk::ImageLayout::eGeneral,
+                                           0,
+                                           mipLevels);
+    transientCommandBuffer.submitAndWait();
+}
+
+void CullingPass::initializeDescriptorSets(
+    vk::Device                                      device,
+    std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData)
+{
+    _downsampleDescriptors.clear();
+
+    std::vector<vk::DescriptorSetLayout> setLayouts(_hiZMipViews.size() - 1,
+                                                    *_downsampleDescriptorLayout);
+    if (!setLayouts.empty())
+    {
+        _downsampleDescriptors = device.allocateDescriptorSetsUnique({
+            .descriptorPool     = _descriptorPool,
+            .descriptorSetCount = static_cast<uint32_t>(setLayouts.size()),
+            .pSetLayouts        = setLayouts.data(),
+        });
+    }
+
+    std::vector<vk::DescriptorImageInfo> mipInfos(_hiZMipViews.size());
+    for (std::size_t i = 0; i < _hiZMipViews.size(); ++i)
+    {
+        mipInfos[i] = {
+            .sampler     = *_sampler,
+            .imageView   = *_hiZMipViews[i],
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+    }
+
+    std::array<vk::DescriptorImageInfo, FRAMEBUFFER_COUNT> seedInfos;
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (std::size_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
+    {
+        const Framebuffer& previousFramebuffer =
+            framebufferData[(i + FRAMEBUFFER_COUNT - 1) % FRAMEBUFFER_COUNT].framebuffer;
+
+        seedInfos[i] = {
+            .sampler     = *_sampler,
+            .imageView   = *previousFramebuffer.DepthView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        writes.push_back({
+            .dstSet          = *framebufferData[i].HiZSeedDescriptor,
+            .dstBinding      = 0,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+            .pImageInfo      = &seedInfos[i],
+        });
+
+        writes.push_back({
+            .dstSet          = *framebufferData[i].HiZSeedDescriptor,
+            .dstBinding      = 1,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eStorageImage,
+            .pImageInfo      = &mipInfos[0],
+        });
+    }
+
+    for (std::size_t i = 0; i < _downsampleDescriptors.size(); ++i)
+    {
+        writes.push_back({
+            .dstSet          = *_downsampleDescriptors[i],
+            .dstBinding      = 0,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+            .pImageInfo      = &mipInfos[i],
+        });
+
+        writes.push_back({
+            .dstSet          = *_downsampleDescriptors[i],
+            .dstBinding      = 1,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eStorageImage,
+            .pImageInfo      = &mipInfos[i + 1],
+        });
+    }
+
+    vk::DescriptorBufferInfo uniformInfo {
+        .buffer = *UniformBuffer,
+        .offset = 0,
+        .range  = sizeof(shader::CullingUniforms),
+    };
+
+    vk::DescriptorBufferInfo boundsInfo {
+        .buffer = *_scene->InstanceBounds,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo instancesInfo {
+        .buffer = *_scene->Instances,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo visibleDrawCommandsInfo {
+        .buffer = *VisibleDrawCommands,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo visibleInstancesInfo {
+        .buffer = *VisibleInstances,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorImageInfo hiZInfo {
+        .sampler     = *_sampler,
+        .imageView   = *_hiZView,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    writes.push_back({
+        .dstSet          = *_cullDescriptor,
+        .dstBinding      = 0,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eUniformBuffer,
+        .pBufferInfo     = &uniformInfo,
+    });
+
+    writes.push_back({
+        .dstSet          = *_cullDescriptor,
+        .dstBinding      = 1,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo     = &boundsInfo,
+    });
+
+    writes.push_back({
+        .dstSet          = *_cullDescriptor,
+        .dstBinding      = 2,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo     = &instancesInfo,
+    });
+
+    writes.push_back({
+        .dstSet          = *_cullDescriptor,
+        .dstBinding      = 3,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo     = &visibleDrawCommandsInfo,
+    });
+
+    writes.push_back({
+        .dstSet          = *_cullDescriptor,
+        .dstBinding      = 4,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo     = &visibleInstancesInfo,
+    });
+
+    writes.push_back({
+        .dstSet          = *_cullDescriptor,
+        .dstBinding      = 5,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+        .pImageInfo      = &hiZInfo,
+    });
+
+    device.updateDescriptorSets(writes, {});
+}
+
+constexpr uint32_t CullingPass::ceilDiv(uint32_t a, uint32_t b) const
+{
+    return (a + b - 1) / b;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../ResourceManager.h"
+#include "../Shader.h"
+
+class Framebuffer;
+class Scene;
+struct FramebufferData;
+
+class CullingPass
+{
+public:
+    CullingPass() = default;
+    CullingPass(vk::Device                                      device,
+                vk::DescriptorPool                              staticDescriptorPool,
+                ResourceManager&                                allocator,
+                const Scene&                                    scene,
+                vk::Extent2D                                    screenSize,
+                std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                TransientCommandBuffer&                         transientCommandBuffer);
+
+    // Builds the depth pyramid from the previous frame's depth, then counts the visible instances
+    // of every mesh into VisibleDrawCommands and lists them in VisibleInstances.
+    void issueCommands(vk::CommandBuffer commandBuffer, vk::DescriptorSet hiZSeedDescriptor) const;
+
+    void onResized(vk::Device                                      device,
+                   ResourceManager&                                allocator,
+                   vk::Extent2D                                    screenSize,
+                   std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                   TransientCommandBuffer&                         transientCommandBuffer);
+
+    UniqueBuffer UniformBuffer;
+    UniqueBuffer VisibleDrawCommands;
+    UniqueBuffer VisibleInstances;
+
+    uint32_t DrawCount = 0;
+
+private:
+    const Scene* _scene         = nullptr;
+    uint32_t     _instanceCount = 0;
+
+    Shader _downsampleShader;
+    Shader _cullShader;
+
+    vk::UniqueSampler _sampler;
+
+    vk::UniqueDescriptorSetLayout _downsampleDescriptorLayout;
+    vk::UniqueDescriptorSetLayout _cullDescriptorLayout;
+
+    vk::UniquePipelineLayout _downsamplePipelineLayout;
+    vk::UniquePipelineLayout _cullPipelineLayout;
+
+    vk::UniquePipeline _downsamplePipeline;
+    vk::UniquePipeline _cullPipeline;
+
+    vk::DescriptorPool _descriptorPool;
+
+    UniqueImage                      _hiZImage;
+    vk::UniqueImageView              _hiZView;
+    std::vector<vk::UniqueImageView> _hiZMipViews;
+    std::vector<vk::Extent2D>        _hiZMipSizes;
+
+    // _downsampleDescriptors[i] reduces mip i into mip i + 1
+    std::vector<vk::UniqueDescriptorSet> _downsampleDescriptors;
+    vk::UniqueDescriptorSet              _cullDescriptor;
+
+    void createHiZImage(vk::Device              device,
+                        ResourceManager&        allocator,
+                        vk::Extent2D            screenSize,
+                        TransientCommandBuffer& transientCommandBuffer);
+
+    void initializeDescriptorSets(vk::Device                                      device,
+                                  std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData);
+
+    constexpr uint32_t ceilDiv(uint32_t a, uint32_t b) const;
+};
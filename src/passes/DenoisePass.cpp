@@ -0,0 +1,717 @@
+#include "DenoisePass.h"
+
+#include "../ShaderInclude.h"
+#include "../Structs.h"
+#include "../TransientCommandBuffer.h"
+#include "BasePass.h"
+
+DenoisePass::DenoisePass(vk::Device                                      device,
+                         vk::DescriptorPool                              staticDescriptorPool,
+                         ResourceManager&                                allocator,
+                         vk::Extent2D                                    screenSize,
+                         std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                         vk::DescriptorSetLayout                         restirStaticLayout,
+                         TransientCommandBuffer&                         transientCommandBuffer)
+{
+    _sampler = allocator.createSampler(device,
+                                       vk::Filter::eNearest,
+                                       vk::Filter::eNearest,
+                                       vk::SamplerMipmapMode::eNearest);
+
+    std::array<vk::DescriptorSetLayoutBinding, 7> shadeBindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 5,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 6,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _shadeDescriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(shadeBindings.size()),
+        .pBindings    = shadeBindings.data(),
+    });
+
+    std::array<vk::DescriptorSetLayoutBinding, 9> temporalBindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 5,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 6,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 7,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 8,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _temporalDescriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(temporalBindings.size()),
+        .pBindings    = temporalBindings.data(),
+    });
+
+    std::array<vk::DescriptorSetLayoutBinding, 5> atrousBindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _atrousDescriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(atrousBindings.size()),
+        .pBindings    = atrousBindings.data(),
+    });
+
+    std::array<vk::DescriptorSetLayout, 2> shadeLayouts {restirStaticLayout,
+                                                         *_shadeDescriptorLayout};
+    _shadePipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = static_cast<uint32_t>(shadeLayouts.size()),
+        .pSetLayouts    = shadeLayouts.data(),
+    });
+
+    std::array<vk::DescriptorSetLayout, 2> temporalLayouts {restirStaticLayout,
+                                                            *_temporalDescriptorLayout};
+    _temporalPipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = static_cast<uint32_t>(temporalLayouts.size()),
+        .pSetLayouts    = temporalLayouts.data(),
+    });
+
+    vk::PushConstantRange stepSizeRange {
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset     = 0,
+        .size       = sizeof(int32_t),
+    };
+
+    std::array<vk::DescriptorSetLayout, 2> atrousLayouts {restirStaticLayout,
+                                                          *_atrousDescriptorLayout};
+    _atrousPipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount         = static_cast<uint32_t>(atrousLayouts.size()),
+        .pSetLayouts            = atrousLayouts.data(),
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges    = &stepSizeRange,
+    });
+
+    reloadShaders(device);
+
+    DispatchBuffer = allocator.createTypedBuffer<vk::DispatchIndirectCommand>(
+        1,
+        vk::BufferUsageFlagBits::eIndirectBuffer,
+        VMA_MEMORY_USAGE_CPU_TO_GPU);
+    setEnabled(false, screenSize);
+
+    std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> shadeSetLayouts;
+    std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> temporalSetLayouts;
+    for (std::size_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
+    {
+        shadeSetLayouts[i]    = *_shadeDescriptorLayout;
+        temporalSetLayouts[i] = *_temporalDescriptorLayout;
+    }
+
+    std::vector<vk::UniqueDescriptorSet> shadeSets = device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(shadeSetLayouts.size()),
+        .pSetLayouts        = shadeSetLayouts.data(),
+    });
+
+    std::vector<vk::UniqueDescriptorSet> temporalSets = device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(temporalSetLayouts.size()),
+        .pSetLayouts        = temporalSetLayouts.data(),
+    });
+
+    std::array<vk::DescriptorSetLayout, AtrousIterations> atrousSetLayouts;
+    for (vk::DescriptorSetLayout& setLayout : atrousSetLayouts)
+    {
+        setLayout = *_atrousDescriptorLayout;
+    }
+
+    for (size_t i = 0; i < framebufferData.size(); ++i)
+    {
+        framebufferData[i].DenoiseShadeDescriptor    = std::move(shadeSets[i]);
+        framebufferData[i].DenoiseTemporalDescriptor = std::move(temporalSets[i]);
+
+        framebufferData[i].DenoiseAtrousDescriptors = device.allocateDescriptorSetsUnique({
+            .descriptorPool     = staticDescriptorPool,
+            .descriptorSetCount = static_cast<uint32_t>(atrousSetLayouts.size()),
+            .pSetLayouts        = atrousSetLayouts.data(),
+        });
+    }
+
+    onResized(device, allocator, screenSize, transientCommandBuffer);
+}
+
+void DenoisePass::reloadShaders(vk::Device device)
+{
+    _shadeShader =
+        Shader(device, "shaders/denoiseShade.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+    _temporalShader = Shader(device,
+                             "shaders/denoiseTemporal.comp.spv",
+                             "main",
+                             vk::ShaderStageFlagBits::eCompute);
+    _atrousShader =
+        Shader(device, "shaders/denoiseAtrous.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+
+    auto [shadeResult, shadePipeline] =
+        device.createComputePipelineUnique(nullptr,
+                                           {
+                                               .stage  = *_shadeShader,
+                                               .layout = *_shadePipelineLayout,
+                                           });
+
+    auto [temporalResult, temporalPipeline] =
+        device.createComputePipelineUnique(nullptr,
+                                           {
+                                               .stage  = *_temporalShader,
+                                               .layout = *_temporalPipelineLayout,
+                                           });
+
+    auto [atrousResult, atrousPipeline] =
+        device.createComputePipelineUnique(nullptr,
+                                           {
+                                               .stage  = *_atrousShader,
+                                               .layout = *_atrousPipelineLayout,
+                                           });
+
+    if (shadeResult != vk::Result::eSuccess || temporalResult != vk::Result::eSuccess ||
+        atrousResult != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create compute pipeline!" << std::endl;
+        std::abort();
+    }
+
+    _shadePipeline    = std::move(shadePipeline);
+    _temporalPipeline = std::move(temporalPipeline);
+    _atrousPipeline   = std::move(atrousPipeline);
+}
+
+void DenoisePass::issueCommands(vk::CommandBuffer                           commandBuffer,
+                                vk::DescriptorSet                           restirStaticDescriptor,
+                                vk::DescriptorSet                           shadeDescriptor,
+                                vk::DescriptorSet                           temporalDescriptor,
+                                const std::vector<vk::UniqueDescriptorSet>& atrousDescriptors,
+                                vk::Extent2D                                screenSize) const
+{
+    // The reservoirs have to be final, and the previous frame's lighting pass has to be done
+    // reading the images about to be overwritten
+    vk::MemoryBarrier reservoirBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader |
+                                      vk::PipelineStageFlagBits::eRayTracingShaderKHR |
+                                      vk::PipelineStageFlagBits::eFragmentShader,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  reservoirBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_shadePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_shadePipelineLayout,
+                                     0,
+                                     {restirStaticDescriptor, shadeDescriptor},
+                                     {});
+    commandBuffer.dispatch(ceilDiv(screenSize.width, 8), ceilDiv(screenSize.height, 8), 1);
+
+    vk::MemoryBarrier imageBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  imageBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_temporalPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_temporalPipelineLayout,
+                                     0,
+                                     {restirStaticDescriptor, temporalDescriptor},
+                                     {});
+    commandBuffer.dispatchIndirect(*DispatchBuffer, 0);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_atrousPipeline);
+    for (uint32_t i = 0; i < AtrousIterations; ++i)
+    {
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                      vk::PipelineStageFlagBits::eComputeShader,
+                                      {},
+                                      imageBarrier,
+                                      {},
+                                      {});
+
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                         *_atrousPipelineLayout,
+                                         0,
+                                         {restirStaticDescriptor, *atrousDescriptors[i]},
+                                         {});
+
+        int32_t stepSize = 1 << i;
+        commandBuffer.pushConstants(*_atrousPipelineLayout,
+                                    vk::ShaderStageFlagBits::eCompute,
+                                    0,
+                                    sizeof(int32_t),
+                                    &stepSize);
+        commandBuffer.dispatchIndirect(*DispatchBuffer, 0);
+    }
+
+    // Read by the lighting pass, recorded into the presenting command buffer
+    vk::MemoryBarrier lightingBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eFragmentShader,
+                                  {},
+                                  lightingBarrier,
+                                  {},
+                                  {});
+}
+
+void DenoisePass::setEnabled(bool enabled, vk::Extent2D screenSize)
+{
+    auto* command = DispatchBuffer.mapAs<vk::DispatchIndirectCommand>();
+    command->x    = enabled ? ceilDiv(screenSize.width, 8) : 0;
+    command->y    = enabled ? ceilDiv(screenSize.height, 8) : 0;
+    command->z    = 1;
+    DispatchBuffer.unmap();
+    DispatchBuffer.flush();
+}
+
+void DenoisePass::onResized(vk::Device              device,
+                            ResourceManager&        allocator,
+                            vk::Extent2D            screenSize,
+                            TransientCommandBuffer& transientCommandBuffer)
+{
+    _illumination =
+        createStorageImage(device, allocator, screenSize, vk::Format::eR16G16B16A16Sfloat);
+    _integrated =
+        createStorageImage(device, allocator, screenSize, vk::Format::eR16G16B16A16Sfloat);
+
+    // The second moment of a bright pixel's luminance does not fit a half float
+    for (std::size_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
+    {
+        _history[i] =
+            createStorageImage(device, allocator, screenSize, vk::Format::eR16G16B16A16Sfloat);
+        _moments[i] =
+            createStorageImage(device, allocator, screenSize, vk::Format::eR32G32B32A32Sfloat);
+    }
+
+    for (StorageImage& filtered : _filtered)
+    {
+        filtered =
+            createStorageImage(device, allocator, screenSize, vk::Format::eR16G16B16A16Sfloat);
+    }
+
+    std::vector<vk::Image> images {*_illumination.Image, *_integrated.Image};
+    for (std::size_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
+    {
+        images.push_back(*_history[i].Image);
+        images.push_back(*_moments[i].Image);
+    }
+    for (const StorageImage& filtered : _filtered)
+    {
+        images.push_back(*filtered.Image);
+    }
+
+    transientCommandBuffer.begin();
+    for (vk::Image image : images)
+    {
+        ResourceManager::transitionImageLayout(*transientCommandBuffer,
+                                               image,
+                                               vk::Format::eR16G16B16A16Sfloat,
+                                               vk::ImageLayout::eUndefined,
+                                               vk::ImageLayout::eGeneral);
+    }
+    transientCommandBuffer.submitAndWait();
+}
+
+void DenoisePass::initializeDescriptorSets(
+    vk::Device                                      device,
+    std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+    vk::DeviceSize                                  reservoirBufferSize,
+    vk::Buffer                                      giReservoirBuffer,
+    vk::DeviceSize                                  giReservoirBufferSize)
+{
+    for (std::size_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
+    {
+        const std::size_t  previous             = (i + FRAMEBUFFER_COUNT - 1) % FRAMEBUFFER_COUNT;
+        const Framebuffer& framebuffer          = framebufferData[i].framebuffer;
+        const Framebuffer& prevFrameFramebuffer = framebufferData[previous].framebuffer;
+
+        vk::DescriptorImageInfo albedoInfo {
+            .sampler     = *_sampler,
+            .imageView   = *framebuffer.AlbedoView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo normalInfo {
+            .sampler     = *_sampler,
+            .imageView   = *framebuffer.NormalView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo materialPropertiesInfo {
+            .sampler     = *_sampler,
+            .imageView   = *framebuffer.MaterialPropertiesView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo worldPositionInfo {
+            .sampler     = *_sampler,
+            .imageView   = *framebuffer.WorldPositionView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo motionVectorInfo {
+            .sampler     = *_sampler,
+            .imageView   = *framebuffer.MotionVectorView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo prevNormalInfo {
+            .sampler     = *_sampler,
+            .imageView   = *prevFrameFramebuffer.NormalView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo prevMotionVectorInfo {
+            .sampler     = *_sampler,
+            .imageView   = *prevFrameFramebuffer.MotionVectorView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorBufferInfo reservoirsInfo {
+            .buffer = *framebufferData[i].ReservoirBuffer,
+            .offset = 0,
+            .range  = reservoirBufferSize,
+        };
+
+        vk::DescriptorBufferInfo giReservoirsInfo {
+            .buffer = giReservoirBuffer,
+            .offset = 0,
+            .range  = giReservoirBufferSize,
+        };
+
+        vk::DescriptorImageInfo illuminationInfo {
+            .imageView   = *_illumination.View,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        vk::DescriptorImageInfo integratedInfo {
+            .imageView   = *_integrated.View,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        vk::DescriptorImageInfo historyInfo {
+            .imageView   = *_history[i].View,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        vk::DescriptorImageInfo prevHistoryInfo {
+            .imageView   = *_history[previous].View,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        vk::DescriptorImageInfo momentsInfo {
+            .imageView   = *_moments[i].View,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        vk::DescriptorImageInfo prevMomentsInfo {
+            .imageView   = *_moments[previous].View,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        std::array<vk::DescriptorImageInfo, 2> filteredInfos;
+        for (std::size_t j = 0; j < filteredInfos.size(); ++j)
+        {
+            filteredInfos[j] = {
+                .imageView   = *_filtered[j].View,
+                .imageLayout = vk::ImageLayout::eGeneral,
+            };
+        }
+
+        vk::DescriptorSet shadeSet    = *framebufferData[i].DenoiseShadeDescriptor;
+        vk::DescriptorSet temporalSet = *framebufferData[i].DenoiseTemporalDescriptor;
+
+        std::vector<vk::WriteDescriptorSet> writes {
+            {{.dstSet          = shadeSet,
+              .dstBinding      = 0,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &albedoInfo},
+
+             {.dstSet          = shadeSet,
+              .dstBinding      = 1,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &normalInfo},
+
+             {.dstSet          = shadeSet,
+              .dstBinding      = 2,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &materialPropertiesInfo},
+
+             {.dstSet          = shadeSet,
+              .dstBinding      = 3,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &worldPositionInfo},
+
+             {.dstSet          = shadeSet,
+              .dstBinding      = 4,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &reservoirsInfo},
+
+             {.dstSet          = shadeSet,
+              .dstBinding      = 5,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &giReservoirsInfo},
+
+             {.dstSet          = shadeSet,
+              .dstBinding      = 6,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageImage,
+              .pImageInfo      = &illuminationInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 0,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &normalInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 1,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &motionVectorInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 2,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &prevNormalInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 3,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &prevMotionVectorInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 4,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageImage,
+              .pImageInfo      = &illuminationInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 5,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageImage,
+              .pImageInfo      = &prevHistoryInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 6,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageImage,
+              .pImageInfo      = &prevMomentsInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 7,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageImage,
+              .pImageInfo      = &integratedInfo},
+
+             {.dstSet          = temporalSet,
+              .dstBinding      = 8,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageImage,
+              .pImageInfo      = &momentsInfo}}
+        };
+
+        // The first iteration becomes the history the next frame accumulates onto, the rest
+        // alternate between the two filtered images
+        for (std::size_t j = 0; j < AtrousIterations; ++j)
+        {
+            vk::DescriptorSet atrousSet = *framebufferData[i].DenoiseAtrousDescriptors[j];
+
+            const vk::DescriptorImageInfo* sourceInfo      = &filteredInfos[j % 2];
+            const vk::DescriptorImageInfo* destinationInfo = &filteredInfos[(j + 1) % 2];
+            if (j == 0)
+            {
+                sourceInfo      = &integratedInfo;
+                destinationInfo = &historyInfo;
+            }
+            else if (j == 1)
+            {
+                sourceInfo = &historyInfo;
+            }
+
+            writes.push_back({
+                .dstSet          = atrousSet,
+                .dstBinding      = 0,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                .pImageInfo      = &normalInfo,
+            });
+
+            writes.push_back({
+                .dstSet          = atrousSet,
+                .dstBinding      = 1,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                .pImageInfo      = &worldPositionInfo,
+            });
+
+            writes.push_back({
+                .dstSet          = atrousSet,
+                .dstBinding      = 2,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                .pImageInfo      = &motionVectorInfo,
+            });
+
+            writes.push_back({
+                .dstSet          = atrousSet,
+                .dstBinding      = 3,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eStorageImage,
+                .pImageInfo      = sourceInfo,
+            });
+
+            writes.push_back({
+                .dstSet          = atrousSet,
+                .dstBinding      = 4,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eStorageImage,
+                .pImageInfo      = destinationInfo,
+            });
+        }
+
+        device.updateDescriptorSets(writes, {});
+    }
+}
+
+vk::ImageView DenoisePass::getIlluminationView() const
+{
+    return *_illumination.View;
+}
+
+vk::ImageView DenoisePass::getDenoisedIlluminationView() const
+{
+    return *_filtered[AtrousIterations % 2].View;
+}
+
+DenoisePass::StorageImage DenoisePass::createStorageImage(vk::Device       device,
+                                                          ResourceManager& allocator,
+                                                          vk::Extent2D     screenSize,
+                                                          vk::Format       format) const
+{
+    StorageImage storageImage;
+    storageImage.Image = allocator.createImage2D(screenSize,
+                                                 format,
+                                                 vk::ImageUsageFlagBits::eStorage |
+                                                     vk::ImageUsageFlagBits::eSampled);
+    storageImage.View  = allocator.createImageView2D(device,
+                                                    *storageImage.Image,
+                                                    format,
+                                                    vk::ImageAspectFlagBits::eColor);
+    return storageImage;
+}
+
+constexpr uint32_t DenoisePass::ceilDiv(uint32_t a, uint32_t b) const
+{
+    return (a + b - 1) / b;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../ResourceManager.h"
+#include "../Shader.h"
+
+struct FramebufferData;
+
+// Spatiotemporal variance-guided filtering: shades the final reservoirs into illumination,
+// accumulates it over time along with its luminance moments and filters it with an edge-aware
+// a-trous wavelet. Shares the static ReSTIR set.
+class DenoisePass
+{
+public:
+    DenoisePass() = default;
+    DenoisePass(vk::Device                                      device,
+                vk::DescriptorPool                              staticDescriptorPool,
+                ResourceManager&                                allocator,
+                vk::Extent2D                                    screenSize,
+                std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                vk::DescriptorSetLayout                         restirStaticLayout,
+                TransientCommandBuffer&                         transientCommandBuffer);
+
+    static constexpr uint32_t AtrousIterations = 5;
+
+    // Rebuilds the pipelines from the .spv files on disk
+    void reloadShaders(vk::Device device);
+
+    // Shading always runs, the filter dispatches through DispatchBuffer so the same recording
+    // serves with the denoiser on or off
+    void issueCommands(vk::CommandBuffer                           commandBuffer,
+                       vk::DescriptorSet                           restirStaticDescriptor,
+                       vk::DescriptorSet                           shadeDescriptor,
+                       vk::DescriptorSet                           temporalDescriptor,
+                       const std::vector<vk::UniqueDescriptorSet>& atrousDescriptors,
+                       vk::Extent2D                                screenSize) const;
+
+    void setEnabled(bool enabled, vk::Extent2D screenSize);
+
+    // Recreates the images, their descriptors are rewritten by initializeDescriptorSets
+    void onResized(vk::Device              device,
+                   ResourceManager&        allocator,
+                   vk::Extent2D            screenSize,
+                   TransientCommandBuffer& transientCommandBuffer);
+
+    // Shades this frame's light reservoirs and the spatially resampled GI reservoirs
+    void initializeDescriptorSets(
+        vk::Device                                      device,
+        std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+        vk::DeviceSize                                  reservoirBufferSize,
+        vk::Buffer                                      giReservoirBuffer,
+        vk::DeviceSize                                  giReservoirBufferSize);
+
+    vk::ImageView getIlluminationView() const;
+    vk::ImageView getDenoisedIlluminationView() const;
+
+    UniqueBuffer DispatchBuffer;
+
+private:
+    static_assert(AtrousIterations >= 2, "The first iteration writes the history");
+
+    struct StorageImage
+    {
+        UniqueImage         Image;
+        vk::UniqueImageView View;
+    };
+
+    Shader _shadeShader;
+    Shader _temporalShader;
+    Shader _atrousShader;
+
+    vk::UniqueSampler _sampler;
+
+    vk::UniqueDescriptorSetLayout _shadeDescriptorLayout;
+    vk::UniqueDescriptorSetLayout _temporalDescriptorLayout;
+    vk::UniqueDescriptorSetLayout _atrousDescriptorLayout;
+
+    vk::UniquePipelineLayout _shadePipelineLayout;
+    vk::UniquePipelineLayout _temporalPipelineLayout;
+    vk::UniquePipelineLayout _atrousPipelineLayout;
+
+    vk::UniquePipeline _shadePipeline;
+    vk::UniquePipeline _temporalPipeline;
+    vk::UniquePipeline _atrousPipeline;
+
+    StorageImage _illumination;
+    StorageImage _integrated;
+
+    // Indexed by frame, the next frame reprojects them
+    std::array<StorageImage, FRAMEBUFFER_COUNT> _history;
+    std::array<StorageImage, FRAMEBUFFER_COUNT> _moments;
+
+    // The a-trous iterations after the first alternate between these
+    std::array<StorageImage, 2> _filtered;
+
+    StorageImage createStorageImage(vk::Device       device,
+                                    ResourceManager& allocator,
+                                    vk::Extent2D     screenSize,
+                                    vk::Format       format) const;
+
+    constexpr uint32_t ceilDiv(uint32_t a, uint32_t b) const;
+};
@@ -0,0 +1,750 @@
+#include "GiPass.h"
+
+#include "../Scene.h"
+#include "../ShaderInclude.h"
+#include "../Structs.h"
+#include "BasePass.h"
+
+GiPass::GiPass(vk::Device                                      device,
+               vk::PhysicalDevice                              physicalDevice,
+               vk::DescriptorPool                              staticDescriptorPool,
+               ResourceManager&                                allocator,
+               std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+               vk::DescriptorSetLayout                         restirStaticDescriptorSetLayout,
+               vk::DescriptorSetLayout                         textureDescriptorSetLayout)
+{
+    _sampler = allocator.createSampler(device,
+                                       vk::Filter::eNearest,
+                                       vk::Filter::eNearest,
+                                       vk::SamplerMipmapMode::eNearest);
+
+    std::array<vk::DescriptorSetLayoutBinding, 10> frameBindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 5,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 6,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 7,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 8,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 9,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR}}
+    };
+
+    _frameDescriptorSetLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(frameBindings.size()),
+        .pBindings    = frameBindings.data(),
+    });
+
+    std::array<vk::DescriptorSetLayout, 3> descriptorLayouts {restirStaticDescriptorSetLayout,
+                                                              *_frameDescriptorSetLayout,
+                                                              textureDescriptorSetLayout};
+
+    _pipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = static_cast<uint32_t>(descriptorLayouts.size()),
+        .pSetLayouts    = descriptorLayouts.data(),
+    });
+
+    std::array<vk::DescriptorSetLayoutBinding, 13> spatialReuseBindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eUniformBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 5,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 6,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 7,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 8,
+          .descriptorType  = vk::DescriptorType::eAccelerationStructureKHR,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 9,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 10,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 11,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 12,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _spatialReuseDescriptorSetLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(spatialReuseBindings.size()),
+        .pBindings    = spatialReuseBindings.data(),
+    });
+
+    std::array<vk::DescriptorSetLayout, 2> spatialReuseLayouts {*_spatialReuseDescriptorSetLayout,
+                                                                textureDescriptorSetLayout};
+
+    _spatialReusePipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = static_cast<uint32_t>(spatialReuseLayouts.size()),
+        .pSetLayouts    = spatialReuseLayouts.data(),
+    });
+
+    loadShaders(device);
+    createPipelines(device, physicalDevice, allocator);
+
+    std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> frameSetLayouts;
+    std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> spatialReuseSetLayouts;
+    for (size_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
+    {
+        frameSetLayouts[i]        = *_frameDescriptorSetLayout;
+        spatialReuseSetLayouts[i] = *_spatialReuseDescriptorSetLayout;
+    }
+
+    std::vector<vk::UniqueDescriptorSet> frameDescriptorSets = device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(frameSetLayouts.size()),
+        .pSetLayouts        = frameSetLayouts.data(),
+    });
+
+    std::vector<vk::UniqueDescriptorSet> spatialReuseSets = device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(spatialReuseSetLayouts.size()),
+        .pSetLayouts        = spatialReuseSetLayouts.data(),
+    });
+
+    for (size_t i = 0; i < framebufferData.size(); ++i)
+    {
+        framebufferData[i].GiFrameDescriptor        = std::move(frameDescriptorSets[i]);
+        framebufferData[i].GiSpatialReuseDescriptor = std::move(spatialReuseSets[i]);
+    }
+}
+
+void GiPass::reloadShaders(vk::Device         device,
+                           vk::PhysicalDevice physicalDevice,
+                           ResourceManager&   allocator)
+{
+    loadShaders(device);
+    createPipelines(device, physicalDevice, allocator);
+}
+
+void GiPass::issueCommands(vk::CommandBuffer commandBuffer,
+                           vk::DescriptorSet restirStaticDescriptor,
+                           vk::DescriptorSet giFrameDescriptor,
+                           vk::DescriptorSet giSpatialReuseDescriptor,
+                           vk::DescriptorSet textureDescriptor,
+                           vk::Extent2D      screenSize) const
+{
+    // The light reservoirs of this frame have to be complete
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+                                  vk::PipelineStageFlagBits::eAllCommands,
+                                  {},
+                                  {},
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, *_rayTracingPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR,
+                                     *_pipelineLayout,
+                                     0,
+                                     {restirStaticDescriptor, giFrameDescriptor, textureDescriptor},
+                                     {});
+    commandBuffer.traceRaysKHR(_rayGenSBT,
+                               _rayMissSBT,
+                               _rayHitSBT,
+                               {},
+                               screenSize.width,
+                               screenSize.height,
+                               1);
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  {},
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_spatialReusePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_spatialReusePipelineLayout,
+                                     0,
+                                     {giSpatialReuseDescriptor, textureDescriptor},
+                                     {});
+    commandBuffer.dispatch(ceilDiv(screenSize.width, 8), ceilDiv(screenSize.height, 8), 1);
+}
+
+void GiPass::initializeFrameDescriptorSetFor(const Framebuffer& framebuffer,
+                                             const Framebuffer& prevFrameFramebuffer,
+                                             vk::Buffer         lightReservoirBuffer,
+                                             vk::DeviceSize     lightReservoirBufferSize,
+                                             vk::Buffer         giReservoirBuffer,
+                                             vk::Buffer         prevFrameGiReservoirBuffer,
+                                             vk::DeviceSize     giReservoirBufferSize,
+                                             vk::Device         device,
+                                             vk::DescriptorSet  set)
+{
+    vk::DescriptorImageInfo worldPositionInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.WorldPositionView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo albedoInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.AlbedoView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo normalInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.NormalView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo materialPropertiesInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.MaterialPropertiesView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo motionVectorInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.MotionVectorView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo previousNormalInfo {
+        .sampler     = *_sampler,
+        .imageView   = *prevFrameFramebuffer.NormalView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo previousMotionVectorInfo {
+        .sampler     = *_sampler,
+        .imageView   = *prevFrameFramebuffer.MotionVectorView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorBufferInfo lightReservoirInfo {
+        .buffer = lightReservoirBuffer,
+        .offset = 0,
+        .range  = lightReservoirBufferSize,
+    };
+
+    vk::DescriptorBufferInfo giReservoirInfo {
+        .buffer = giReservoirBuffer,
+        .offset = 0,
+        .range  = giReservoirBufferSize,
+    };
+
+    vk::DescriptorBufferInfo prevGiReservoirInfo {
+        .buffer = prevFrameGiReservoirBuffer,
+        .offset = 0,
+        .range  = giReservoirBufferSize,
+    };
+
+    device.updateDescriptorSets(
+        {
+            {{.dstSet          = set,
+              .dstBinding      = 0,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &worldPositionInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 1,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &albedoInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 2,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &normalInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 3,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &materialPropertiesInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 4,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &motionVectorInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 5,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &previousNormalInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 6,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &previousMotionVectorInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 7,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &lightReservoirInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 8,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &giReservoirInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 9,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &prevGiReservoirInfo}}
+    },
+        {});
+}
+
+void GiPass::initializeSpatialReuseDescriptorSetFor(
+    const Framebuffer& framebuffer,
+    const Scene&       scene,
+    vk::Buffer         uniformBuffer,
+    vk::Buffer         reservoirBuffer,
+    vk::Buffer         resultReservoirBuffer,
+    vk::DeviceSize     reservoirBufferSize,
+    vk::Device         device,
+    vk::DescriptorSet  set)
+{
+    vk::DescriptorBufferInfo uniformInfo {
+        .buffer = uniformBuffer,
+        .offset = 0,
+        .range  = sizeof(shader::RestirUniforms),
+    };
+
+    vk::DescriptorImageInfo worldPositionInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.WorldPositionView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo albedoInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.AlbedoView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo normalInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.NormalView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo materialPropertiesInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.MaterialPropertiesView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorImageInfo depthInfo {
+        .sampler     = *_sampler,
+        .imageView   = *framebuffer.DepthView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorBufferInfo reservoirInfo {
+        .buffer = reservoirBuffer,
+        .offset = 0,
+        .range  = reservoirBufferSize,
+    };
+
+    vk::DescriptorBufferInfo resultReservoirInfo {
+        .buffer = resultReservoirBuffer,
+        .offset = 0,
+        .range  = reservoirBufferSize,
+    };
+
+    vk::DescriptorBufferInfo instancesInfo {
+        .buffer = *scene.Instances,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo materialsInfo {
+        .buffer = *scene.Materials,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo attributesInfo {
+        .buffer = *scene.Attributes,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo alphaTestIndicesInfo {
+        .buffer = *scene.AlphaTestIndices,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    device.updateDescriptorSets(
+        {
+            {{.dstSet          = set,
+              .dstBinding      = 0,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eUniformBuffer,
+              .pBufferInfo     = &uniformInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 1,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &worldPositionInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 2,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &albedoInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 3,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &normalInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 4,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &materialPropertiesInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 5,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &depthInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 6,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &reservoirInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 7,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &resultReservoirInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 9,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &instancesInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 10,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &materialsInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 11,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &attributesInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 12,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &alphaTestIndicesInfo}}
+    },
+        {});
+
+    vk::StructureChain<vk::WriteDescriptorSet, vk::WriteDescriptorSetAccelerationStructureKHR>
+        accelerationStructureWrite {
+            {
+             .dstSet          = set,
+             .dstBinding      = 8,
+             .dstArrayElement = 0,
+             .descriptorCount = 1,
+             .descriptorType  = vk::DescriptorType::eAccelerationStructureKHR,
+             },
+            {
+             .accelerationStructureCount = 1,
+             .pAccelerationStructures    = &*scene.TLAS,
+             }
+    };
+
+    device.updateDescriptorSets(accelerationStructureWrite.get<vk::WriteDescriptorSet>(), {});
+}
+
+void GiPass::loadShaders(vk::Device device)
+{
+    _rayGen = Shader(device, "shaders/gi.rgen.spv", "main", vk::ShaderStageFlagBits::eRaygenKHR);
+    _giMiss = Shader(device, "shaders/gi.rmiss.spv", "main", vk::ShaderStageFlagBits::eMissKHR);
+    _giChit =
+        Shader(device, "shaders/gi.rchit.spv", "main", vk::ShaderStageFlagBits::eClosestHitKHR);
+
+    _shadowMiss = Shader(device,
+                         "shaders/visibility.rmiss.spv",
+                         "main",
+                         vk::ShaderStageFlagBits::eMissKHR);
+    _shadowChit = Shader(device,
+                         "shaders/visibility.rchit.spv",
+                         "main",
+                         vk::ShaderStageFlagBits::eClosestHitKHR);
+
+    _rayAhit = Shader(device,
+                      "shaders/visibility.rahit.spv",
+                      "main",
+                      vk::ShaderStageFlagBits::eAnyHitKHR);
+
+    _spatialReuse = Shader(device,
+                           "shaders/giSpatialReuse.comp.spv",
+                           "main",
+                           vk::ShaderStageFlagBits::eCompute);
+}
+
+void GiPass::createPipelines(vk::Device         device,
+                             vk::PhysicalDevice physicalDevice,
+                             ResourceManager&   allocator)
+{
+    // Ray generation, the shadow and bounce misses, then the shadow and bounce hit groups. Both
+    // hit groups run the alpha test.
+    std::array<vk::RayTracingShaderGroupCreateInfoKHR, 5> shaderGroups {
+        {{.type                            = vk::RayTracingShaderGroupTypeKHR::eGeneral,
+          .generalShader                   = 0,
+          .closestHitShader                = VK_SHADER_UNUSED_KHR,
+          .anyHitShader                    = VK_SHADER_UNUSED_KHR,
+          .intersectionShader              = VK_SHADER_UNUSED_KHR,
+          .pShaderGroupCaptureReplayHandle = nullptr},
+         {.type                            = vk::RayTracingShaderGroupTypeKHR::eGeneral,
+          .generalShader                   = 1,
+          .closestHitShader                = VK_SHADER_UNUSED_KHR,
+          .anyHitShader                    = VK_SHADER_UNUSED_KHR,
+          .intersectionShader              = VK_SHADER_UNUSED_KHR,
+          .pShaderGroupCaptureReplayHandle = nullptr},
+         {.type                            = vk::RayTracingShaderGroupTypeKHR::eGeneral,
+          .generalShader                   = 2,
+          .closestHitShader                = VK_SHADER_UNUSED_KHR,
+          .anyHitShader                    = VK_SHADER_UNUSED_KHR,
+          .intersectionShader              = VK_SHADER_UNUSED_KHR,
+          .pShaderGroupCaptureReplayHandle = nullptr},
+         {.type                            = vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
+          .generalShader                   = VK_SHADER_UNUSED_KHR,
+          .closestHitShader                = 3,
+          .anyHitShader                    = 4,
+          .intersectionShader              = VK_SHADER_UNUSED_KHR,
+          .pShaderGroupCaptureReplayHandle = nullptr},
+         {.type                            = vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
+          .generalShader                   = VK_SHADER_UNUSED_KHR,
+          .closestHitShader                = 5,
+          .anyHitShader                    = 4,
+          .intersectionShader              = VK_SHADER_UNUSED_KHR,
+          .pShaderGroupCaptureReplayHandle = nullptr}}
+    };
+
+    std::array<vk::PipelineShaderStageCreateInfo, 6> shaderStages {
+        *_rayGen,
+        *_shadowMiss,
+        *_giMiss,
+        *_shadowChit,
+        *_rayAhit,
+        *_giChit,
+    };
+
+    vk::Result result;
+    std::tie(result, _rayTracingPipeline) =
+        device
+            .createRayTracingPipelineKHRUnique(
+                nullptr,
+                nullptr,
+                {
+                    .stageCount                   = static_cast<uint32_t>(shaderStages.size()),
+                    .pStages                      = shaderStages.data(),
+                    .groupCount                   = static_cast<uint32_t>(shaderGroups.size()),
+                    .pGroups                      = shaderGroups.data(),
+                    .maxPipelineRayRecursionDepth = 1,
+                    .layout                       = *_pipelineLayout,
+                },
+                nullptr)
+            .asTuple();
+
+    if (result != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create ray tracing pipeline!" << std::endl;
+        std::abort();
+    }
+
+    createShaderBindingTable(device, physicalDevice, allocator);
+
+    auto [computeResult, pipeline] =
+        device.createComputePipelineUnique(nullptr,
+                                           {
+                                               .stage  = *_spatialReuse,
+                                               .layout = *_spatialReusePipelineLayout,
+                                           });
+
+    if (computeResult != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create compute pipeline!" << std::endl;
+        std::abort();
+    }
+
+    _spatialReusePipeline = std::move(pipeline);
+}
+
+void GiPass::createShaderBindingTable(vk::Device         device,
+                                      vk::PhysicalDevice physicalDevice,
+                                      ResourceManager&   allocator)
+{
+    vk::StructureChain<vk::PhysicalDeviceProperties2,
+                       vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>
+        physicalDeviceProperties {{}, {}};
+
+    physicalDevice.getProperties2(&physicalDeviceProperties.get<vk::PhysicalDeviceProperties2>());
+
+    vk::PhysicalDeviceRayTracingPipelinePropertiesKHR rtProperties =
+        physicalDeviceProperties.get<vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>();
+
+    // Every record is aligned to the group base alignment, so each region can start at any of them
+    uint32_t       shaderGroupSize        = 5;
+    vk::DeviceSize recordSize             = rtProperties.shaderGroupBaseAlignment;
+    uint32_t       shaderBindingTableSize = shaderGroupSize * rtProperties.shaderGroupBaseAlignment;
+
+    _shaderBindingTable = allocator.createBuffer(
+        {
+            .size  = shaderBindingTableSize,
+            .usage = vk::BufferUsageFlagBits::eTransferSrc |
+                     vk::BufferUsageFlagBits::eShaderDeviceAddress,
+            .sharingMode = vk::SharingMode::eExclusive,
+        },
+        {.usage = VMA_MEMORY_USAGE_CPU_TO_GPU});
+
+    uint8_t*             dstData = _shaderBindingTable.mapAs<uint8_t>();
+    std::vector<uint8_t> shaderHandleStorage(shaderBindingTableSize);
+    vk::Result           result = device.getRayTracingShaderGroupHandlesKHR(*_rayTracingPipeline,
+                                                                  0,
+                                                                  shaderGroupSize,
+                                                                  shaderBindingTableSize,
+                                                                  shaderHandleStorage.data());
+    if (result != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create ray tracing pipeline!" << std::endl;
+        std::abort();
+    }
+
+    for (uint32_t g = 0; g < shaderGroupSize; g++)
+    {
+        memcpy(dstData,
+               shaderHandleStorage.data() + g * rtProperties.shaderGroupHandleSize,
+               rtProperties.shaderGroupHandleSize);
+        dstData += rtProperties.shaderGroupBaseAlignment;
+    }
+
+    _shaderBindingTable.unmap();
+
+    vk::DeviceAddress sbtAddr = device.getBufferAddress({.buffer = *_shaderBindingTable});
+    _rayGenSBT                = vk::StridedDeviceAddressRegionKHR({
+                       .deviceAddress = sbtAddr,
+                       .stride        = recordSize,
+                       .size          = recordSize,
+    });
+
+    _rayMissSBT = vk::StridedDeviceAddressRegionKHR({
+        .deviceAddress = sbtAddr + recordSize,
+        .stride        = recordSize,
+        .size          = 2 * recordSize,
+    });
+
+    _rayHitSBT = vk::StridedDeviceAddressRegionKHR({
+        .deviceAddress = sbtAddr + 3 * recordSize,
+        .stride        = recordSize,
+        .size          = 2 * recordSize,
+    });
+}
+
+constexpr uint32_t GiPass::ceilDiv(uint32_t a, uint32_t b) const
+{
+    return (a + b - 1) / b;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../ResourceManager.h"
+#include "../Shader.h"
+
+class Framebuffer;
+struct FramebufferData;
+class Scene;
+
+// ReSTIR GI: traces one bounce from the G-buffer, resamples the secondary surfaces temporally in
+// the ray generation shader and spatially in a compute pass. Shares the static ReSTIR set.
+class GiPass
+{
+public:
+    GiPass() = default;
+    GiPass(vk::Device                                      device,
+           vk::PhysicalDevice                              physicalDevice,
+           vk::DescriptorPool                              staticDescriptorPool,
+           ResourceManager&                                allocator,
+           std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+           vk::DescriptorSetLayout                         restirStaticDescriptorSetLayout,
+           vk::DescriptorSetLayout                         textureDescriptorSetLayout);
+
+    // Rebuilds both pipelines and the shader binding table from the .spv files on disk
+    void reloadShaders(vk::Device         device,
+                       vk::PhysicalDevice physicalDevice,
+                       ResourceManager&   allocator);
+
+    void issueCommands(vk::CommandBuffer commandBuffer,
+                       vk::DescriptorSet restirStaticDescriptor,
+                       vk::DescriptorSet giFrameDescriptor,
+                       vk::DescriptorSet giSpatialReuseDescriptor,
+                       vk::DescriptorSet textureDescriptor,
+                       vk::Extent2D      screenSize) const;
+
+    // Light reservoirs are this frame's, secondary hits on screen reuse their light samples
+    void initializeFrameDescriptorSetFor(const Framebuffer& framebuffer,
+                                         const Framebuffer& prevFrameFramebuffer,
+                                         vk::Buffer         lightReservoirBuffer,
+                                         vk::DeviceSize     lightReservoirBufferSize,
+                                         vk::Buffer         giReservoirBuffer,
+                                         vk::Buffer         prevFrameGiReservoirBuffer,
+                                         vk::DeviceSize     giReservoirBufferSize,
+                                         vk::Device         device,
+                                         vk::DescriptorSet  set);
+
+    // The neighbour visibility rays alpha test masked geometry like the direct spatial reuse
+    void initializeSpatialReuseDescriptorSetFor(const Framebuffer& framebuffer,
+                                                const Scene&       scene,
+                                                vk::Buffer         uniformBuffer,
+                                                vk::Buffer         reservoirBuffer,
+                                                vk::Buffer         resultReservoirBuffer,
+                                                vk::DeviceSize     reservoirBufferSize,
+                                                vk::Device         device,
+                                                vk::DescriptorSet  set);
+
+private:
+    UniqueBuffer                      _shaderBindingTable;
+    vk::StridedDeviceAddressRegionKHR _rayGenSBT;
+    vk::StridedDeviceAddressRegionKHR _rayMissSBT;
+    vk::StridedDeviceAddressRegionKHR _rayHitSBT;
+
+    Shader _rayGen;
+    Shader _shadowMiss;
+    Shader _giMiss;
+    Shader _shadowChit;
+    Shader _rayAhit;
+    Shader _giChit;
+    Shader _spatialReuse;
+
+    vk::UniqueSampler             _sampler;
+    vk::UniqueDescriptorSetLayout _frameDescriptorSetLayout;
+    vk::UniqueDescriptorSetLayout _spatialReuseDescriptorSetLayout;
+    vk::UniquePipelineLayout      _pipelineLayout;
+    vk::UniquePipelineLayout      _spatialReusePipelineLayout;
+    vk::UniquePipeline            _rayTracingPipeline;
+    vk::UniquePipeline            _spatialReusePipeline;
+
+    void loadShaders(vk::Device device);
+    void createPipelines(vk::Device         device,
+                         vk::PhysicalDevice physicalDevice,
+                         ResourceManager&   allocator);
+
+    void createShaderBindingTable(vk::Device         device,
+                                  vk::PhysicalDevice physicalDevice,
+                                  ResourceManager&   allocator);
+
+    constexpr uint32_t ceilDiv(uint32_t a, uint32_t b) const;
+};
@@ -5,14 +5,12 @@
 #include "BasePass.h"
 
 LightingPass::LightingPass(vk::Device                                      device,
-                           vk::Format                                      format,
                            vk::DescriptorPool                              staticDescriptorPool,
                            ResourceManager&                                allocator,
+                           vk::Extent2D                                    screenSize,
                            std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData)
-    : _swapchainFormat(format)
 {
-    _vert = Shader(device, "shaders/lighting.vert.spv", "main", vk::ShaderStageFlagBits::eVertex);
-    _frag = Shader(device, "shaders/lighting.frag.spv", "main", vk::ShaderStageFlagBits::eFragment);
+    loadShaders(device);
 
     _sampler = allocator.createSampler(device,
                                        vk::Filter::eNearest,
@@ -31,7 +29,7 @@ LightingPass::LightingPass(vk::Device                                      devic
           .stageFlags      = vk::ShaderStageFlagBits::eFragment},
 
          {.binding         = 2,
-          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorType  = vk::DescriptorType::eUniformBuffer,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eFragment},
 
@@ -41,22 +39,22 @@ LightingPass::LightingPass(vk::Device                                      devic
           .stageFlags      = vk::ShaderStageFlagBits::eFragment},
 
          {.binding         = 4,
-          .descriptorType  = vk::DescriptorType::eUniformBuffer,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eFragment},
 
          {.binding         = 5,
-          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eFragment},
 
          {.binding         = 6,
-          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eFragment},
 
          {.binding         = 7,
-          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eFragment}}
     };
@@ -95,11 +93,13 @@ LightingPass::LightingPass(vk::Device                                      devic
     {
         framebufferData[i].LightingPassDescriptorSet = std::move(descriptorSets[i]);
     }
+
+    onResized(device, allocator, screenSize);
 }
 
-void LightingPass::issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffer framebuffer,
-                                 vk::DescriptorSet lightingFrameDescriptorSet, vk::Extent2D
-                                     screenSize) const
+void LightingPass::issueCommands(vk::CommandBuffer commandBuffer,
+                                 vk::DescriptorSet lightingFrameDescriptorSet,
+                                 vk::Extent2D      screenSize) const
 {
     std::array<vk::ClearValue, 1> clearValues {
         {{.color = {std::array<float, 4> {0.0f, 0.0f, 0.0f, 1.0f}}}}};
@@ -107,7 +107,7 @@ void LightingPass::issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffe
     commandBuffer.beginRenderPass(
         {
             .renderPass      = *RenderPass,
-            .framebuffer     = framebuffer,
+            .framebuffer     = *_framebuffer,
             .renderArea      = {.offset = {.x = 0, .y = 0}, .extent = screenSize},
             .clearValueCount = static_cast<uint32_t>(clearValues.size()),
             .pClearValues    = clearValues.data()
@@ -142,8 +142,10 @@ void LightingPass::issueCommands(vk::CommandBuffer commandBuffer, vk::Framebuffe
 void LightingPass::initializeDescriptorSetFor(const Framebuffer& framebuffer,
                                               const Scene&       scene,
                                               vk::Buffer         uniformBuffer,
-                                              vk::Buffer         reservoirBuffer,
-                                              vk::DeviceSize     reservoirBufferSize,
+                                              vk::ImageView      illuminationView,
+                                              vk::ImageView      denoisedIlluminationView,
+                                              vk::ImageView      accumulatedView,
+                                              vk::ImageView      upscaledView,
                                               vk::Device         device,
                                               vk::DescriptorSet  set)
 {
@@ -159,40 +161,37 @@ void LightingPass::initializeDescriptorSetFor(const Framebuffer& framebuffer,
         .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
     };
 
-    vk::DescriptorImageInfo materialPropertiesInfo {
-        .sampler     = *_sampler,
-        .imageView   = *framebuffer.MaterialPropertiesView,
-        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-    };
-
-    vk::DescriptorImageInfo worldPositionInfo {
-        .sampler     = *_sampler,
-        .imageView   = *framebuffer.WorldPositionView,
-        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-    };
-
     vk::DescriptorBufferInfo uniformInfo {
         .buffer = uniformBuffer,
         .offset = 0,
         .range  = sizeof(shader::LightingPassUniforms),
     };
 
-    vk::DescriptorBufferInfo reservoirsInfo {
-        .buffer = reservoirBuffer,
-        .offset = 0,
-        .range  = reservoirBufferSize,
+    // Written by the denoiser's compute passes, which keep their images in the general layout
+    vk::DescriptorImageInfo illuminationInfo {
+        .sampler     = *_sampler,
+        .imageView   = illuminationView,
+        .imageLayout = vk::ImageLayout::eGeneral,
     };
 
-    vk::DescriptorBufferInfo pointLightsInfo {
-        .buffer = *scene.PointLights,
-        .offset = 0,
-        .range  = scene.PointLightsSize,
+    vk::DescriptorImageInfo denoisedIlluminationInfo {
+        .sampler     = *_sampler,
+        .imageView   = denoisedIlluminationView,
+        .imageLayout = vk::ImageLayout::eGeneral,
     };
 
-    vk::DescriptorBufferInfo triangleLightsInfo {
-        .buffer = *scene.TriangleLights,
-        .offset = 0,
-        .range  = scene.TriangleLightsSize,
+    vk::DescriptorImageInfo environmentInfo = scene.Environment.getDescriptorInfo();
+
+    vk::DescriptorImageInfo accumulatedInfo {
+        .sampler     = *_sampler,
+        .imageView   = accumulatedView,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    vk::DescriptorImageInfo upscaledInfo {
+        .sampler     = *_sampler,
+        .imageView   = upscaledView,
+        .imageLayout = vk::ImageLayout::eGeneral,
     };
 
     device.updateDescriptorSets(
@@ -212,53 +211,96 @@ void LightingPass::initializeDescriptorSetFor(const Framebuffer& framebuffer,
              {.dstSet          = set,
               .dstBinding      = 2,
               .descriptorCount = 1,
-              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-              .pImageInfo      = &materialPropertiesInfo},
+              .descriptorType  = vk::DescriptorType::eUniformBuffer,
+              .pBufferInfo     = &uniformInfo},
 
              {.dstSet          = set,
               .dstBinding      = 3,
               .descriptorCount = 1,
               .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-              .pImageInfo      = &worldPositionInfo},
+              .pImageInfo      = &illuminationInfo},
 
              {.dstSet          = set,
               .dstBinding      = 4,
               .descriptorCount = 1,
-              .descriptorType  = vk::DescriptorType::eUniformBuffer,
-              .pBufferInfo     = &uniformInfo},
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &denoisedIlluminationInfo},
 
              {.dstSet          = set,
               .dstBinding      = 5,
               .descriptorCount = 1,
-              .descriptorType  = vk::DescriptorType::eStorageBuffer,
-              .pBufferInfo     = &reservoirsInfo},
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &environmentInfo},
 
              {.dstSet          = set,
               .dstBinding      = 6,
               .descriptorCount = 1,
-              .descriptorType  = vk::DescriptorType::eStorageBuffer,
-              .pBufferInfo     = &pointLightsInfo},
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &accumulatedInfo},
 
              {.dstSet          = set,
               .dstBinding      = 7,
               .descriptorCount = 1,
-              .descriptorType  = vk::DescriptorType::eStorageBuffer,
-              .pBufferInfo     = &triangleLightsInfo}}
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &upscaledInfo}}
     },
         {});
 }
 
+void LightingPass::onResized(vk::Device device, ResourceManager& allocator, vk::Extent2D screenSize)
+{
+    _screenSize = screenSize;
+
+    _hdrImage = allocator.createImage2D(screenSize,
+                                        HdrFormat,
+                                        vk::ImageUsageFlagBits::eColorAttachment |
+                                            vk::ImageUsageFlagBits::eSampled |
+                                            vk::ImageUsageFlagBits::eTransferSrc);
+    _hdrView  = allocator.createImageView2D(device,
+                                           *_hdrImage,
+                                           HdrFormat,
+                                           vk::ImageAspectFlagBits::eColor);
+
+    _framebuffer = device.createFramebufferUnique({
+        .renderPass      = *RenderPass,
+        .attachmentCount = 1,
+        .pAttachments    = &*_hdrView,
+        .width           = screenSize.width,
+        .height          = screenSize.height,
+        .layers          = 1,
+    });
+}
+
+void LightingPass::save(ResourceManager&        allocator,
+                        TransientCommandBuffer& transientCommandBuffer,
+                        const std::string&      filename) const
+{
+    ResourceManager::saveImageHdr(*_hdrImage,
+                                  HdrFormat,
+                                  _screenSize,
+                                  vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                  vk::AccessFlagBits::eColorAttachmentWrite,
+                                  allocator,
+                                  transientCommandBuffer,
+                                  filename);
+}
+
+vk::ImageView LightingPass::getHdrView() const
+{
+    return *_hdrView;
+}
+
 void LightingPass::createPass(vk::Device device)
 {
     vk::AttachmentDescription colorAttachment {
-        .format         = _swapchainFormat,
+        .format         = HdrFormat,
         .samples        = vk::SampleCountFlagBits::e1,
         .loadOp         = vk::AttachmentLoadOp::eClear,
         .storeOp        = vk::AttachmentStoreOp::eStore,
         .stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
         .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
-        .initialLayout  = vk::ImageLayout::eColorAttachmentOptimal,
-        .finalLayout    = vk::ImageLayout::ePresentSrcKHR,
+        .initialLayout  = vk::ImageLayout::eUndefined,
+        .finalLayout    = vk::ImageLayout::eGeneral,
     };
 
     vk::AttachmentReference colorAttachmentReference {
@@ -272,15 +314,28 @@ void LightingPass::createPass(vk::Device device)
         .pColorAttachments    = &colorAttachmentReference,
     };
 
-    vk::SubpassDependency dependency {
-        .srcSubpass   = VK_SUBPASS_EXTERNAL,
-        .dstSubpass   = 0,
-        .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
-                        vk::PipelineStageFlagBits::eLateFragmentTests,
-        .dstStageMask  = vk::PipelineStageFlagBits::eFragmentShader,
-        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite |
-                         vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    // The previous frame's tone mapping and HDR readback have to be done with the target
+    // before it is cleared, and the next tone mapping reads it
+    std::array<vk::SubpassDependency, 2> dependencies {
+        {{.srcSubpass   = VK_SUBPASS_EXTERNAL,
+          .dstSubpass   = 0,
+          .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                          vk::PipelineStageFlagBits::eLateFragmentTests |
+                          vk::PipelineStageFlagBits::eComputeShader |
+                          vk::PipelineStageFlagBits::eTransfer,
+          .dstStageMask = vk::PipelineStageFlagBits::eFragmentShader |
+                          vk::PipelineStageFlagBits::eColorAttachmentOutput,
+          .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite |
+                           vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+          .dstAccessMask =
+              vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eColorAttachmentWrite},
+
+         {.srcSubpass    = 0,
+          .dstSubpass    = VK_SUBPASS_EXTERNAL,
+          .srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+          .dstStageMask  = vk::PipelineStageFlagBits::eComputeShader,
+          .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+          .dstAccessMask = vk::AccessFlagBits::eShaderRead}}
     };
 
     RenderPass = device.createRenderPassUnique({
@@ -288,11 +343,23 @@ void LightingPass::createPass(vk::Device device)
         .pAttachments    = &colorAttachment,
         .subpassCount    = 1,
         .pSubpasses      = &subpass,
-        .dependencyCount = 1,
-        .pDependencies   = &dependency,
+        .dependencyCount = static_cast<uint32_t>(dependencies.size()),
+        .pDependencies   = dependencies.data(),
     });
 }
 
+void LightingPass::reloadShaders(vk::Device device)
+{
+    loadShaders(device);
+    createGraphicsPipeline(device);
+}
+
+void LightingPass::loadShaders(vk::Device device)
+{
+    _vert = Shader(device, "shaders/lighting.vert.spv", "main", vk::ShaderStageFlagBits::eVertex);
+    _frag = Shader(device, "shaders/lighting.frag.spv", "main", vk::ShaderStageFlagBits::eFragment);
+}
+
 void LightingPass::createGraphicsPipeline(vk::Device device)
 {
     std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages {
@@ -7,29 +7,48 @@ class Framebuffer;
 struct FramebufferData;
 class Scene;
 
+// Draws the final radiance into an HDR target at the window's resolution
 class LightingPass
 {
 public:
     LightingPass() = default;
     LightingPass(vk::Device                                      device,
-                 vk::Format                                      format,
                  vk::DescriptorPool                              staticDescriptorPool,
                  ResourceManager&                                allocator,
+                 vk::Extent2D                                    screenSize,
                  std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData);
 
+    static constexpr vk::Format HdrFormat = vk::Format::eR16G16B16A16Sfloat;
+
     void issueCommands(vk::CommandBuffer commandBuffer,
-                       vk::Framebuffer   framebuffer,
                        vk::DescriptorSet lightingFrameDescriptorSet,
                        vk::Extent2D      screenSize) const;
 
+    // Recreates the HDR target and its framebuffer
+    void onResized(vk::Device device, ResourceManager& allocator, vk::Extent2D screenSize);
+
+    // Rebuilds the pipeline from the .spv files on disk
+    void reloadShaders(vk::Device device);
+
+    // Remodulates the shaded or the denoised illumination with the albedo, or shows the
+    // accumulated average or the upscaled frame
     void initializeDescriptorSetFor(const Framebuffer& framebuffer,
                                     const Scene&       scene,
                                     vk::Buffer         uniformBuffer,
-                                    vk::Buffer         reservoirBuffer,
-                                    vk::DeviceSize     reservoirBufferSize,
+                                    vk::ImageView      illuminationView,
+                                    vk::ImageView      denoisedIlluminationView,
+                                    vk::ImageView      accumulatedView,
+                                    vk::ImageView      upscaledView,
                                     vk::Device         device,
                                     vk::DescriptorSet  set);
 
+    // Reads the HDR target back and writes it as a Radiance HDR file
+    void save(ResourceManager&        allocator,
+              TransientCommandBuffer& transientCommandBuffer,
+              const std::string&      filename) const;
+
+    vk::ImageView getHdrView() const;
+
     UniqueBuffer      UniformBuffer;
 
     vk::UniqueRenderPass RenderPass;
@@ -38,7 +57,10 @@ private:
     Shader _vert;
     Shader _frag;
 
-    vk::Format _swapchainFormat;
+    vk::Extent2D          _screenSize;
+    UniqueImage           _hdrImage;
+    vk::UniqueImageView   _hdrView;
+    vk::UniqueFramebuffer _framebuffer;
 
     vk::UniqueSampler             _sampler;
     vk::UniquePipelineLayout      _pipelineLayout;
@@ -46,6 +68,7 @@ private:
 
     vk::UniquePipeline _pipeline;
 
+    void loadShaders(vk::Device device);
     void createPass(vk::Device device);
     void createGraphicsPipeline(vk::Device device);
 };
@@ -1,55 +1,115 @@
 #include "RestirPass.h"
 
+#include "../BlueNoise.h"
 #include "../Scene.h"
 #include "../Structs.h"
+#include "../TransientCommandBuffer.h"
 #include "BasePass.h"
 
 RestirPass::RestirPass(vk::Device                                      device,
                        vk::PhysicalDevice                              physicalDevice,
                        vk::DescriptorPool                              staticDescriptorPool,
                        ResourceManager&                                allocator,
-                       std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData)
+                       std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                       vk::DescriptorSetLayout                         textureDescriptorSetLayout,
+                       TransientCommandBuffer&                         transientCommandBuffer)
 {
     _sampler = allocator.createSampler(device,
                                        vk::Filter::eNearest,
                                        vk::Filter::eNearest,
                                        vk::SamplerMipmapMode::eNearest);
 
-    _rayGen =
-        Shader(device, "shaders/restir.rgen.spv", "main", vk::ShaderStageFlagBits::eRaygenKHR);
-    _rayChit = Shader(device,
-                      "shaders/visibility.rchit.spv",
-                      "main",
-                      vk::ShaderStageFlagBits::eClosestHitKHR);
-    _rayMiss = Shader(device,
-                      "shaders/visibility.rmiss.spv",
-                      "main",
-                      vk::ShaderStageFlagBits::eMissKHR);
-
-    std::array<vk::DescriptorSetLayoutBinding, 5> staticBindings {
+    // Read with texelFetch, so the nearest sampler above serves it as well
+    std::vector<uint16_t> blueNoise      = BlueNoise::generate(1);
+    const auto*           blueNoiseBytes = reinterpret_cast<const unsigned char*>(blueNoise.data());
+    _blueNoise = ResourceManager::loadTexture(blueNoiseBytes,
+                                              BlueNoise::Size,
+                                              BlueNoise::Size,
+                                              vk::Format::eR16G16B16A16Unorm,
+                                              1,
+                                              allocator,
+                                              transientCommandBuffer,
+                                              BlueNoise::Channels * sizeof(uint16_t));
+    _blueNoiseView = allocator.createImageView2D(device,
+                                                 *_blueNoise,
+                                                 vk::Format::eR16G16B16A16Unorm,
+                                                 vk::ImageAspectFlagBits::eColor);
+    transientCommandBuffer.waitIdle();
+
+    const vk::ShaderStageFlags hitStages =
+        vk::ShaderStageFlagBits::eAnyHitKHR | vk::ShaderStageFlagBits::eClosestHitKHR;
+
+    // The denoiser shades the final reservoirs in a compute pass with the same lights
+    const vk::ShaderStageFlags lightStages =
+        vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eCompute;
+
+    std::array<vk::DescriptorSetLayoutBinding, 13> staticBindings {
         {{.binding         = 0,
           .descriptorType  = vk::DescriptorType::eStorageBuffer,
           .descriptorCount = 1,
-          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+          .stageFlags      = lightStages},
 
          {.binding         = 1,
           .descriptorType  = vk::DescriptorType::eStorageBuffer,
           .descriptorCount = 1,
-          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+          .stageFlags      = lightStages},
 
          {.binding         = 2,
           .descriptorType  = vk::DescriptorType::eStorageBuffer,
           .descriptorCount = 1,
-          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+          .stageFlags      = lightStages},
 
          {.binding         = 3,
           .descriptorType  = vk::DescriptorType::eUniformBuffer,
           .descriptorCount = 1,
-          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+          .stageFlags      = lightStages},
 
          {.binding         = 4,
           .descriptorType  = vk::DescriptorType::eAccelerationStructureKHR,
           .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         // Instances, materials, vertex attributes and alpha test indices for the alpha test,
+         // the GI closest hit also reconstructs surfaces from them and the scene indices
+         {.binding         = 5,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = hitStages},
+
+         {.binding         = 6,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = hitStages},
+
+         {.binding         = 7,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = hitStages},
+
+         {.binding         = 8,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = hitStages},
+
+         {.binding         = 9,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eClosestHitKHR},
+
+         // Environment map and its distribution
+         {.binding         = 10,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = lightStages},
+
+         {.binding         = 11,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = lightStages},
+
+         {.binding         = 12,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR}}
     };
 
@@ -57,7 +117,7 @@ RestirPass::RestirPass(vk::Device                                      device,
     staticLayoutInfo.setBindings(staticBindings);
     _staticDescriptorSetLayout = device.createDescriptorSetLayoutUnique(staticLayoutInfo);
 
-    std::array<vk::DescriptorSetLayoutBinding, 10> frameBindings {
+    std::array<vk::DescriptorSetLayoutBinding, 11> frameBindings {
         {{.binding         = 0,
           .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
           .descriptorCount = 1,
@@ -94,7 +154,7 @@ RestirPass::RestirPass(vk::Device                                      device,
           .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
 
          {.binding         = 7,
-          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
 
@@ -103,7 +163,13 @@ RestirPass::RestirPass(vk::Device                                      device,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
 
+         // Candidate budget sums, this frame's and the previous frame's
          {.binding         = 9,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+
+         {.binding         = 10,
           .descriptorType  = vk::DescriptorType::eStorageBuffer,
           .descriptorCount = 1,
           .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR}}
@@ -114,71 +180,23 @@ RestirPass::RestirPass(vk::Device                                      device,
         .pBindings    = frameBindings.data(),
     });
 
-    std::array<vk::DescriptorSetLayout, 2> descriptorLayouts {*_staticDescriptorSetLayout,
-                                                              *_frameDescriptorSetLayout};
+    std::array<vk::DescriptorSetLayout, 3> descriptorLayouts {*_staticDescriptorSetLayout,
+                                                              *_frameDescriptorSetLayout,
+                                                              textureDescriptorSetLayout};
 
     _pipelineLayout = device.createPipelineLayoutUnique({
         .setLayoutCount = static_cast<uint32_t>(descriptorLayouts.size()),
         .pSetLayouts    = descriptorLayouts.data(),
     });
 
-    std::array<vk::RayTracingShaderGroupCreateInfoKHR, 3> shaderGroups {
-        {{.type                            = vk::RayTracingShaderGroupTypeKHR::eGeneral,
-          .generalShader                   = 0,
-          .closestHitShader                = VK_SHADER_UNUSED_KHR,
-          .anyHitShader                    = VK_SHADER_UNUSED_KHR,
-          .intersectionShader              = VK_SHADER_UNUSED_KHR,
-          .pShaderGroupCaptureReplayHandle = nullptr},
-         {.type                            = vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
-          .generalShader                   = VK_SHADER_UNUSED_KHR,
-          .closestHitShader                = 1,
-          .anyHitShader                    = VK_SHADER_UNUSED_KHR,
-          .intersectionShader              = VK_SHADER_UNUSED_KHR,
-          .pShaderGroupCaptureReplayHandle = nullptr},
-         {.type                            = vk::RayTracingShaderGroupTypeKHR::eGeneral,
-          .generalShader                   = 2,
-          .closestHitShader                = VK_SHADER_UNUSED_KHR,
-          .anyHitShader                    = VK_SHADER_UNUSED_KHR,
-          .intersectionShader              = VK_SHADER_UNUSED_KHR,
-          .pShaderGroupCaptureReplayHandle = nullptr}}
-    };
-
-    std::array<vk::PipelineShaderStageCreateInfo, 3> shaderStages {
-        *_rayGen,
-        *_rayChit,
-        *_rayMiss,
-    };
-
-    vk::Result result;
-    std::tie(result, _rayTracingPipeline) =
-        device
-            .createRayTracingPipelineKHRUnique(
-                nullptr,
-                nullptr,
-                {
-                    .stageCount                   = static_cast<uint32_t>(shaderStages.size()),
-                    .pStages                      = shaderStages.data(),
-                    .groupCount                   = static_cast<uint32_t>(shaderGroups.size()),
-                    .pGroups                      = shaderGroups.data(),
-                    .maxPipelineRayRecursionDepth = 1,
-                    .layout                       = *_pipelineLayout,
-                },
-                nullptr)
-            .asTuple();
-
-    if (result != vk::Result::eSuccess)
-    {
-        std::cout << "Failed to create ray tracing pipeline!" << std::endl;
-        std::abort();
-    }
-
     RestirStaticDescriptor = std::move(device.allocateDescriptorSetsUnique({
         .descriptorPool     = staticDescriptorPool,
         .descriptorSetCount = 1,
         .pSetLayouts        = &*_staticDescriptorSetLayout,
     })[0]);
 
-    createShaderBindingTable(device, physicalDevice, allocator);
+    loadShaders(device);
+    createPipeline(device, physicalDevice, allocator);
 
     std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> setLayouts;
     for (vk::DescriptorSetLayout& setLayout : setLayouts)
@@ -198,23 +216,51 @@ RestirPass::RestirPass(vk::Device                                      device,
     }
 }
 
+void RestirPass::reloadShaders(vk::Device         device,
+                               vk::PhysicalDevice physicalDevice,
+                               ResourceManager&   allocator)
+{
+    loadShaders(device);
+    createPipeline(device, physicalDevice, allocator);
+}
+
+vk::DescriptorSetLayout RestirPass::getStaticDescriptorSetLayout() const
+{
+    return *_staticDescriptorSetLayout;
+}
+
+vk::ImageView RestirPass::getBlueNoiseView() const
+{
+    return *_blueNoiseView;
+}
+
 void RestirPass::issueCommands(vk::CommandBuffer commandBuffer,
                                vk::DescriptorSet restirFrameDescriptor,
+                               vk::DescriptorSet textureDescriptor,
+                               vk::Buffer        candidateBudgetBuffer,
                                vk::Extent2D      screenSize) const
 {
+    commandBuffer.fillBuffer(candidateBudgetBuffer, 0, VK_WHOLE_SIZE, 0);
+
+    vk::MemoryBarrier budgetCleared {
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+    };
+
     commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
                                   vk::PipelineStageFlagBits::eAllCommands,
                                   {},
-                                  {},
+                                  budgetCleared,
                                   {},
                                   {});
 
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, *_rayTracingPipeline);
-    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR,
-                                     *_pipelineLayout,
-                                     0,
-                                     {*RestirStaticDescriptor, restirFrameDescriptor},
-                                     {});
+    commandBuffer.bindDescriptorSets(
+        vk::PipelineBindPoint::eRayTracingKHR,
+        *_pipelineLayout,
+        0,
+        {*RestirStaticDescriptor, restirFrameDescriptor, textureDescriptor},
+        {});
     commandBuffer.traceRaysKHR(_rayGenSBT,
                                _rayMissSBT,
                                _rayHitSBT,
@@ -253,7 +299,51 @@ void RestirPass::initializeStaticDescriptorSetFor(const Scene&      scene,
         .range  = sizeof(shader::RestirUniforms),
     };
 
-    std::array<vk::WriteDescriptorSet, 5> writeDescriptorSet {
+    vk::DescriptorBufferInfo instancesInfo {
+        .buffer = *scene.Instances,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo materialsInfo {
+        .buffer = *scene.Materials,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo attributesInfo {
+        .buffer = *scene.Attributes,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo alphaTestIndicesInfo {
+        .buffer = *scene.AlphaTestIndices,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo indicesInfo {
+        .buffer = *scene.Indices,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorImageInfo environmentInfo = scene.Environment.getDescriptorInfo();
+
+    vk::DescriptorBufferInfo environmentDistributionInfo {
+        .buffer = *scene.EnvironmentDistribution,
+        .offset = 0,
+        .range  = scene.EnvironmentDistributionSize,
+    };
+
+    vk::DescriptorImageInfo blueNoiseInfo {
+        .sampler     = *_sampler,
+        .imageView   = *_blueNoiseView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    std::array<vk::WriteDescriptorSet, 13> writeDescriptorSet {
         {{.dstSet          = set,
           .dstBinding      = 0,
           .descriptorCount = 1,
@@ -276,7 +366,57 @@ void RestirPass::initializeStaticDescriptorSetFor(const Scene&      scene,
           .dstBinding      = 3,
           .descriptorCount = 1,
           .descriptorType  = vk::DescriptorType::eUniformBuffer,
-          .pBufferInfo     = &uniformBufferInfo}}
+          .pBufferInfo     = &uniformBufferInfo},
+
+         {},
+
+         {.dstSet          = set,
+          .dstBinding      = 5,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo     = &instancesInfo},
+
+         {.dstSet          = set,
+          .dstBinding      = 6,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo     = &materialsInfo},
+
+         {.dstSet          = set,
+          .dstBinding      = 7,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo     = &attributesInfo},
+
+         {.dstSet          = set,
+          .dstBinding      = 8,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo     = &alphaTestIndicesInfo},
+
+         {.dstSet          = set,
+          .dstBinding      = 9,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo     = &indicesInfo},
+
+         {.dstSet          = set,
+          .dstBinding      = 10,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .pImageInfo      = &environmentInfo},
+
+         {.dstSet          = set,
+          .dstBinding      = 11,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo     = &environmentDistributionInfo},
+
+         {.dstSet          = set,
+          .dstBinding      = 12,
+          .descriptorCount = 1,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .pImageInfo      = &blueNoiseInfo}}
     };
 
     vk::StructureChain<vk::WriteDescriptorSet, vk::WriteDescriptorSetAccelerationStructureKHR>
@@ -304,6 +444,8 @@ void RestirPass::initializeFrameDescriptorSetFor(const Framebuffer& framebuffer,
                                                  vk::Buffer         reservoirBuffer,
                                                  vk::Buffer         prevFrameReservoirBuffer,
                                                  vk::DeviceSize     reservoirBufferSize,
+                                                 vk::Buffer         candidateBudgetBuffer,
+                                                 vk::Buffer         prevFrameCandidateBudgetBuffer,
                                                  vk::Device         device,
                                                  vk::DescriptorSet  set)
 {
@@ -331,15 +473,9 @@ void RestirPass::initializeFrameDescriptorSetFor(const Framebuffer& framebuffer,
         .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
     };
 
-    vk::DescriptorImageInfo previousWorldPositionInfo {
-        .sampler     = *_sampler,
-        .imageView   = *prevFrameFramebuffer.WorldPositionView,
-        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-    };
-
-    vk::DescriptorImageInfo previousAlbedoInfo {
+    vk::DescriptorImageInfo motionVectorInfo {
         .sampler     = *_sampler,
-        .imageView   = *prevFrameFramebuffer.AlbedoView,
+        .imageView   = *framebuffer.MotionVectorView,
         .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
     };
 
@@ -349,9 +485,9 @@ void RestirPass::initializeFrameDescriptorSetFor(const Framebuffer& framebuffer,
         .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
     };
 
-    vk::DescriptorImageInfo previousMaterialPropertiesInfo {
+    vk::DescriptorImageInfo previousMotionVectorInfo {
         .sampler     = *_sampler,
-        .imageView   = *prevFrameFramebuffer.DepthView,
+        .imageView   = *prevFrameFramebuffer.MotionVectorView,
         .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
     };
 
@@ -367,6 +503,18 @@ void RestirPass::initializeFrameDescriptorSetFor(const Framebuffer& framebuffer,
         .range  = reservoirBufferSize,
     };
 
+    vk::DescriptorBufferInfo candidateBudgetInfo {
+        .buffer = candidateBudgetBuffer,
+        .offset = 0,
+        .range  = sizeof(shader::CandidateBudget),
+    };
+
+    vk::DescriptorBufferInfo prevCandidateBudgetInfo {
+        .buffer = prevFrameCandidateBudgetBuffer,
+        .offset = 0,
+        .range  = sizeof(shader::CandidateBudget),
+    };
+
     device.updateDescriptorSets(
         {
             {{.dstSet          = set,
@@ -397,37 +545,43 @@ void RestirPass::initializeFrameDescriptorSetFor(const Framebuffer& framebuffer,
               .dstBinding      = 4,
               .descriptorCount = 1,
               .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-              .pImageInfo      = &previousWorldPositionInfo},
+              .pImageInfo      = &motionVectorInfo},
 
              {.dstSet          = set,
               .dstBinding      = 5,
               .descriptorCount = 1,
               .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-              .pImageInfo      = &previousAlbedoInfo},
+              .pImageInfo      = &previousNormalInfo},
 
              {.dstSet          = set,
               .dstBinding      = 6,
               .descriptorCount = 1,
               .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-              .pImageInfo      = &previousNormalInfo},
+              .pImageInfo      = &previousMotionVectorInfo},
 
              {.dstSet          = set,
               .dstBinding      = 7,
               .descriptorCount = 1,
-              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
-              .pImageInfo      = &previousMaterialPropertiesInfo},
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &reservoirInfo},
 
              {.dstSet          = set,
               .dstBinding      = 8,
               .descriptorCount = 1,
               .descriptorType  = vk::DescriptorType::eStorageBuffer,
-              .pBufferInfo     = &reservoirInfo},
+              .pBufferInfo     = &prevReservoirInfo},
 
              {.dstSet          = set,
               .dstBinding      = 9,
               .descriptorCount = 1,
               .descriptorType  = vk::DescriptorType::eStorageBuffer,
-              .pBufferInfo     = &prevReservoirInfo}}
+              .pBufferInfo     = &candidateBudgetInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 10,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &prevCandidateBudgetInfo}}
     },
         {});
 }
@@ -499,3 +653,79 @@ void RestirPass::createShaderBindingTable(vk::Device&         device,
         .size          = rtProperties.shaderGroupBaseAlignment,
     });
 }
+
+void RestirPass::loadShaders(vk::Device device)
+{
+    _rayGen =
+        Shader(device, "shaders/restir.rgen.spv", "main", vk::ShaderStageFlagBits::eRaygenKHR);
+    _rayChit = Shader(device,
+                      "shaders/visibility.rchit.spv",
+                      "main",
+                      vk::ShaderStageFlagBits::eClosestHitKHR);
+    _rayMiss = Shader(device,
+                      "shaders/visibility.rmiss.spv",
+                      "main",
+                      vk::ShaderStageFlagBits::eMissKHR);
+    _rayAhit = Shader(device,
+                      "shaders/visibility.rahit.spv",
+                      "main",
+                      vk::ShaderStageFlagBits::eAnyHitKHR);
+}
+
+void RestirPass::createPipeline(vk::Device         device,
+                                vk::PhysicalDevice physicalDevice,
+                                ResourceManager&   allocator)
+{
+    std::array<vk::RayTracingShaderGroupCreateInfoKHR, 3> shaderGroups {
+        {{.type                            = vk::RayTracingShaderGroupTypeKHR::eGeneral,
+          .generalShader                   = 0,
+          .closestHitShader                = VK_SHADER_UNUSED_KHR,
+          .anyHitShader                    = VK_SHADER_UNUSED_KHR,
+          .intersectionShader              = VK_SHADER_UNUSED_KHR,
+          .pShaderGroupCaptureReplayHandle = nullptr},
+         {.type                            = vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
+          .generalShader                   = VK_SHADER_UNUSED_KHR,
+          .closestHitShader                = 1,
+          .anyHitShader                    = 3,
+          .intersectionShader              = VK_SHADER_UNUSED_KHR,
+          .pShaderGroupCaptureReplayHandle = nullptr},
+         {.type                            = vk::RayTracingShaderGroupTypeKHR::eGeneral,
+          .generalShader                   = 2,
+          .closestHitShader                = VK_SHADER_UNUSED_KHR,
+          .anyHitShader                    = VK_SHADER_UNUSED_KHR,
+          .intersectionShader              = VK_SHADER_UNUSED_KHR,
+          .pShaderGroupCaptureReplayHandle = nullptr}}
+    };
+
+    std::array<vk::PipelineShaderStageCreateInfo, 4> shaderStages {
+        *_rayGen,
+        *_rayChit,
+        *_rayMiss,
+        *_rayAhit,
+    };
+
+    vk::Result result;
+    std::tie(result, _rayTracingPipeline) =
+        device
+            .createRayTracingPipelineKHRUnique(
+                nullptr,
+                nullptr,
+                {
+                    .stageCount                   = static_cast<uint32_t>(shaderStages.size()),
+                    .pStages                      = shaderStages.data(),
+                    .groupCount                   = static_cast<uint32_t>(shaderGroups.size()),
+                    .pGroups                      = shaderGroups.data(),
+                    .maxPipelineRayRecursionDepth = 1,
+                    .layout                       = *_pipelineLayout,
+                },
+                nullptr)
+            .asTuple();
+
+    if (result != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create ray tracing pipeline!" << std::endl;
+        std::abort();
+    }
+
+    createShaderBindingTable(device, physicalDevice, allocator);
+}
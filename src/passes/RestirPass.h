@@ -15,10 +15,26 @@ public:
                vk::PhysicalDevice                              physicalDevice,
                vk::DescriptorPool                              staticDescriptorPool,
                ResourceManager&                                allocator,
-               std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData);
+               std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+               vk::DescriptorSetLayout                         textureDescriptorSetLayout,
+               TransientCommandBuffer&                         transientCommandBuffer);
 
+    // Rebuilds the pipeline and its shader binding table from the .spv files on disk
+    void reloadShaders(vk::Device         device,
+                       vk::PhysicalDevice physicalDevice,
+                       ResourceManager&   allocator);
+
+    // The GI pass traces the same scene and binds RestirStaticDescriptor too
+    vk::DescriptorSetLayout getStaticDescriptorSetLayout() const;
+
+    // Spatial reuse draws its neighbour offsets from the same blue noise
+    vk::ImageView getBlueNoiseView() const;
+
+    // Clears candidateBudgetBuffer before the trace sums this frame's candidate weights into it
     void issueCommands(vk::CommandBuffer commandBuffer,
                        vk::DescriptorSet restirFrameDescriptor,
+                       vk::DescriptorSet textureDescriptor,
+                       vk::Buffer        candidateBudgetBuffer,
                        vk::Extent2D      screenSize) const;
 
     void initializeStaticDescriptorSetFor(const Scene&      scene,
@@ -31,6 +47,8 @@ public:
                                          vk::Buffer         reservoirBuffer,
                                          vk::Buffer         prevFrameReservoirBuffer,
                                          vk::DeviceSize     reservoirBufferSize,
+                                         vk::Buffer         candidateBudgetBuffer,
+                                         vk::Buffer         prevFrameCandidateBudgetBuffer,
                                          vk::Device         device,
                                          vk::DescriptorSet  set);
 
@@ -46,13 +64,21 @@ private:
     Shader _rayGen;
     Shader _rayChit;
     Shader _rayMiss;
+    Shader _rayAhit;
 
     vk::UniqueSampler             _sampler;
+    UniqueImage                   _blueNoise;
+    vk::UniqueImageView           _blueNoiseView;
     vk::UniquePipelineLayout      _pipelineLayout;
     vk::UniqueDescriptorSetLayout _staticDescriptorSetLayout;
     vk::UniqueDescriptorSetLayout _frameDescriptorSetLayout;
     vk::UniquePipeline            _rayTracingPipeline;
 
+    void loadShaders(vk::Device device);
+    void createPipeline(vk::Device         device,
+                        vk::PhysicalDevice physicalDevice,
+                        ResourceManager&   allocator);
+
     void createShaderBindingTable(vk::Device&         device,
                                   vk::PhysicalDevice& physicalDevice,
                                   ResourceManager&    allocator);
@@ -0,0 +1,200 @@
+#include "SkinningPass.h"
+
+#include "../Scene.h"
+
+SkinningPass::SkinningPass(vk::Device         device,
+                           vk::PhysicalDevice physicalDevice,
+                           vk::DescriptorPool staticDescriptorPool,
+                           const Scene&       scene)
+    : _timestampPeriod(physicalDevice.getProperties().limits.timestampPeriod)
+{
+    if (scene.SkinJobCount == 0)
+    {
+        return;
+    }
+
+    _shader =
+        Shader(device, "shaders/skinning.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+
+    std::array<vk::DescriptorSetLayoutBinding, 5> bindings;
+    for (uint32_t i = 0; i < bindings.size(); ++i)
+    {
+        bindings[i] = {
+            .binding         = i,
+            .descriptorType  = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 1,
+            .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+        };
+    }
+
+    _descriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings    = bindings.data(),
+    });
+
+    _pipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = 1,
+        .pSetLayouts    = &*_descriptorLayout,
+    });
+
+    auto [result, pipeline] = device.createComputePipelineUnique(nullptr,
+                                                                 {
+                                                                     .stage  = *_shader,
+                                                                     .layout = *_pipelineLayout,
+                                                                 });
+
+    if (result != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create compute pipeline!" << std::endl;
+        std::abort();
+    }
+
+    _pipeline = std::move(pipeline);
+
+    _descriptor = std::move(device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts        = &*_descriptorLayout,
+    })[0]);
+
+    std::array<vk::DescriptorBufferInfo, 5> bufferInfos {
+        {{.buffer = *scene.Positions, .offset = 0, .range = VK_WHOLE_SIZE},
+         {.buffer = *scene.Attributes, .offset = 0, .range = VK_WHOLE_SIZE},
+         {.buffer = *scene.SkinVertices, .offset = 0, .range = VK_WHOLE_SIZE},
+         {.buffer = *scene.JointMatrices, .offset = 0, .range = VK_WHOLE_SIZE},
+         {.buffer = *scene.SkinJobs, .offset = 0, .range = VK_WHOLE_SIZE}}
+    };
+
+    std::array<vk::WriteDescriptorSet, 5> writes;
+    for (uint32_t i = 0; i < writes.size(); ++i)
+    {
+        writes[i] = {
+            .dstSet          = *_descriptor,
+            .dstBinding      = i,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo     = &bufferInfos[i],
+        };
+    }
+
+    device.updateDescriptorSets(writes, {});
+
+    _queryPool = device.createQueryPoolUnique({
+        .queryType  = vk::QueryType::eTimestamp,
+        .queryCount = TimestampCount,
+    });
+}
+
+bool SkinningPass::issueCommands(vk::Device        device,
+                                 vk::CommandBuffer commandBuffer,
+                                 Scene&            scene)
+{
+    // The deformed vertices and refitted BLASes hold until the pose changes
+    if (scene.SkinJobCount == 0 || !scene.takeSkinPoseChange())
+    {
+        return false;
+    }
+
+    commandBuffer.resetQueryPool(*_queryPool, 0, TimestampCount);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *_queryPool, Start);
+
+    // The previous frame's vertex fetches and BLAS reads of the deformed vertices
+    vk::MemoryBarrier readBarrier {
+        .srcAccessMask =
+            vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eShaderRead,
+        .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexInput |
+                                      vk::PipelineStageFlagBits::eRayTracingShaderKHR |
+                                      vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  readBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_pipelineLayout,
+                                     0,
+                                     {*_descriptor},
+                                     {});
+    commandBuffer.dispatch(ceilDiv(scene.SkinnedVertexCount, 64), scene.SkinJobCount, 1);
+
+    vk::MemoryBarrier skinnedBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eAccelerationStructureReadKHR |
+                         vk::AccessFlagBits::eVertexAttributeRead |
+                         vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR |
+                                      vk::PipelineStageFlagBits::eVertexInput |
+                                      vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                                  {},
+                                  skinnedBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, *_queryPool, Skinned);
+
+    _issuedRefit = _refits < RefitsPerRebuild;
+    _refits      = _issuedRefit ? _refits + 1 : 0;
+    scene.recordSkinnedBlasBuilds(device, commandBuffer, _issuedRefit);
+
+    // The TLAS build that follows reads the refitted BLASes
+    vk::MemoryBarrier blasBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+        .dstAccessMask = vk::AccessFlagBits::eAccelerationStructureReadKHR,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                  vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR |
+                                      vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                                  {},
+                                  blasBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                 *_queryPool,
+                                 Refitted);
+
+    _queriesIssued = true;
+
+    return true;
+}
+
+void SkinningPass::logTimings(vk::Device device)
+{
+    if (!_queriesIssued)
+    {
+        return;
+    }
+    _queriesIssued = false;
+
+    std::array<uint64_t, TimestampCount> timestamps;
+    if (device.getQueryPoolResults(*_queryPool,
+                                   0,
+                                   TimestampCount,
+                                   sizeof(timestamps),
+                                   timestamps.data(),
+                                   sizeof(uint64_t),
+                                   vk::QueryResultFlagBits::e64) != vk::Result::eSuccess)
+    {
+        return;
+    }
+
+    // Skinning only runs when a pose changes, so every run is logged rather than averaged
+    const double ticksToMs = _timestampPeriod / 1e6;
+    std::cout << "Skinning: " << (timestamps[Skinned] - timestamps[Start]) * ticksToMs
+              << " ms, BLAS " << (_issuedRefit ? "refit" : "rebuild") << ": "
+              << (timestamps[Refitted] - timestamps[Skinned]) * ticksToMs << " ms" << std::endl;
+}
+
+constexpr uint32_t SkinningPass::ceilDiv(uint32_t a, uint32_t b) const
+{
+    return (a + b - 1) / b;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../ResourceManager.h"
+#include "../Shader.h"
+
+class Scene;
+
+// Deforms every skinned instance's copy of its mesh with the current joint matrices whenever a
+// skin is posed, then refits the instances' BLASes. Both steps of every run are timed with GPU
+// timestamps and logged.
+class SkinningPass
+{
+public:
+    SkinningPass() = default;
+    SkinningPass(vk::Device         device,
+                 vk::PhysicalDevice physicalDevice,
+                 vk::DescriptorPool staticDescriptorPool,
+                 const Scene&       scene);
+
+    // Returns false without recording anything when no skin was posed since the last call
+    bool issueCommands(vk::Device device, vk::CommandBuffer commandBuffer, Scene& scene);
+
+    // Logs the timestamps of the last issued run, call once its frame has finished
+    void logTimings(vk::Device device);
+
+private:
+    // Refitting loosens the BLASes as the pose moves away from the one they were built for
+    static constexpr uint32_t RefitsPerRebuild = 32;
+
+    enum Timestamp : uint32_t
+    {
+        Start,
+        Skinned,
+        Refitted,
+        TimestampCount,
+    };
+
+    Shader _shader;
+
+    vk::UniqueDescriptorSetLayout _descriptorLayout;
+    vk::UniquePipelineLayout      _pipelineLayout;
+    vk::UniquePipeline            _pipeline;
+    vk::UniqueDescriptorSet       _descriptor;
+
+    vk::UniqueQueryPool _queryPool;
+    float               _timestampPeriod = 1.0f;
+    bool                _queriesIssued   = false;
+
+    uint32_t _refits      = 0;
+    bool     _issuedRefit = true;
+
+    constexpr uint32_t ceilDiv(uint32_t a, uint32_t b) const;
+};
@@ -1,5 +1,6 @@
 #include "SpatialReusePass.h"
 
+#include "../Scene.h"
 #include "../ShaderInclude.h"
 #include "../Structs.h"
 #include "BasePass.h"
@@ -7,17 +8,15 @@
 SpatialReusePass::SpatialReusePass(vk::Device         device,
                                    vk::DescriptorPool staticDescriptorPool,
                                    ResourceManager&   allocator,
-                                   std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData)
+                                   std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                                   vk::DescriptorSetLayout textureDescriptorSetLayout)
 {
-    _shader =
-        Shader(device, "shaders/spatialReuse.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
-
     _sampler = allocator.createSampler(device,
                                        vk::Filter::eNearest,
                                        vk::Filter::eNearest,
                                        vk::SamplerMipmapMode::eNearest);
 
-    std::array<vk::DescriptorSetLayoutBinding, 8> bindings {
+    std::array<vk::DescriptorSetLayoutBinding, 14> bindings {
         {
          {
                 .binding         = 0,
@@ -59,6 +58,36 @@ SpatialReusePass::SpatialReusePass(vk::Device         device,
                 .descriptorType  = vk::DescriptorType::eStorageBuffer,
                 .descriptorCount = 1,
                 .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            }, {
+                .binding         = 8,
+                .descriptorType  = vk::DescriptorType::eAccelerationStructureKHR,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            }, {
+                .binding         = 9,
+                .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            }, {
+                .binding         = 10,
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            }, {
+                .binding         = 11,
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            }, {
+                .binding         = 12,
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
+            }, {
+                .binding         = 13,
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eCompute,
             }, }
     };
 
@@ -67,30 +96,29 @@ SpatialReusePass::SpatialReusePass(vk::Device         device,
         .pBindings    = bindings.data(),
     });
 
+    // The white noise seed and the iteration, which picks the low discrepancy stream
     vk::PushConstantRange range {
         .stageFlags = vk::ShaderStageFlagBits::eCompute,
         .offset     = 0,
-        .size       = sizeof(uint32_t),
+        .size       = 2 * sizeof(uint32_t),
     };
 
-    _pipelineLayout = device.createPipelineLayoutUnique({.setLayoutCount = 1,
-                                                         .pSetLayouts    = &*_descriptorLayout,
-                                                         .pushConstantRangeCount = 1,
-                                                         .pPushConstantRanges    = &range});
+    std::array<vk::DescriptorSetLayout, 2> descriptorLayouts {*_descriptorLayout,
+                                                              textureDescriptorSetLayout};
 
-    auto [result, pipeline] = device.createComputePipelineUnique(nullptr,
-                                                                 {
-                                                                     .stage  = *_shader,
-                                                                     .layout = *_pipelineLayout,
-                                                                 });
+    _pipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount         = static_cast<uint32_t>(descriptorLayouts.size()),
+        .pSetLayouts            = descriptorLayouts.data(),
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges    = &range,
+    });
 
-    if (result != vk::Result::eSuccess)
-    {
-        std::cout << "Failed to create compute pipeline!" << std::endl;
-        std::abort();
-    }
+    reloadShaders(device);
 
-    _pipeline = std::move(pipeline);
+    DispatchBuffer = allocator.createTypedBuffer<vk::DispatchIndirectCommand>(
+        MaxIterations,
+        vk::BufferUsageFlagBits::eIndirectBuffer,
+        VMA_MEMORY_USAGE_CPU_TO_GPU);
 
     std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> setLayouts;
     for (vk::DescriptorSetLayout& setLayout : setLayouts)
@@ -118,9 +146,30 @@ SpatialReusePass::SpatialReusePass(vk::Device         device,
     }
 }
 
+void SpatialReusePass::reloadShaders(vk::Device device)
+{
+    _shader =
+        Shader(device, "shaders/spatialReuse.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+
+    auto [result, pipeline] = device.createComputePipelineUnique(nullptr,
+                                                                 {
+                                                                     .stage  = *_shader,
+                                                                     .layout = *_pipelineLayout,
+                                                                 });
+
+    if (result != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create compute pipeline!" << std::endl;
+        std::abort();
+    }
+
+    _pipeline = std::move(pipeline);
+}
+
 void SpatialReusePass::issueCommands(vk::CommandBuffer buffer,
                                      vk::DescriptorSet spatialReuseFrameDescriptor,
-                                     vk::Extent2D      screenSize)
+                                     vk::DescriptorSet textureDescriptor,
+                                     int32_t           iteration)
 {
     buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
                            vk::PipelineStageFlagBits::eComputeShader,
@@ -132,25 +181,50 @@ void SpatialReusePass::issueCommands(vk::CommandBuffer buffer,
     buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
                               *_pipelineLayout,
                               0,
-                              {spatialReuseFrameDescriptor},
+                              {spatialReuseFrameDescriptor, textureDescriptor},
                               {});
 
     uint32_t newRandom = _previousRandom + _random;
     _previousRandom    = _random;
     _random            = newRandom;
 
-    buffer.pushConstants(*_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t),
-                         &_random);
-    buffer.dispatch(ceilDiv(screenSize.width, 8), ceilDiv(screenSize.height, 8), 1);
+    std::array<uint32_t, 2> constants {_random, static_cast<uint32_t>(iteration)};
+    buffer.pushConstants(*_pipelineLayout,
+                         vk::ShaderStageFlagBits::eCompute,
+                         0,
+                         static_cast<uint32_t>(sizeof(constants)),
+                         constants.data());
+    buffer.dispatchIndirect(*DispatchBuffer,
+                            static_cast<vk::DeviceSize>(iteration) *
+                                sizeof(vk::DispatchIndirectCommand));
 }
 
-void SpatialReusePass::initializeDescriptorSetFor(const Framebuffer& framebuffer,
-                                                  vk::Buffer         uniformBuffer,
-                                                  vk::Buffer         reservoirBuffer,
-                                                  vk::DeviceSize     reservoirBufferSize,
-                                                  vk::Buffer         resultReservoirBuffer,
-                                                  vk::Device         device,
-                                                  vk::DescriptorSet  set)
+void SpatialReusePass::setIterationCount(int32_t iterations, vk::Extent2D screenSize)
+{
+    auto* commands = DispatchBuffer.mapAs<vk::DispatchIndirectCommand>();
+    for (int32_t i = 0; i < MaxIterations; ++i)
+    {
+        bool enabled = i < iterations;
+        commands[i]  = {
+            .x = enabled ? ceilDiv(screenSize.width, 8) : 0,
+            .y = enabled ? ceilDiv(screenSize.height, 8) : 0,
+            .z = 1,
+        };
+    }
+    DispatchBuffer.unmap();
+    DispatchBuffer.flush();
+}
+
+void SpatialReusePass::initializeDescriptorSetFor(
+    const Framebuffer& framebuffer,
+    const Scene&       scene,
+    vk::Buffer         uniformBuffer,
+    vk::Buffer         reservoirBuffer,
+    vk::DeviceSize     reservoirBufferSize,
+    vk::Buffer         resultReservoirBuffer,
+    vk::ImageView      blueNoiseView,
+    vk::Device         device,
+    vk::DescriptorSet  set)
 {
     vk::DescriptorBufferInfo uniformInfo {
         .buffer = uniformBuffer,
@@ -199,6 +273,36 @@ void SpatialReusePass::initializeDescriptorSetFor(const Framebuffer& framebuffer
         .range  = reservoirBufferSize,
     };
 
+    vk::DescriptorImageInfo blueNoiseInfo {
+        .sampler     = *_sampler,
+        .imageView   = blueNoiseView,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+
+    vk::DescriptorBufferInfo instancesInfo {
+        .buffer = *scene.Instances,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo materialsInfo {
+        .buffer = *scene.Materials,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo attributesInfo {
+        .buffer = *scene.Attributes,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo alphaTestIndicesInfo {
+        .buffer = *scene.AlphaTestIndices,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
     device.updateDescriptorSets(
         {
             {{.dstSet          = set,
@@ -247,9 +351,56 @@ void SpatialReusePass::initializeDescriptorSetFor(const Framebuffer& framebuffer
               .dstBinding      = 7,
               .descriptorCount = 1,
               .descriptorType  = vk::DescriptorType::eStorageBuffer,
-              .pBufferInfo     = &resultReservoirInfo}}
+              .pBufferInfo     = &resultReservoirInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 9,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &blueNoiseInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 10,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &instancesInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 11,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &materialsInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 12,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &attributesInfo},
+
+             {.dstSet          = set,
+              .dstBinding      = 13,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &alphaTestIndicesInfo}}
     },
         {});
+
+    vk::StructureChain<vk::WriteDescriptorSet, vk::WriteDescriptorSetAccelerationStructureKHR>
+        accelerationStructureWrite {
+            {
+             .dstSet          = set,
+             .dstBinding      = 8,
+             .dstArrayElement = 0,
+             .descriptorCount = 1,
+             .descriptorType  = vk::DescriptorType::eAccelerationStructureKHR,
+             },
+            {
+             .accelerationStructureCount = 1,
+             .pAccelerationStructures    = &*scene.TLAS,
+             }
+    };
+
+    device.updateDescriptorSets(accelerationStructureWrite.get<vk::WriteDescriptorSet>(), {});
 }
 
 constexpr uint32_t SpatialReusePass::ceilDiv(uint32_t a, uint32_t b) const
@@ -5,6 +5,7 @@
 
 class Framebuffer;
 struct FramebufferData;
+class Scene;
 
 class SpatialReusePass
 {
@@ -13,20 +14,38 @@ public:
     SpatialReusePass(vk::Device                                      device,
                      vk::DescriptorPool                              staticDescriptorPool,
                      ResourceManager&                                allocator,
-                     std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData);
+                     std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                     vk::DescriptorSetLayout                         textureDescriptorSetLayout);
 
+    static constexpr int32_t MaxIterations = 10;
+
+    // Rebuilds the pipeline from the .spv file on disk
+    void reloadShaders(vk::Device device);
+
+    // Dispatches through DispatchBuffer, so the same recording serves any iteration count
     void issueCommands(vk::CommandBuffer buffer,
                        vk::DescriptorSet spatialReuseFrameDescriptor,
-                       vk::Extent2D      screenSize);
+                       vk::DescriptorSet textureDescriptor,
+                       int32_t           iteration);
 
+    // Iterations at or past the count get an empty dispatch
+    void setIterationCount(int32_t iterations, vk::Extent2D screenSize);
+
+    // The scene's TLAS is traced by the unbiased mode's neighbour visibility rays, which alpha
+    // test masked geometry with its instances, materials and attributes. The blue noise is the
+    // ReSTIR pass's.
     void initializeDescriptorSetFor(const Framebuffer& framebuffer,
+                                    const Scene&       scene,
                                     vk::Buffer         uniformBuffer,
                                     vk::Buffer         reservoirBuffer,
                                     vk::DeviceSize     reservoirBufferSize,
                                     vk::Buffer         resultReservoirBuffer,
+                                    vk::ImageView      blueNoiseView,
                                     vk::Device         device,
                                     vk::DescriptorSet  set);
 
+    UniqueBuffer DispatchBuffer;
+
 private:
     Shader                        _shader;
     vk::UniqueDescriptorSetLayout _descriptorLayout;
@@ -0,0 +1,331 @@
+#include "ToneMappingPass.h"
+
+#include "../TransientCommandBuffer.h"
+
+ToneMappingPass::ToneMappingPass(vk::Device              device,
+                                 vk::DescriptorPool      staticDescriptorPool,
+                                 ResourceManager&        allocator,
+                                 vk::Extent2D            screenSize,
+                                 TransientCommandBuffer& transientCommandBuffer)
+{
+    _sampler = allocator.createSampler(device,
+                                       vk::Filter::eNearest,
+                                       vk::Filter::eNearest,
+                                       vk::SamplerMipmapMode::eNearest);
+
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eStorageBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _descriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings    = bindings.data(),
+    });
+
+    vk::PushConstantRange constantsRange {
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset     = 0,
+        .size       = sizeof(shader::ToneMappingConstants),
+    };
+
+    _pipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount         = 1,
+        .pSetLayouts            = &*_descriptorLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges    = &constantsRange,
+    });
+
+    reloadShaders(device);
+
+    _histogram = allocator.createTypedBuffer<uint32_t>(
+        TONE_MAPPING_HISTOGRAM_BINS,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    _exposure = allocator.createTypedBuffer<shader::ExposureState>(
+        1,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    // The exposure pass clears the histogram after reading it, and a zero average luminance
+    // makes the first frame adopt its own
+    transientCommandBuffer.begin();
+    transientCommandBuffer->fillBuffer(*_histogram, 0, VK_WHOLE_SIZE, 0);
+    transientCommandBuffer->fillBuffer(*_exposure, 0, VK_WHOLE_SIZE, 0);
+    transientCommandBuffer.submitAndWait();
+
+    _descriptorSet = std::move(device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts        = &*_descriptorLayout,
+    })[0]);
+
+    onResized(device, allocator, screenSize, transientCommandBuffer);
+}
+
+void ToneMappingPass::reloadShaders(vk::Device device)
+{
+    _histogramShader = Shader(device,
+                              "shaders/toneMapHistogram.comp.spv",
+                              "main",
+                              vk::ShaderStageFlagBits::eCompute);
+    _exposureShader  = Shader(device,
+                              "shaders/toneMapExposure.comp.spv",
+                              "main",
+                              vk::ShaderStageFlagBits::eCompute);
+    _toneMapShader =
+        Shader(device, "shaders/toneMap.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+
+    _histogramPipeline = createPipeline(device, _histogramShader);
+    _exposurePipeline  = createPipeline(device, _exposureShader);
+    _toneMapPipeline   = createPipeline(device, _toneMapShader);
+}
+
+void ToneMappingPass::issueCommands(vk::CommandBuffer                   commandBuffer,
+                                    vk::Image                           swapchainImage,
+                                    vk::Format                          swapchainFormat,
+                                    vk::Extent2D                        screenSize,
+                                    const shader::ToneMappingConstants& constants) const
+{
+    // The HDR target has to be drawn, and the previous frame done with the histogram, the
+    // exposure and the blit out of the output image
+    vk::MemoryBarrier hdrBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite |
+                         vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                                      vk::PipelineStageFlagBits::eComputeShader |
+                                      vk::PipelineStageFlagBits::eTransfer,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  hdrBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_pipelineLayout,
+                                     0,
+                                     {*_descriptorSet},
+                                     {});
+    commandBuffer.pushConstants(*_pipelineLayout,
+                                vk::ShaderStageFlagBits::eCompute,
+                                0,
+                                sizeof(shader::ToneMappingConstants),
+                                &constants);
+
+    vk::MemoryBarrier computeBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+    };
+
+    // One workgroup covers 16x16 pixels, as many as there are bins
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_histogramPipeline);
+    commandBuffer.dispatch(ceilDiv(screenSize.width, 16), ceilDiv(screenSize.height, 16), 1);
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  computeBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_exposurePipeline);
+    commandBuffer.dispatch(1, 1, 1);
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  computeBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_toneMapPipeline);
+    commandBuffer.dispatch(ceilDiv(screenSize.width, 8), ceilDiv(screenSize.height, 8), 1);
+
+    vk::MemoryBarrier blitBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eTransfer,
+                                  {},
+                                  blitBarrier,
+                                  {},
+                                  {});
+
+    // Waits on the transfer stage, which is where the image acquisition is waited on
+    vk::ImageMemoryBarrier acquireBarrier {
+        .srcAccessMask       = {},
+        .dstAccessMask       = vk::AccessFlagBits::eTransferWrite,
+        .oldLayout           = vk::ImageLayout::eUndefined,
+        .newLayout           = vk::ImageLayout::eTransferDstOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = swapchainImage,
+        .subresourceRange    = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                .baseMipLevel   = 0,
+                                .levelCount     = 1,
+                                .baseArrayLayer = 0,
+                                .layerCount     = 1},
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                  vk::PipelineStageFlagBits::eTransfer,
+                                  {},
+                                  {},
+                                  {},
+                                  acquireBarrier);
+
+    // Storage images can not be sRGB, the blit does the encoding
+    vk::ImageSubresourceLayers subresource {
+        .aspectMask     = vk::ImageAspectFlagBits::eColor,
+        .mipLevel       = 0,
+        .baseArrayLayer = 0,
+        .layerCount     = 1,
+    };
+
+    std::array<vk::Offset3D, 2> bounds {
+        {{.x = 0, .y = 0, .z = 0},
+         {.x = static_cast<int32_t>(screenSize.width),
+          .y = static_cast<int32_t>(screenSize.height),
+          .z = 1}}
+    };
+
+    commandBuffer.blitImage(*_output,
+                            vk::ImageLayout::eGeneral,
+                            swapchainImage,
+                            vk::ImageLayout::eTransferDstOptimal,
+                            vk::ImageBlit {
+                                .srcSubresource = subresource,
+                                .srcOffsets     = bounds,
+                                .dstSubresource = subresource,
+                                .dstOffsets     = bounds,
+                            },
+                            vk::Filter::eNearest);
+
+    ResourceManager::transitionImageLayout(commandBuffer,
+                                           swapchainImage,
+                                           swapchainFormat,
+                                           vk::ImageLayout::eTransferDstOptimal,
+                                           vk::ImageLayout::ePresentSrcKHR);
+}
+
+void ToneMappingPass::onResized(vk::Device              device,
+                                ResourceManager&        allocator,
+                                vk::Extent2D            screenSize,
+                                TransientCommandBuffer& transientCommandBuffer)
+{
+    _output     = allocator.createImage2D(screenSize,
+                                          vk::Format::eR16G16B16A16Sfloat,
+                                          vk::ImageUsageFlagBits::eStorage |
+                                              vk::ImageUsageFlagBits::eTransferSrc);
+    _outputView = allocator.createImageView2D(device,
+                                              *_output,
+                                              vk::Format::eR16G16B16A16Sfloat,
+                                              vk::ImageAspectFlagBits::eColor);
+
+    transientCommandBuffer.begin();
+    ResourceManager::transitionImageLayout(*transientCommandBuffer,
+                                           *_output,
+                                           vk::Format::eR16G16B16A16Sfloat,
+                                           vk::ImageLayout::eUndefined,
+                                           vk::ImageLayout::eGeneral);
+    transientCommandBuffer.submitAndWait();
+}
+
+void ToneMappingPass::initializeDescriptorSet(vk::Device device, vk::ImageView hdrView)
+{
+    vk::DescriptorImageInfo hdrInfo {
+        .sampler     = *_sampler,
+        .imageView   = hdrView,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    vk::DescriptorBufferInfo histogramInfo {
+        .buffer = *_histogram,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorBufferInfo exposureInfo {
+        .buffer = *_exposure,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    vk::DescriptorImageInfo outputInfo {
+        .imageView   = *_outputView,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    device.updateDescriptorSets(
+        {
+            {{.dstSet          = *_descriptorSet,
+              .dstBinding      = 0,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+              .pImageInfo      = &hdrInfo},
+
+             {.dstSet          = *_descriptorSet,
+              .dstBinding      = 1,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &histogramInfo},
+
+             {.dstSet          = *_descriptorSet,
+              .dstBinding      = 2,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageBuffer,
+              .pBufferInfo     = &exposureInfo},
+
+             {.dstSet          = *_descriptorSet,
+              .dstBinding      = 3,
+              .descriptorCount = 1,
+              .descriptorType  = vk::DescriptorType::eStorageImage,
+              .pImageInfo      = &outputInfo}}
+    },
+        {});
+}
+
+vk::UniquePipeline ToneMappingPass::createPipeline(vk::Device device, const Shader& shader) const
+{
+    auto [result, pipeline] = device.createComputePipelineUnique(nullptr,
+                                                                 {
+                                                                     .stage  = *shader,
+                                                                     .layout = *_pipelineLayout,
+                                                                 });
+
+    if (result != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create compute pipeline!" << std::endl;
+        std::abort();
+    }
+
+    return std::move(pipeline);
+}
+
+constexpr uint32_t ToneMappingPass::ceilDiv(uint32_t a, uint32_t b) const
+{
+    return (a + b - 1) / b;
+}
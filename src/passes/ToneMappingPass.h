@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../ResourceManager.h"
+#include "../Shader.h"
+#include "../ShaderInclude.h"
+
+// Maps the lighting pass's HDR target to the display. The exposure follows the average log
+// luminance from a histogram of the frame, and the result is blitted into the swapchain image.
+class ToneMappingPass
+{
+public:
+    ToneMappingPass() = default;
+    ToneMappingPass(vk::Device              device,
+                    vk::DescriptorPool      staticDescriptorPool,
+                    ResourceManager&        allocator,
+                    vk::Extent2D            screenSize,
+                    TransientCommandBuffer& transientCommandBuffer);
+
+    // Rebuilds the pipelines from the .spv files on disk
+    void reloadShaders(vk::Device device);
+
+    // Recorded into the presenting command buffer after the lighting pass, leaves the swapchain
+    // image ready to present
+    void issueCommands(vk::CommandBuffer                   commandBuffer,
+                       vk::Image                           swapchainImage,
+                       vk::Format                          swapchainFormat,
+                       vk::Extent2D                        screenSize,
+                       const shader::ToneMappingConstants& constants) const;
+
+    // Recreates the output image, initializeDescriptorSet has to follow
+    void onResized(vk::Device              device,
+                   ResourceManager&        allocator,
+                   vk::Extent2D            screenSize,
+                   TransientCommandBuffer& transientCommandBuffer);
+
+    void initializeDescriptorSet(vk::Device device, vk::ImageView hdrView);
+
+private:
+    Shader _histogramShader;
+    Shader _exposureShader;
+    Shader _toneMapShader;
+
+    vk::UniqueSampler             _sampler;
+    vk::UniqueDescriptorSetLayout _descriptorLayout;
+    vk::UniquePipelineLayout      _pipelineLayout;
+
+    vk::UniquePipeline _histogramPipeline;
+    vk::UniquePipeline _exposurePipeline;
+    vk::UniquePipeline _toneMapPipeline;
+
+    vk::UniqueDescriptorSet _descriptorSet;
+
+    UniqueBuffer _histogram;
+    UniqueBuffer _exposure;
+
+    UniqueImage         _output;
+    vk::UniqueImageView _outputView;
+
+    vk::UniquePipeline createPipeline(vk::Device device, const Shader& shader) const;
+
+    constexpr uint32_t ceilDiv(uint32_t a, uint32_t b) const;
+};
@@ -0,0 +1,378 @@
+#include "UpscalePass.h"
+
+#include "../Scene.h"
+#include "../ShaderInclude.h"
+#include "../Structs.h"
+#include "../TransientCommandBuffer.h"
+#include "BasePass.h"
+
+UpscalePass::UpscalePass(vk::Device                                      device,
+                         vk::DescriptorPool                              staticDescriptorPool,
+                         ResourceManager&                                allocator,
+                         vk::Extent2D                                    outputSize,
+                         std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                         TransientCommandBuffer&                         transientCommandBuffer)
+{
+    _sampler = allocator.createSampler(device,
+                                       vk::Filter::eNearest,
+                                       vk::Filter::eNearest,
+                                       vk::SamplerMipmapMode::eNearest);
+
+    // Reprojected history lands between pixels
+    _historySampler = allocator.createSampler(device,
+                                              vk::Filter::eLinear,
+                                              vk::Filter::eLinear,
+                                              vk::SamplerMipmapMode::eNearest,
+                                              std::nullopt,
+                                              0.0f,
+                                              0.0f,
+                                              0.0f,
+                                              vk::SamplerAddressMode::eClampToEdge);
+
+    std::array<vk::DescriptorSetLayoutBinding, 10> bindings {
+        {{.binding         = 0,
+          .descriptorType  = vk::DescriptorType::eUniformBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 1,
+          .descriptorType  = vk::DescriptorType::eUniformBuffer,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 2,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 3,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 4,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 5,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 6,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 7,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 8,
+          .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+
+         {.binding         = 9,
+          .descriptorType  = vk::DescriptorType::eStorageImage,
+          .descriptorCount = 1,
+          .stageFlags      = vk::ShaderStageFlagBits::eCompute}}
+    };
+
+    _descriptorLayout = device.createDescriptorSetLayoutUnique({
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings    = bindings.data(),
+    });
+
+    _pipelineLayout = device.createPipelineLayoutUnique({
+        .setLayoutCount = 1,
+        .pSetLayouts    = &*_descriptorLayout,
+    });
+
+    reloadShaders(device);
+
+    UniformBuffer = allocator.createTypedBuffer<shader::UpscaleUniforms>(
+        1,
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+    DispatchBuffer = allocator.createTypedBuffer<vk::DispatchIndirectCommand>(
+        1,
+        vk::BufferUsageFlagBits::eIndirectBuffer,
+        VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+    std::array<vk::DescriptorSetLayout, FRAMEBUFFER_COUNT> setLayouts;
+    for (vk::DescriptorSetLayout& setLayout : setLayouts)
+    {
+        setLayout = *_descriptorLayout;
+    }
+
+    std::vector<vk::UniqueDescriptorSet> descriptorSets = device.allocateDescriptorSetsUnique({
+        .descriptorPool     = staticDescriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(setLayouts.size()),
+        .pSetLayouts        = setLayouts.data(),
+    });
+
+    for (size_t i = 0; i < framebufferData.size(); ++i)
+    {
+        framebufferData[i].UpscaleDescriptor = std::move(descriptorSets[i]);
+    }
+
+    onResized(device, allocator, outputSize, transientCommandBuffer);
+}
+
+void UpscalePass::reloadShaders(vk::Device device)
+{
+    _shader = Shader(device, "shaders/upscale.comp.spv", "main", vk::ShaderStageFlagBits::eCompute);
+
+    auto [result, pipeline] = device.createComputePipelineUnique(nullptr,
+                                                                 {
+                                                                     .stage  = *_shader,
+                                                                     .layout = *_pipelineLayout,
+                                                                 });
+
+    if (result != vk::Result::eSuccess)
+    {
+        std::cout << "Failed to create compute pipeline!" << std::endl;
+        std::abort();
+    }
+
+    _pipeline = std::move(pipeline);
+}
+
+void UpscalePass::issueCommands(vk::CommandBuffer commandBuffer,
+                                vk::DescriptorSet upscaleDescriptor) const
+{
+    // The illumination has to be shaded, and the lighting pass two frames back has to be done
+    // reading the output this frame overwrites
+    vk::MemoryBarrier illuminationBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader |
+                                      vk::PipelineStageFlagBits::eFragmentShader,
+                                  vk::PipelineStageFlagBits::eComputeShader,
+                                  {},
+                                  illuminationBarrier,
+                                  {},
+                                  {});
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *_pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     *_pipelineLayout,
+                                     0,
+                                     {upscaleDescriptor},
+                                     {});
+    commandBuffer.dispatchIndirect(*DispatchBuffer, 0);
+
+    vk::MemoryBarrier lightingBarrier {
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+    };
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eFragmentShader,
+                                  {},
+                                  lightingBarrier,
+                                  {},
+                                  {});
+}
+
+void UpscalePass::update(bool          enabled,
+                         nvmath::vec2f jitter,
+                         nvmath::vec2f prevJitter,
+                         vk::Extent2D  renderSize,
+                         bool          historyValid)
+{
+    auto* uniforms       = UniformBuffer.mapAs<shader::UpscaleUniforms>();
+    uniforms->jitter     = jitter;
+    uniforms->prevJitter = prevJitter;
+    uniforms->renderSize = nvmath::uvec2(renderSize.width, renderSize.height);
+    uniforms->outputSize = nvmath::uvec2(_outputSize.width, _outputSize.height);
+    uniforms->flags      = historyValid ? UPSCALE_HISTORY_FLAG : 0;
+    UniformBuffer.unmap();
+    UniformBuffer.flush();
+
+    auto* command = DispatchBuffer.mapAs<vk::DispatchIndirectCommand>();
+    command->x    = enabled ? ceilDiv(_outputSize.width, 8) : 0;
+    command->y    = enabled ? ceilDiv(_outputSize.height, 8) : 0;
+    command->z    = 1;
+    DispatchBuffer.unmap();
+    DispatchBuffer.flush();
+}
+
+void UpscalePass::onResized(vk::Device              device,
+                            ResourceManager&        allocator,
+                            vk::Extent2D            outputSize,
+                            TransientCommandBuffer& transientCommandBuffer)
+{
+    _outputSize = outputSize;
+
+    transientCommandBuffer.begin();
+    for (StorageImage& output : _output)
+    {
+        output.Image = allocator.createImage2D(outputSize,
+                                               vk::Format::eR16G16B16A16Sfloat,
+                                               vk::ImageUsageFlagBits::eStorage |
+                                                   vk::ImageUsageFlagBits::eSampled);
+        output.View  = allocator.createImageView2D(device,
+                                                  *output.Image,
+                                                  vk::Format::eR16G16B16A16Sfloat,
+                                                  vk::ImageAspectFlagBits::eColor);
+
+        ResourceManager::transitionImageLayout(*transientCommandBuffer,
+                                               *output.Image,
+                                               vk::Format::eR16G16B16A16Sfloat,
+                                               vk::ImageLayout::eUndefined,
+                                               vk::ImageLayout::eGeneral);
+    }
+    transientCommandBuffer.submitAndWait();
+}
+
+void UpscalePass::initializeDescriptorSets(
+    vk::Device                                      device,
+    std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+    const Scene&                                    scene,
+    vk::Buffer                                      lightingUniformBuffer,
+    vk::ImageView                                   illuminationView,
+    vk::ImageView                                   denoisedIlluminationView)
+{
+    vk::DescriptorBufferInfo lightingUniformInfo {
+        .buffer = lightingUniformBuffer,
+        .offset = 0,
+        .range  = sizeof(shader::LightingPassUniforms),
+    };
+
+    vk::DescriptorBufferInfo uniformInfo {
+        .buffer = *UniformBuffer,
+        .offset = 0,
+        .range  = sizeof(shader::UpscaleUniforms),
+    };
+
+    vk::DescriptorImageInfo illuminationInfo {
+        .sampler     = *_sampler,
+        .imageView   = illuminationView,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    vk::DescriptorImageInfo denoisedIlluminationInfo {
+        .sampler     = *_sampler,
+        .imageView   = denoisedIlluminationView,
+        .imageLayout = vk::ImageLayout::eGeneral,
+    };
+
+    vk::DescriptorImageInfo environmentInfo = scene.Environment.getDescriptorInfo();
+
+    for (std::size_t i = 0; i < FRAMEBUFFER_COUNT; ++i)
+    {
+        const std::size_t  previous    = (i + FRAMEBUFFER_COUNT - 1) % FRAMEBUFFER_COUNT;
+        const Framebuffer& framebuffer = framebufferData[i].framebuffer;
+        vk::DescriptorSet  set         = *framebufferData[i].UpscaleDescriptor;
+
+        vk::DescriptorImageInfo albedoInfo {
+            .sampler     = *_sampler,
+            .imageView   = *framebuffer.AlbedoView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo normalInfo {
+            .sampler     = *_sampler,
+            .imageView   = *framebuffer.NormalView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo motionInfo {
+            .sampler     = *_sampler,
+            .imageView   = *framebuffer.MotionVectorView,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        };
+
+        vk::DescriptorImageInfo historyInfo {
+            .sampler     = *_historySampler,
+            .imageView   = *_output[previous].View,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        vk::DescriptorImageInfo outputInfo {
+            .imageView   = *_output[i].View,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        device.updateDescriptorSets(
+            {
+                {{.dstSet          = set,
+                  .dstBinding      = 0,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eUniformBuffer,
+                  .pBufferInfo     = &lightingUniformInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 1,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eUniformBuffer,
+                  .pBufferInfo     = &uniformInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 2,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                  .pImageInfo      = &albedoInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 3,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                  .pImageInfo      = &normalInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 4,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                  .pImageInfo      = &illuminationInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 5,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                  .pImageInfo      = &denoisedIlluminationInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 6,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                  .pImageInfo      = &motionInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 7,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                  .pImageInfo      = &environmentInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 8,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+                  .pImageInfo      = &historyInfo},
+
+                 {.dstSet          = set,
+                  .dstBinding      = 9,
+                  .descriptorCount = 1,
+                  .descriptorType  = vk::DescriptorType::eStorageImage,
+                  .pImageInfo      = &outputInfo}}
+        },
+            {});
+    }
+}
+
+vk::ImageView UpscalePass::getUpscaledView(uint32_t frame) const
+{
+    return *_output[frame].View;
+}
+
+constexpr uint32_t UpscalePass::ceilDiv(uint32_t a, uint32_t b) const
+{
+    return (a + b - 1) / b;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../ResourceManager.h"
+#include "../Shader.h"
+
+class Scene;
+struct FramebufferData;
+
+// Reconstructs the output resolution from jittered frames rendered at a lower resolution. Each
+// output pixel blends the composed samples around it with the reprojected history, clamped to
+// the samples' color distribution.
+class UpscalePass
+{
+public:
+    UpscalePass() = default;
+    UpscalePass(vk::Device                                      device,
+                vk::DescriptorPool                              staticDescriptorPool,
+                ResourceManager&                                allocator,
+                vk::Extent2D                                    outputSize,
+                std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+                TransientCommandBuffer&                         transientCommandBuffer);
+
+    // Rebuilds the pipeline from the .spv file on disk
+    void reloadShaders(vk::Device device);
+
+    // Dispatches through DispatchBuffer, so nothing runs at full resolution
+    void issueCommands(vk::CommandBuffer commandBuffer, vk::DescriptorSet upscaleDescriptor) const;
+
+    // Jitters are in render pixels, the history is only read when the last frame was upscaled
+    void update(bool          enabled,
+                nvmath::vec2f jitter,
+                nvmath::vec2f prevJitter,
+                vk::Extent2D  renderSize,
+                bool          historyValid);
+
+    // Recreates the output images, their descriptors are rewritten by initializeDescriptorSets
+    void onResized(vk::Device              device,
+                   ResourceManager&        allocator,
+                   vk::Extent2D            outputSize,
+                   TransientCommandBuffer& transientCommandBuffer);
+
+    void initializeDescriptorSets(
+        vk::Device                                      device,
+        std::array<FramebufferData, FRAMEBUFFER_COUNT>& framebufferData,
+        const Scene&                                    scene,
+        vk::Buffer                                      lightingUniformBuffer,
+        vk::ImageView                                   illuminationView,
+        vk::ImageView                                   denoisedIlluminationView);
+
+    // The output of the given frame
+    vk::ImageView getUpscaledView(uint32_t frame) const;
+
+    UniqueBuffer UniformBuffer;
+    UniqueBuffer DispatchBuffer;
+
+private:
+    struct StorageImage
+    {
+        UniqueImage         Image;
+        vk::UniqueImageView View;
+    };
+
+    Shader _shader;
+
+    vk::UniqueSampler             _sampler;
+    vk::UniqueSampler             _historySampler;
+    vk::UniqueDescriptorSetLayout _descriptorLayout;
+    vk::UniquePipelineLayout      _pipelineLayout;
+    vk::UniquePipeline            _pipeline;
+
+    vk::Extent2D _outputSize;
+
+    // Indexed by frame, the next frame reads it as its history
+    std::array<StorageImage, FRAMEBUFFER_COUNT> _output;
+
+    constexpr uint32_t ceilDiv(uint32_t a, uint32_t b) const;
+};
@@ -2,34 +2,60 @@
 #extension GL_GOOGLE_include_directive : require
 #extension GL_ARB_separate_shader_objects: enable
 #extension GL_EXT_scalar_block_layout : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 #include "include/structs.glsl"
 
-layout (set = 0, binding = 2) uniform Material
+layout (set = 0, binding = 2) readonly buffer Materials
 {
-	MaterialUniforms material;
+	MaterialUniforms materials[];
 };
 
-layout (set = 1, binding = 0) uniform sampler2D albedoTexture;
-layout (set = 1, binding = 1) uniform sampler2D normalTexture;
-layout (set = 1, binding = 2) uniform sampler2D materialTexture;
-layout (set = 1, binding = 3) uniform sampler2D emissiveTexture;
+layout (set = 0, binding = 4) buffer TextureFeedback
+{
+	int requestedLevels[];
+};
+
+layout (set = 1, binding = 0) uniform sampler2D textures[];
 
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec4 inTangent;
 layout (location = 3) in vec4 inColor;
 layout (location = 4) in vec2 inUv;
+layout (location = 5) flat in uint inMaterialIndex;
+layout (location = 6) in vec4 inClipPosition;
+layout (location = 7) in vec4 inPrevClipPosition;
 
 layout (location = 0) out vec4 outAlbedo;
 layout (location = 1) out vec3 outNormal;
 layout (location = 2) out vec2 outMaterialProperties;
 layout (location = 3) out vec3 outWorldPosition;
+// Screen uv offset to where this surface was last frame, its view depth then and now
+layout (location = 4) out vec4 outMotionVector;
+
+// Finest level the streamer should make resident, relative to the currently bound image
+void requestLevel(int textureIndex, vec2 uv)
+{
+	float lod = textureQueryLod(textures[nonuniformEXT(textureIndex)], uv).y;
+	atomicMin(requestedLevels[textureIndex], int(floor(lod)));
+}
 
 void main()
 {
-	vec4 albedo = texture(albedoTexture, inUv) * material.colorParam;
-	if (material.alphaMode == 1)
+	MaterialUniforms material = materials[inMaterialIndex];
+
+	// One fragment in every 8x8 block is plenty to drive streaming
+	if ((uint(gl_FragCoord.x) & 7u) == 0u && (uint(gl_FragCoord.y) & 7u) == 0u)
+	{
+		requestLevel(material.albedoTexture, inUv);
+		requestLevel(material.normalTexture, inUv * material.normalTextureScale);
+		requestLevel(material.materialTexture, inUv);
+		requestLevel(material.emissiveTexture, inUv);
+	}
+
+	vec4 albedo = texture(textures[nonuniformEXT(material.albedoTexture)], inUv) * material.colorParam;
+	if (material.alphaMode == ALPHA_MODE_MASK)
 	{
 		if (albedo.a < material.alphaCutoff)
 		{
@@ -40,10 +66,13 @@ void main()
 	outAlbedo.rgb = albedo.rgb;
 
 	vec3 bitangent = cross(inNormal, inTangent.xyz) * inTangent.w;
-	vec3 normalTex = texture(normalTexture, inUv * material.normalTextureScale).xyz * 2.0f - 1.0f;
+	// Normal maps may be stored as two-channel BC5, so z is always reconstructed
+	vec3 normalTex;
+	normalTex.xy = texture(textures[nonuniformEXT(material.normalTexture)], inUv * material.normalTextureScale).xy * 2.0f - 1.0f;
+	normalTex.z = sqrt(max(1.0f - dot(normalTex.xy, normalTex.xy), 0.0f));
 	outNormal = normalize(normalTex.x * inTangent.xyz + normalTex.y * bitangent + normalTex.z * inNormal);
 
-	vec4 materialProp = texture(materialTexture, inUv) * material.materialParam;
+	vec4 materialProp = texture(textures[nonuniformEXT(material.materialTexture)], inUv) * material.materialParam;
 	float roughness = 0.0f;
 	float metallic = 0.0f;
 	if (material.shadingModel == METALLIC_ROUGHNESS)
@@ -66,10 +95,14 @@ void main()
 	outMaterialProperties = vec2(roughness, metallic);
 	outWorldPosition = inPosition;
 
+	vec2 uv = inClipPosition.xy / inClipPosition.w;
+	vec2 prevUv = inPrevClipPosition.xy / inPrevClipPosition.w;
+	outMotionVector = vec4((prevUv - uv) * 0.5f, inPrevClipPosition.w, inClipPosition.w);
+
 	outAlbedo.w = 0.0;
 	if (length(material.emissiveFactor.xyz) > 0.0)
 	{
-		outAlbedo.xyz = material.colorParam.rgb * material.emissiveFactor.xyz * texture(emissiveTexture, inUv).rgb;
+		outAlbedo.xyz = material.colorParam.rgb * material.emissiveFactor.xyz * texture(textures[nonuniformEXT(material.emissiveTexture)], inUv).rgb;
 		outAlbedo.w = 1.0;
 	}
 }
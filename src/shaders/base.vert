@@ -2,20 +2,27 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "include/structs.glsl"
+#include "include/vertex.glsl"
 
 layout (set = 0, binding = 0) uniform Uniforms
 {
 	mat4 projectionViewMatrix;
+	mat4 prevFrameProjectionViewMatrix;
 } uniforms;
 
-layout (set = 0, binding = 1) uniform Matrices
+layout (set = 0, binding = 1) readonly buffer Instances
 {
-	ModelMatrices matrices;
+	Instance instances[];
+};
+
+layout (set = 0, binding = 3) readonly buffer VisibleInstances
+{
+	uint visibleInstances[];
 };
 
 layout (location = 0) in vec3 inPosition;
-layout (location = 1) in vec3 inNormal;
-layout (location = 2) in vec4 inTangent;
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in uint inTangent;
 layout (location = 3) in vec4 inColor;
 layout (location = 4) in vec2 inUv;
 
@@ -24,16 +31,30 @@ layout (location = 1) out vec3 outNormal;
 layout (location = 2) out vec4 outTangent;
 layout (location = 3) out vec4 outColor;
 layout (location = 4) out vec2 outUv;
+layout (location = 5) flat out uint outMaterialIndex;
+layout (location = 6) out vec4 outClipPosition;
+layout (location = 7) out vec4 outPrevClipPosition;
 
 void main()
 {
-	vec4 worldPos = matrices.Transform * vec4(inPosition, 1.0f);
+	// gl_InstanceIndex already includes the draw's firstInstance, the mesh's slice of the list
+	Instance model = instances[visibleInstances[gl_InstanceIndex]];
+
+	vec4 worldPos = model.Transform * vec4(inPosition, 1.0f);
 	gl_Position = uniforms.projectionViewMatrix * worldPos;
 
+	// Skinned instances keep an identity transform, their deformation is not tracked here
+	outClipPosition = gl_Position;
+	outPrevClipPosition = uniforms.prevFrameProjectionViewMatrix * model.PreviousTransform * vec4(inPosition, 1.0f);
+
 	outPosition = worldPos.xyz;
-	outNormal = normalize((matrices.TransformInverseTransposed * vec4(inNormal, 0.0f)).xyz);
-	outTangent.xyz = normalize((matrices.Transform * vec4(inTangent.xyz, 0.0f)).xyz);
-	outTangent.w = inTangent.w;
+	vec3 normal = decodeOctahedral(inNormal);
+	vec4 tangent = decodeTangent(inTangent);
+
+	outNormal = normalize((model.TransformInverseTransposed * vec4(normal, 0.0f)).xyz);
+	outTangent.xyz = normalize((model.Transform * vec4(tangent.xyz, 0.0f)).xyz);
+	outTangent.w = tangent.w;
 	outColor = inColor;
 	outUv = inUv;
+	outMaterialIndex = model.material;
 }
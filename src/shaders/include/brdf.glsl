@@ -1,3 +1,6 @@
+#ifndef BRDF_GLSL
+#define BRDF_GLSL
+
 #define M_PI 3.1415926535897932384626433832795
 
 float schlickFresnel(float cos)
@@ -190,3 +193,5 @@ vec3 evaluatePHatFull(vec3 worldPos,
 
 	return emission * disneyBrdfColor(cosIn, cosOut, cosHalf, cosInHalf, albedo, roughness, metallic) * geometry;
 }
+
+#endif // BRDF_GLSL
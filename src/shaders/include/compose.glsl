@@ -0,0 +1,32 @@
+#ifndef COMPOSE_GLSL
+#define COMPOSE_GLSL
+
+#include "denoise.glsl"
+#include "environment.glsl"
+
+// Final radiance of a pixel from its illumination. Emitters are shown as they are, and where
+// nothing was drawn the sky shows through.
+vec3 composePixel(vec3 illumination,
+				  vec4 albedo,
+				  vec3 normal,
+				  vec2 uv,
+				  mat4 inverseProjectionViewMatrix,
+				  vec3 cameraPos,
+				  sampler2D environment)
+{
+	if (dot(normal, normal) == 0.0f)
+	{
+		vec4 farPoint = inverseProjectionViewMatrix * vec4(uv * 2.0f - 1.0f, 0.5f, 1.0f);
+		vec3 direction = normalize(farPoint.xyz / farPoint.w - cameraPos);
+		return textureLod(environment, environmentUv(direction), 0.0f).rgb;
+	}
+
+	if (albedo.w > 0.5f)
+	{
+		return albedo.rgb;
+	}
+
+	return illumination * demodulationAlbedo(albedo.rgb);
+}
+
+#endif // COMPOSE_GLSL
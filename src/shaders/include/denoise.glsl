@@ -0,0 +1,16 @@
+#ifndef DENOISE_GLSL
+#define DENOISE_GLSL
+
+// The denoiser filters illumination, the shaded colour divided by the albedo, so texture detail
+// is not blurred away. The lighting pass multiplies the albedo back in.
+vec3 demodulationAlbedo(vec3 albedo)
+{
+	return max(albedo, vec3(0.01f));
+}
+
+float illuminationLuminance(vec3 illumination)
+{
+	return dot(illumination, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+#endif // DENOISE_GLSL
@@ -0,0 +1,28 @@
+#ifndef ENVIRONMENT_GLSL
+#define ENVIRONMENT_GLSL
+
+#include "brdf.glsl"
+
+// Environment light samples are points this far along their direction, their luminance scaled
+// by the squared distance so the inverse square falloff of evaluatePHat cancels out. Reused at
+// a nearby pixel the direction moves by a negligible angle.
+#define ENVIRONMENT_DISTANCE 100000.0f
+#define ENVIRONMENT_LIGHT_INDEX 0x7FFFFFFF
+
+// Equirectangular, the first row of the image is straight up
+vec3 environmentDirection(vec2 uv)
+{
+	float phi = 2.0f * M_PI * (uv.x - 0.5f);
+	float theta = M_PI * uv.y;
+	return vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+}
+
+vec2 environmentUv(vec3 direction)
+{
+	return vec2(
+		atan(direction.z, direction.x) / (2.0f * M_PI) + 0.5f,
+		acos(clamp(direction.y, -1.0f, 1.0f)) / M_PI
+	);
+}
+
+#endif // ENVIRONMENT_GLSL
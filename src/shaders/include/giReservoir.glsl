@@ -0,0 +1,95 @@
+#ifndef GI_RESERVOIR_GLSL
+#define GI_RESERVOIR_GLSL
+
+#include "random.glsl"
+#include "structs.glsl"
+#include "brdf.glsl"
+
+// Payload of the bounce rays, hit is false on a miss and on emitters, whose light the direct
+// reservoirs already account for
+struct GiHit
+{
+	vec3 position;
+	float roughness;
+	vec3 normal;
+	float metallic;
+	vec3 albedo;
+	bool hit;
+};
+
+GiReservoir newGiReservoir()
+{
+	GiReservoir result;
+	result.position = vec4(0.0f);
+	result.normal = vec4(0.0f);
+	result.radiance = vec4(0.0f);
+	result.pHat = 0.0f;
+	result.sumWeights = 0.0f;
+	result.w = 0.0f;
+	result.numStreamSamples = 0;
+	return result;
+}
+
+// Samples are secondary surface points, so the target function measures them by area like the
+// triangle lights and reconnecting one to another visible point needs no extra Jacobian
+float evaluateGiPHat(vec3 worldPos,
+					 vec3 camPos,
+					 vec3 normal,
+					 float albedoLum,
+					 float roughness,
+					 float metallic,
+					 GiReservoir giSample)
+{
+	return evaluatePHat(
+		worldPos, giSample.position.xyz, camPos,
+		normal, giSample.normal.xyz, true,
+		albedoLum, giSample.radiance.w, roughness, metallic
+	);
+}
+
+void updateGiReservoir(inout GiReservoir res,
+					   GiReservoir candidate,
+					   float weight,
+					   inout Random random)
+{
+	res.sumWeights += weight;
+	if (randFloat(random) < weight / res.sumWeights)
+	{
+		res.position = candidate.position;
+		res.normal = candidate.normal;
+		res.radiance = candidate.radiance;
+		res.pHat = candidate.pHat;
+	}
+}
+
+void finalizeGiReservoir(inout GiReservoir res)
+{
+	res.w = res.pHat > 0.0f ? res.sumWeights / (res.numStreamSamples * res.pHat) : 0.0f;
+}
+
+// sampleP is the area density the candidate's secondary point was found with
+void addSampleToGiReservoir(inout GiReservoir res,
+							GiReservoir candidate,
+							float sampleP,
+							inout Random random)
+{
+	res.numStreamSamples += 1;
+	updateGiReservoir(res, candidate, candidate.pHat / sampleP, random);
+	finalizeGiReservoir(res);
+}
+
+void combineGiReservoirs(inout GiReservoir self, GiReservoir other, float pHat, inout Random random)
+{
+	self.numStreamSamples += other.numStreamSamples;
+
+	float weight = pHat * other.w * other.numStreamSamples;
+	if (weight > 0.0f)
+	{
+		other.pHat = pHat;
+		updateGiReservoir(self, other, weight, random);
+	}
+
+	finalizeGiReservoir(self);
+}
+
+#endif // GI_RESERVOIR_GLSL
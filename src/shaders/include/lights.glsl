@@ -0,0 +1,177 @@
+#ifndef LIGHTS_GLSL
+#define LIGHTS_GLSL
+
+#include "environment.glsl"
+#include "random.glsl"
+#include "structs.glsl"
+
+// Scene lights and the alias table they are importance sampled with, part of the static ReSTIR set
+layout (binding = 0, set = 0) buffer PointLights
+{
+	int count;
+	PointLight lights[];
+} pointLights;
+
+layout (binding = 1, set = 0) buffer TriangleLights
+{
+	int count;
+	TriangleLight lights[];
+} triangleLights;
+
+layout (binding = 2, set = 0) buffer AliasTable
+{
+	int count;
+	int padding[3];
+	Bucket buckets[];
+} aliasTable;
+
+layout (binding = 10, set = 0) uniform sampler2D environmentMap;
+
+layout (binding = 11, set = 0) buffer EnvironmentDistribution
+{
+	EnvironmentHeader header;
+	Bucket buckets[];
+} environmentDistribution;
+
+vec3 pickPointOnTriangle(float r1, float r2, vec3 p1, vec3 p2, vec3 p3)
+{
+	float sqrt_r1 = sqrt(r1);
+	return (1.0 - sqrt_r1) * p1 + (sqrt_r1 * (1.0 - r2)) * p2 + (r2 * sqrt_r1) * p3;
+}
+
+void aliasTableSample(float r1, float r2, out int index, out float probability)
+{
+	int selected_bucket = min(int(aliasTable.count * r1), aliasTable.count - 1);
+	Bucket bucket = aliasTable.buckets[selected_bucket];
+	if (bucket.probability > r2)
+	{
+		index = selected_bucket;
+		probability = bucket.originalProbability;
+	}
+	else
+	{
+		index = bucket.alias;
+		probability = bucket.aliasOriginalProbability;
+	}
+}
+
+// Samples the count buckets of the environment distribution starting at first. Where r1 falls
+// within its bucket is uniform too and comes back as jitter.
+int environmentBucketSample(
+	int first, int count, float r1, float r2, out float probability, out float jitter
+)
+{
+	float scaled = count * r1;
+	int selected = min(int(scaled), count - 1);
+	jitter = min(scaled - selected, 1.0f);
+
+	Bucket bucket = environmentDistribution.buckets[first + selected];
+	if (bucket.probability > r2)
+	{
+		probability = bucket.originalProbability;
+		return selected;
+	}
+
+	probability = bucket.aliasOriginalProbability;
+	return bucket.alias;
+}
+
+// A direction into a texel picked by luminance times solid angle, probability per steradian
+vec3 environmentSample(float r1, float r2, float r3, float r4, out float probability)
+{
+	int width = environmentDistribution.header.width;
+	int height = environmentDistribution.header.height;
+
+	float rowProbability;
+	float rowJitter;
+	int row = environmentBucketSample(0, height, r1, r2, rowProbability, rowJitter);
+
+	float texelProbability;
+	float texelJitter;
+	int column = environmentBucketSample(
+		height + row * width, width, r3, r4, texelProbability, texelJitter
+	);
+
+	vec2 uv = vec2((column + texelJitter) / width, (row + rowJitter) / height);
+
+	// A unit of uv covers 2 pi^2 sin(theta) steradians
+	probability = rowProbability * texelProbability * width * height /
+	              (2.0f * M_PI * M_PI * sin(M_PI * uv.y));
+	return environmentDirection(uv);
+}
+
+// toLight is only needed for the environment, whose emission is scaled like its samples
+vec3 lightEmission(int lightIndex, vec3 toLight)
+{
+	if (lightIndex == ENVIRONMENT_LIGHT_INDEX)
+	{
+		vec3 radiance = textureLod(environmentMap, environmentUv(normalize(toLight)), 0.0f).rgb;
+		return radiance * dot(toLight, toLight);
+	}
+
+	return lightIndex < 0 ? triangleLights.lights[-1 - lightIndex].emission_luminance.rgb
+	                      : pointLights.lights[lightIndex].color_luminance.rgb;
+}
+
+// One light candidate for a surface at worldPos. The probability is in the measure evaluatePHat
+// integrates over: per light for point lights, per area for triangle lights and per steradian
+// for the environment. The alias table and the point on a triangle light take the caller's
+// selection and point samples, the environment draws from random.
+void sampleLight(vec3 worldPos,
+				 vec2 selectionSample,
+				 vec2 pointSample,
+				 inout Random random,
+				 out vec3 position,
+				 out vec4 normal,
+				 out float emissionLum,
+				 out int index,
+				 out float probability)
+{
+	float environmentProbability = environmentDistribution.header.sampleProbability;
+	if (randFloat(random) < environmentProbability)
+	{
+		float directionProbability;
+		vec3 direction = environmentSample(
+			randFloat(random), randFloat(random), randFloat(random), randFloat(random),
+			directionProbability
+		);
+
+		vec3 radiance = textureLod(environmentMap, environmentUv(direction), 0.0f).rgb;
+
+		position = worldPos + direction * ENVIRONMENT_DISTANCE;
+		normal = vec4(0.0f);
+		emissionLum = (0.2126f * radiance.r + 0.7152f * radiance.g + 0.0722f * radiance.b) *
+		              ENVIRONMENT_DISTANCE * ENVIRONMENT_DISTANCE;
+		index = ENVIRONMENT_LIGHT_INDEX;
+		probability = environmentProbability * directionProbability;
+		return;
+	}
+
+	int selected;
+	aliasTableSample(selectionSample.x, selectionSample.y, selected, probability);
+	probability *= 1.0f - environmentProbability;
+
+	if (pointLights.count != 0)
+	{
+		PointLight light = pointLights.lights[selected];
+		position = light.pos.xyz;
+		normal = vec4(0.0f);
+		emissionLum = light.color_luminance.w;
+		index = selected;
+	}
+	else
+	{
+		TriangleLight light = triangleLights.lights[selected];
+		position = pickPointOnTriangle(
+			pointSample.x, pointSample.y, light.p1.xyz, light.p2.xyz, light.p3.xyz
+		);
+		normal = vec4(light.normalArea.xyz, 1.0f);
+		emissionLum = light.emission_luminance.w;
+		index = -1 - selected;
+
+		vec3 wi = normalize(worldPos - position);
+		probability /= abs(dot(wi, light.normalArea.xyz)) * light.normalArea.w;
+	}
+}
+
+#endif // LIGHTS_GLSL
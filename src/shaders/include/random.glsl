@@ -1,3 +1,6 @@
+#ifndef RANDOM_GLSL
+#define RANDOM_GLSL
+
 #extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
 
 struct Random
@@ -30,3 +33,5 @@ float randFloat(inout Random random)
 {
 	return randUint(random) / 4294967296.0f;
 }
+
+#endif // RANDOM_GLSL
@@ -1,7 +1,7 @@
 #include "random.glsl"
 #include "structs.glsl"
 
-void updateReservoirAt(inout Reservoir res,
+bool updateReservoirAt(inout Reservoir res,
 					   int i,
 					   float weight,
 					   vec3 position,
@@ -21,7 +21,10 @@ void updateReservoirAt(inout Reservoir res,
 		res.samples[i].lightIndex = lightIdx;
 		res.samples[i].pHat = pHat;
 		res.samples[i].w = w;
+		return true;
 	}
+
+	return false;
 }
 
 void addSampleToReservoir(inout Reservoir res,
@@ -46,8 +49,10 @@ void addSampleToReservoir(inout Reservoir res,
 	}
 }
 
-void combineReservoirs(inout Reservoir self, Reservoir other, float pHat[RESERVOIR_SIZE], inout Random random)
+// Returns a mask of the samples that were taken from other
+uint combineReservoirs(inout Reservoir self, Reservoir other, float pHat[RESERVOIR_SIZE], inout Random random)
 {
+	uint replaced = 0;
 	self.numStreamSamples += other.numStreamSamples;
 
 	for (int i = 0; i < RESERVOIR_SIZE; ++i)
@@ -55,12 +60,13 @@ void combineReservoirs(inout Reservoir self, Reservoir other, float pHat[RESERVO
 		float weight = pHat[i] * other.samples[i].w * other.numStreamSamples;
 		if (weight > 0.0f)
 		{
-			updateReservoirAt(
+			bool taken = updateReservoirAt(
 				self, i, weight,
 				other.samples[i].position_emissionLum.xyz, other.samples[i].normal, other.samples[i].position_emissionLum.w,
 				other.samples[i].lightIndex, pHat[i],
 				other.samples[i].w, random
 			);
+			replaced |= taken ? 1u << i : 0u;
 		}
 
 		if (self.samples[i].w > 0.0f)
@@ -68,6 +74,8 @@ void combineReservoirs(inout Reservoir self, Reservoir other, float pHat[RESERVO
 			self.samples[i].w = self.samples[i].sumWeights / (self.numStreamSamples * self.samples[i].pHat);
 		}
 	}
+
+	return replaced;
 }
 
 Reservoir newReservoir()
@@ -3,25 +3,8 @@
 #include "include/structs.glsl"
 #include "include/reservoir.glsl"
 #include "include/brdf.glsl"
-
-layout (binding = 0, set = 0) buffer PointLights
-{
-	int count;
-	PointLight lights[];
-} pointLights;
-
-layout (binding = 1, set = 0) buffer TriangleLights
-{
-	int count;
-	TriangleLight lights[];
-} triangleLights;
-
-layout (binding = 2, set = 0) buffer AliasTable
-{
-	int count;
-	int padding[3];
-	Bucket buckets[];
-} aliasTable;
+#include "include/lights.glsl"
+#include "include/sampler.glsl"
 
 layout (binding = 3, set = 0) uniform Uniforms
 {
@@ -30,51 +13,69 @@ layout (binding = 3, set = 0) uniform Uniforms
 
 layout (binding = 4, set = 0) uniform accelerationStructureEXT acc;
 
+layout (binding = 12, set = 0) uniform sampler2D BlueNoiseTexture;
+
 layout (binding = 0, set = 1) uniform sampler2D WorldPositionTexture;
 layout (binding = 1, set = 1) uniform sampler2D AlbedoTexture;
 layout (binding = 2, set = 1) uniform sampler2D NormalTexture;
 layout (binding = 3, set = 1) uniform sampler2D MaterialPropertiesTexture;
 
-layout (binding = 4, set = 1) uniform sampler2D PreviousFrameWorldPositionTexture;
-layout (binding = 5, set = 1) uniform sampler2D PreviousFrameAlbedoTexture;
-layout (binding = 6, set = 1) uniform sampler2D PreviousFrameNormalTexture;
-layout (binding = 7, set = 1) uniform sampler2D PreviousDepthTexture;
+layout (binding = 4, set = 1) uniform sampler2D MotionVectorTexture;
+
+layout (binding = 5, set = 1) uniform sampler2D PreviousFrameNormalTexture;
+layout (binding = 6, set = 1) uniform sampler2D PreviousFrameMotionVectorTexture;
 
-layout (binding = 8, set = 1) buffer Reservoirs
+layout (binding = 7, set = 1) buffer Reservoirs
 {
 	Reservoir reservoirs[];
 };
 
-layout (binding = 9, set = 1) buffer PreviousFrameReservoirs
+layout (binding = 8, set = 1) buffer PreviousFrameReservoirs
 {
 	Reservoir prevFrameReservoirs[];
 };
 
-layout (location = 0) rayPayloadEXT bool isShadowed;
-#include "include/visibility.glsl"
+layout (binding = 9, set = 1) buffer CandidateBudgetBuffer
+{
+	CandidateBudget candidateBudget;
+};
+
+layout (binding = 10, set = 1) buffer PreviousFrameCandidateBudgetBuffer
+{
+	CandidateBudget prevFrameCandidateBudget;
+};
+
+// Frames of statistics a pixel needs before its candidate count adapts, and the most it averages
+#define MIN_CANDIDATE_HISTORY 4.0f
+#define MAX_CANDIDATE_HISTORY 16.0f
 
-vec3 pickPointOnTriangle(float r1, float r2, vec3 p1, vec3 p2, vec3 p3)
+// Relative standard deviation of the candidates' estimate, so dim and bright regions compete
+// on how noisy they are rather than on how much light they get
+float candidateWeight(float mean, float variance)
 {
-	float sqrt_r1 = sqrt(r1);
-	return (1.0 - sqrt_r1) * p1 + (sqrt_r1 * (1.0 - r2)) * p2 + (r2 * sqrt_r1) * p3;
+	return min(sqrt(variance) / max(mean, 0.0001f), ADAPTIVE_CANDIDATE_MAX_WEIGHT);
 }
 
-void aliasTableSample(float r1, float r2, out int index, out float probability)
+// Spreads lightSampleCount per pixel over the covered pixels in proportion to their weights,
+// with the previous frame's sums standing in for this one's
+uint adaptiveCandidateCount(float weight)
 {
-	int selected_bucket = min(int(aliasTable.count * r1), aliasTable.count - 1);
-	Bucket bucket = aliasTable.buckets[selected_bucket];
-	if (bucket.probability > r2)
+	if (prevFrameCandidateBudget.pixelCount == 0 || prevFrameCandidateBudget.weightSum == 0)
 	{
-		index = selected_bucket;
-		probability = bucket.originalProbability;
-	}
-	else
-	{
-		index = bucket.alias;
-		probability = bucket.aliasOriginalProbability;
+		return uniforms.lightSampleCount;
 	}
+
+	float meanWeight = float(prevFrameCandidateBudget.weightSum) /
+	                   (ADAPTIVE_CANDIDATE_WEIGHT_SCALE * float(prevFrameCandidateBudget.pixelCount));
+	float count = float(uniforms.lightSampleCount) * weight / meanWeight;
+
+	uint maxCount = min(uniforms.lightSampleCount * ADAPTIVE_CANDIDATE_MAX_SCALE, 1024u);
+	return clamp(uint(count + 0.5f), 1u, maxCount);
 }
 
+layout (location = 0) rayPayloadEXT bool isShadowed;
+#include "include/visibility.glsl"
+
 void main()
 {
 	uvec2 pixel = gl_LaunchIDEXT.xy;
@@ -90,40 +91,71 @@ void main()
 
 	float albedoLum =  0.2126f * albedo.r + 0.7152f * albedo.g + 0.0722f * albedo.b;
 
+	bool covered = dot(normal, normal) != 0.0f;
+	bool adaptive = (uniforms.flags & RESTIR_ADAPTIVE_CANDIDATES_FLAG) != 0;
+
+	// Where this surface was last frame, for the temporal reuse and the candidate statistics
+	bool reprojected = false;
+	Reservoir prevRes;
+	{
+		vec4 motion = texelFetch(MotionVectorTexture, ivec2(pixel), 0);
+		vec2 prevFramePos = vec2(pixel) + 0.5f + motion.xy * vec2(uniforms.screenSize);
+		if (all(greaterThan(prevFramePos, vec2(0.0f))) &&
+			all(lessThan(prevFramePos, vec2(uniforms.screenSize))))
+		{
+			ivec2 prevFrag = ivec2(prevFramePos);
+
+			// Disoccluded if something else covered the pixel this surface was at last frame
+			float prevDepth = texelFetch(PreviousFrameMotionVectorTexture, prevFrag, 0).w;
+			float normalDot = dot(normal, texelFetch(PreviousFrameNormalTexture, prevFrag, 0).xyz);
+			if (abs(prevDepth - motion.z) < 0.05f * motion.z && normalDot > 0.5f)
+			{
+				prevRes = prevFrameReservoirs[prevFrag.y * uniforms.screenSize.x + prevFrag.x];
+				reprojected = true;
+			}
+		}
+	}
+
+	float prevMean = reprojected ? prevRes.candidateMean : 0.0f;
+	float prevVariance = reprojected ? prevRes.candidateVariance : 0.0f;
+	float prevHistory = reprojected ? prevRes.candidateHistory : 0.0f;
+
+	uint candidateCount = uniforms.lightSampleCount;
+	if (adaptive && prevHistory >= MIN_CANDIDATE_HISTORY)
+	{
+		candidateCount = adaptiveCandidateCount(candidateWeight(prevMean, prevVariance));
+	}
+
+	// Counts vary per pixel in the adaptive mode, so every frame gets the largest block of the
+	// sequences to keep them from overlapping
+	uint sampleStride = adaptive ? uniforms.lightSampleCount * ADAPTIVE_CANDIDATE_MAX_SCALE
+	                             : uniforms.lightSampleCount;
+
 	Reservoir res = newReservoir();
 	Random random = seedRand(uniforms.frame, pixel.y * 10007 + pixel.x);
-	if (dot(normal, normal) != 0.0f)
+	Sampler lightSampler = createSampler(pixel, 0u, uniforms.sampleSequences);
+	if (covered)
 	{
-		for (int i = 0; i < uniforms.lightSampleCount; ++i)
+		for (uint i = 0; i < candidateCount; ++i)
 		{
-			int selected_idx;
-			float lightSampleProb;
-			aliasTableSample(randFloat(random), randFloat(random), selected_idx, lightSampleProb);
+			// Consecutive candidates and frames continue the same sequence
+			uint sampleIndex = uniforms.frame * sampleStride + i;
+			vec2 selectionSample = sample2D(
+				lightSampler, SAMPLE_DIMENSION_LIGHT_SELECTION, sampleIndex, BlueNoiseTexture, random
+			);
+			vec2 pointSample = sample2D(
+				lightSampler, SAMPLE_DIMENSION_TRIANGLE_POINT, sampleIndex, BlueNoiseTexture, random
+			);
 
 			vec3 lightSamplePos;
 			vec4 lightNormal;
 			float lightSampleLum;
 			int lightSampleIndex;
-			if (pointLights.count != 0)
-			{
-				PointLight light = pointLights.lights[selected_idx];
-				lightSamplePos = light.pos.xyz;
-				lightSampleLum = light.color_luminance.w;
-				lightSampleIndex = selected_idx;
-				lightNormal = vec4(0.0f);
-			}
-			else
-			{
-				TriangleLight light = triangleLights.lights[selected_idx];
-				lightSamplePos = pickPointOnTriangle(randFloat(random), randFloat(random), light.p1.xyz, light.p2.xyz, light.p3.xyz);
-				lightSampleLum = light.emission_luminance.w;
-				lightSampleIndex = -1 - selected_idx;
-
-				vec3 wi = normalize(worldPos - lightSamplePos);
-				vec3 normal = light.normalArea.xyz;
-				lightSampleProb /= abs(dot(wi, normal)) * light.normalArea.w;
-				lightNormal = vec4(normal, 1.0f);
-			}
+			float lightSampleProb;
+			sampleLight(
+				worldPos, selectionSample, pointSample, random, lightSamplePos, lightNormal,
+				lightSampleLum, lightSampleIndex, lightSampleProb
+			);
 
 			float pHat = evaluatePHat(
 				worldPos, lightSamplePos, uniforms.cameraPos.xyz,
@@ -151,50 +183,59 @@ void main()
 		}
 	}
 
-	if ((uniforms.flags & RESTIR_TEMPORAL_REUSE_FLAG) != 0)
+	// This frame's estimate before any reuse, the reservoirs' average weight once shadowed
+	// samples are dropped
+	float estimate = 0.0f;
+	if (res.numStreamSamples != 0)
 	{
-		vec4 prevFramePos = uniforms.prevFrameProjectionViewMatrix * vec4(worldPos, 1.0f);
-		prevFramePos.xyz /= prevFramePos.w;
-		prevFramePos.xy = (prevFramePos.xy + 1.0f) * 0.5f * vec2(uniforms.screenSize);
-		if (all(greaterThan(prevFramePos.xy, vec2(0.0f))) &&
-			all(lessThan(prevFramePos.xy, vec2(uniforms.screenSize))))
+		for (int i = 0; i < RESERVOIR_SIZE; ++i)
 		{
-			ivec2 prevFrag = ivec2(prevFramePos.xy);
+			estimate += res.samples[i].sumWeights;
+		}
+		estimate /= float(res.numStreamSamples * RESERVOIR_SIZE);
+	}
 
-			vec3 positionDiff = worldPos - texelFetch(PreviousFrameWorldPositionTexture, prevFrag, 0).xyz;
-			if (dot(positionDiff, positionDiff) < 0.01f)
-			{
-				vec3 albedoDiff = albedo - texelFetch(PreviousFrameAlbedoTexture, prevFrag, 0).rgb;
-				if (dot(albedoDiff, albedoDiff) < 0.01f)
-				{
-					float normalDot = dot(normal, texelFetch(PreviousFrameNormalTexture, prevFrag, 0).xyz);
-					if (normalDot > 0.5f)
-					{
-						Reservoir prevRes = prevFrameReservoirs[prevFrag.y * uniforms.screenSize.x + prevFrag.x];
-
-						prevRes.numStreamSamples = min(
-							prevRes.numStreamSamples, uniforms.temporalSampleCountMultiplier * res.numStreamSamples
-						);
-
-						vec2 metallicRoughness = texelFetch(MaterialPropertiesTexture, ivec2(pixel), 0).xy;
-
-						float pHat[RESERVOIR_SIZE];
-						for (int i = 0; i < RESERVOIR_SIZE; ++i)
-						{
-							pHat[i] = evaluatePHat(
-								worldPos, prevRes.samples[i].position_emissionLum.xyz, uniforms.cameraPos.xyz,
-								normal, prevRes.samples[i].normal.xyz, prevRes.samples[i].normal.w > 0.5f,
-								albedoLum, prevRes.samples[i].position_emissionLum.w, metallicRoughness.x, metallicRoughness.y
-							);
-						}
-
-						combineReservoirs(res, prevRes, pHat, random);
-					}
-				}
-			}
+	res.candidateHistory = min(prevHistory + 1.0f, MAX_CANDIDATE_HISTORY);
+	float blend = 1.0f / res.candidateHistory;
+	res.candidateMean = mix(prevMean, estimate, blend);
+	res.candidateVariance = mix(
+		prevVariance, (estimate - res.candidateMean) * (estimate - prevMean), blend
+	);
+
+	if (all(equal(pixel & 3u, uvec2(0u))))
+	{
+		atomicAdd(candidateBudget.pixelCount, 1u);
+		if (covered)
+		{
+			float weight = candidateWeight(res.candidateMean, res.candidateVariance);
+			atomicAdd(candidateBudget.weightSum, uint(weight * ADAPTIVE_CANDIDATE_WEIGHT_SCALE));
 		}
 	}
 
+	if ((uniforms.flags & RESTIR_TEMPORAL_REUSE_FLAG) != 0 && reprojected)
+	{
+		// The cap follows the configured count, pixels adapted down to a few candidates would
+		// otherwise cut their history short
+		uint streamSamples = adaptive ? max(res.numStreamSamples, uniforms.lightSampleCount)
+		                              : res.numStreamSamples;
+		prevRes.numStreamSamples = min(
+			prevRes.numStreamSamples, uniforms.temporalSampleCountMultiplier * streamSamples
+		);
+
+		vec2 metallicRoughness = texelFetch(MaterialPropertiesTexture, ivec2(pixel), 0).xy;
+
+		float pHat[RESERVOIR_SIZE];
+		for (int i = 0; i < RESERVOIR_SIZE; ++i)
+		{
+			pHat[i] = evaluatePHat(
+				worldPos, prevRes.samples[i].position_emissionLum.xyz, uniforms.cameraPos.xyz,
+				normal, prevRes.samples[i].normal.xyz, prevRes.samples[i].normal.w > 0.5f,
+				albedoLum, prevRes.samples[i].position_emissionLum.w, metallicRoughness.x, metallicRoughness.y
+			);
+		}
+
+		combineReservoirs(res, prevRes, pHat, random);
+	}
+
 	reservoirs[reservoirIndex] = res;
 }
-
@@ -0,0 +1,109 @@
+#ifndef SAMPLER_GLSL
+#define SAMPLER_GLSL
+
+#include "random.glsl"
+#include "structs.glsl"
+
+// Random numbers for candidate generation, drawn per dimension from white noise, Owen scrambled
+// Sobol points or blue noise. Dimensions are 2D pairs, which keeps the Sobol points stratified
+// within each pair; pairs and streams are decorrelated by hashing them into the scramble and the
+// blue noise tile offset.
+struct Sampler
+{
+	uvec2 pixel;
+	uint scramble; // Per pixel and constant over time, so a pixel walks one sequence
+	uint stream;   // Same for every pixel, so the blue noise tiles stay aligned
+	int sequences;
+};
+
+// R2 sequence increments in 0.32 fixed point
+#define R2_STEP uvec2(3242174889u, 2447445414u)
+
+uint hashUint(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+Sampler createSampler(uvec2 pixel, uint stream, int sequences)
+{
+	Sampler s;
+	s.pixel = pixel;
+	s.scramble = hashUint(pixel.y * 10007u + pixel.x);
+	s.stream = stream;
+	s.sequences = sequences;
+	return s;
+}
+
+// The first two Sobol dimensions, as 0.32 fixed point fractions
+uint sobol0(uint index)
+{
+	return bitfieldReverse(index);
+}
+
+uint sobol1(uint index)
+{
+	uint result = 0u;
+	for (uint v = 1u << 31; index != 0u; index >>= 1, v ^= v >> 1)
+	{
+		if ((index & 1u) != 0u)
+		{
+			result ^= v;
+		}
+	}
+	return result;
+}
+
+// Laine-Karras hash on the reversed bits, a nested uniform scramble of the fraction
+uint owenScramble(uint x, uint seed)
+{
+	x = bitfieldReverse(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return bitfieldReverse(x);
+}
+
+// 24 bits so the float never rounds up to 1
+vec2 toUnitSquare(uvec2 fixedPoint)
+{
+	return vec2(fixedPoint >> 8) * (1.0f / 16777216.0f);
+}
+
+// index is the sample's position along the pixel's sequence, it should grow across frames
+vec2 sample2D(Sampler s, int dimension, uint index, sampler2D blueNoise, inout Random random)
+{
+	int sequence = (s.sequences >> (SAMPLE_SEQUENCE_BITS * dimension)) & ((1 << SAMPLE_SEQUENCE_BITS) - 1);
+	uint dimensionHash = hashUint(s.stream * SAMPLE_DIMENSION_COUNT + uint(dimension));
+
+	if (sequence == SAMPLE_SEQUENCE_SOBOL)
+	{
+		uint seed = hashUint(s.scramble ^ dimensionHash);
+		return toUnitSquare(uvec2(
+			owenScramble(sobol0(index), seed), owenScramble(sobol1(index), hashUint(seed))
+		));
+	}
+
+	if (sequence == SAMPLE_SEQUENCE_BLUE_NOISE)
+	{
+		uvec2 size = uvec2(textureSize(blueNoise, 0));
+		uvec2 offset = uvec2(dimensionHash, dimensionHash >> 16);
+		vec4 noise = texelFetch(blueNoise, ivec2((s.pixel + offset) % size), 0);
+		vec2 value = (dimensionHash & (1u << 31)) != 0u ? noise.xy : noise.zw;
+
+		// Every texel walks the R2 sequence over time, which keeps the spatial pattern blue while
+		// spreading each pixel's samples evenly
+		uvec2 shift = uvec2(value * 4294967296.0f) + index * R2_STEP;
+		return toUnitSquare(shift);
+	}
+
+	return vec2(randFloat(random), randFloat(random));
+}
+
+#endif // SAMPLER_GLSL
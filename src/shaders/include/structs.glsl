@@ -5,10 +5,57 @@
 
 #define RESTIR_VISIBILITY_REUSE_FLAG (1 << 0)
 #define RESTIR_TEMPORAL_REUSE_FLAG (1 << 1)
+#define RESTIR_UNBIASED_FLAG (1 << 2)
+#define RESTIR_GI_FLAG (1 << 3)
+// The denoiser's history is from the previous frame and can be reprojected
+#define RESTIR_DENOISE_HISTORY_FLAG (1 << 4)
+// Candidate counts follow each pixel's variance, lightSampleCount becomes the average
+#define RESTIR_ADAPTIVE_CANDIDATES_FLAG (1 << 5)
+
+// Adaptive candidate counts go up to this many times lightSampleCount
+#define ADAPTIVE_CANDIDATE_MAX_SCALE 4
+// Candidate weights are summed as fixed point over every 4th pixel in both directions
+#define ADAPTIVE_CANDIDATE_WEIGHT_SCALE 256.0f
+#define ADAPTIVE_CANDIDATE_MAX_WEIGHT 8.0f
+
+// Neighbours the unbiased spatial reuse remembers for its MIS weights
+#define MAX_UNBIASED_NEIGHBORS 16
+
+// Random decisions of candidate generation, each a 2D pair with its own sequence
+#define SAMPLE_DIMENSION_LIGHT_SELECTION 0
+#define SAMPLE_DIMENSION_TRIANGLE_POINT 1
+#define SAMPLE_DIMENSION_SPATIAL_OFFSET 2
+#define SAMPLE_DIMENSION_COUNT 3
+
+// Packed into RestirUniforms.sampleSequences, SAMPLE_SEQUENCE_BITS per dimension
+#define SAMPLE_SEQUENCE_WHITE_NOISE 0
+#define SAMPLE_SEQUENCE_SOBOL 1
+#define SAMPLE_SEQUENCE_BLUE_NOISE 2
+#define SAMPLE_SEQUENCE_COUNT 3
+#define SAMPLE_SEQUENCE_BITS 2
+
+#define CULLING_OCCLUSION_FLAG (1 << 0)
+
+#define LIGHTING_DENOISE_FLAG (1 << 0)
+#define LIGHTING_ACCUMULATE_FLAG (1 << 1)
+#define LIGHTING_UPSCALE_FLAG (1 << 2)
+
+#define UPSCALE_HISTORY_FLAG (1 << 0)
+
+#define TONE_MAPPING_AUTO_EXPOSURE_FLAG (1 << 0)
+#define TONE_MAPPING_HISTOGRAM_BINS 256
+
+#define TONE_MAPPING_CLAMP 0
+#define TONE_MAPPING_REINHARD 1
+#define TONE_MAPPING_ACES 2
+#define TONE_MAPPING_UNCHARTED 3
+#define TONE_MAPPING_OPERATOR_COUNT 4
 
 #define METALLIC_ROUGHNESS 0
 #define SPECULAR_GLOSSINESS 1
 
+#define ALPHA_MODE_MASK 1
+
 struct LightSample
 {
 	vec4 position_emissionLum;
@@ -23,10 +70,37 @@ struct Reservoir
 {
 	LightSample samples[RESERVOIR_SIZE];
 	uint numStreamSamples;
+
+	// Running mean and variance of the candidates' shading estimate and the frames they cover,
+	// carried along with the reservoir for the adaptive candidate count
+	float candidateMean;
+	float candidateVariance;
+	float candidateHistory;
+};
+
+// Sums over the sampled pixels of a frame, read back by the next one to spread its budget
+struct CandidateBudget
+{
+	uint weightSum;
+	uint pixelCount;
+};
+
+// One bounce of indirect light: a secondary surface and the radiance it sends back toward the
+// visible point that traced it, luminance in radiance.w
+struct GiReservoir
+{
+	vec4 position;
+	vec4 normal;
+	vec4 radiance;
+	float pHat;
+	float sumWeights;
+	float w;
+	uint numStreamSamples;
 };
 
 struct RestirUniforms
 {
+	mat4 projectionViewMatrix;
 	mat4 prevFrameProjectionViewMatrix;
 	vec4 cameraPos;
 	uvec2 screenSize;
@@ -42,12 +116,27 @@ struct RestirUniforms
 	float spatialRadius;
 
 	int flags;
+	int sampleSequences;
 };
 
-struct ModelMatrices
+// One placed copy of a mesh. Instances of the same mesh are stored next to each other and the
+// index into this table is also the TLAS instance custom index.
+struct Instance
 {
 	mat4 Transform;
 	mat4 TransformInverseTransposed;
+	// Where the instance was last frame, for motion vectors
+	mat4 PreviousTransform;
+	uint material;
+	uint drawIndex;
+	// Where the alpha tested triangles of an alpha masked mesh start in the alpha test index
+	// buffer, and the vertex their indices are relative to
+	uint alphaTestFirstIndex;
+	uint vertexOffset;
+	// First index of the mesh's first BLAS geometry, in the alpha test index buffer for alpha
+	// masked meshes and in the scene index buffer otherwise
+	uint firstIndex;
+	uint padding[3];
 };
 
 struct MaterialUniforms
@@ -60,6 +149,12 @@ struct MaterialUniforms
 	int alphaMode;
 	float alphaCutoff;
 	float normalTextureScale;
+
+	// Indices into the scene texture array, defaults already substituted for missing textures
+	int albedoTexture;
+	int normalTexture;
+	int materialTexture;
+	int emissiveTexture;
 };
 
 struct PointLight
@@ -85,12 +180,100 @@ struct Bucket
 	float aliasOriginalProbability;
 };
 
+// Leads the environment distribution, followed by the alias table over its rows and then one
+// table per row over the row's texels
+struct EnvironmentHeader
+{
+	int width;
+	int height;
+	// Chance a light candidate is drawn from the environment instead of the scene lights
+	float sampleProbability;
+	float padding;
+};
+
 struct LightingPassUniforms
 {
+	mat4 inverseProjectionViewMatrix;
 	mat4 prevFrameProjectionViewMatrix;
 	vec4 cameraPos;
 	uvec2 bufferSize;
-	float gamma;
+	int flags;
+};
+
+// Frames already averaged into the accumulation image, zero restarts it
+struct AccumulationUniforms
+{
+	uint sampleCount;
+};
+
+// Jitter is the sub-pixel offset of the projection in render pixels, for this frame and the last
+struct UpscaleUniforms
+{
+	vec2 jitter;
+	vec2 prevJitter;
+	uvec2 renderSize;
+	uvec2 outputSize;
+	int flags;
+};
+
+// The histogram covers luminances from 2^minLogLuminance over logLuminanceRange stops.
+// Adaptation is the fraction of the way the exposure moves toward the current frame's.
+struct ToneMappingConstants
+{
+	float minLogLuminance;
+	float logLuminanceRange;
+	float adaptation;
+	float exposureCompensation;
+	int toneMappingOperator;
+	int flags;
+};
+
+// Carried from frame to frame on the GPU
+struct ExposureState
+{
+	float averageLuminance;
+	float exposure;
+};
+
+// boxMin.w is zero for instances without static bounds, which are never culled
+struct InstanceBounds
+{
+	vec4 boxMin;
+	vec4 boxMax;
+};
+
+struct SkinVertex
+{
+	uvec4 joints;
+	vec4 weights;
+};
+
+// Deforms vertexCount vertices of a mesh starting at sourceVertex into the instance's own copy
+// starting at targetVertex
+struct SkinJob
+{
+	uint sourceVertex;
+	uint targetVertex;
+	uint vertexCount;
+	uint firstJoint;
+};
+
+struct DrawCommand
+{
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+struct CullingUniforms
+{
+	mat4 projectionViewMatrix;
+	mat4 prevFrameProjectionViewMatrix;
+	uvec2 screenSize;
+	uint instanceCount;
+	int flags;
 };
 
 #endif
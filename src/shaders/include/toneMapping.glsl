@@ -0,0 +1,30 @@
+#ifndef TONE_MAPPING_GLSL
+#define TONE_MAPPING_GLSL
+
+#include "structs.glsl"
+
+layout (push_constant) uniform PushConstants
+{
+	ToneMappingConstants constants;
+};
+
+layout (binding = 0) uniform sampler2D HdrTexture;
+
+layout (binding = 1) buffer Histogram
+{
+	uint bins[TONE_MAPPING_HISTOGRAM_BINS];
+};
+
+layout (binding = 2) buffer Exposure
+{
+	ExposureState exposureState;
+};
+
+layout (binding = 3, rgba16f) uniform writeonly image2D outputImage;
+
+float luminance(vec3 color)
+{
+	return dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+#endif // TONE_MAPPING_GLSL
@@ -0,0 +1,47 @@
+#ifndef VERTEX_GLSL
+#define VERTEX_GLSL
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 direction = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	if (direction.z < 0.0f)
+	{
+		direction.xy = (1.0f - abs(direction.yx)) * vec2(direction.x >= 0.0f ? 1.0f : -1.0f,
+		                                                 direction.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	return normalize(direction);
+}
+
+vec2 encodeOctahedral(vec3 direction)
+{
+	vec2 encoded = direction.xy / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+	if (direction.z < 0.0f)
+	{
+		encoded = (1.0f - abs(encoded.yx)) * vec2(encoded.x >= 0.0f ? 1.0f : -1.0f,
+		                                          encoded.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	return encoded;
+}
+
+// Tangent direction is stored as unorm16 + unorm15 octahedral coordinates, the bitangent sign
+// takes the remaining top bit.
+vec4 decodeTangent(uint packed)
+{
+	vec2 encoded = vec2(float(packed & 0xFFFFu) / 65535.0f,
+	                    float((packed >> 16u) & 0x7FFFu) / 32767.0f) * 2.0f - 1.0f;
+
+	return vec4(decodeOctahedral(encoded), (packed & 0x80000000u) != 0u ? -1.0f : 1.0f);
+}
+
+uint encodeTangent(vec4 tangent)
+{
+	vec2 encoded = encodeOctahedral(tangent.xyz) * 0.5f + 0.5f;
+
+	return uint(round(clamp(encoded.x, 0.0f, 1.0f) * 65535.0f)) |
+	       (uint(round(clamp(encoded.y, 0.0f, 1.0f) * 32767.0f)) << 16u) |
+	       (tangent.w < 0.0f ? 0x80000000u : 0u);
+}
+
+#endif // VERTEX_GLSL
@@ -8,9 +8,10 @@ bool testVisibility(vec3 p1, vec3 p2)
 	float curTMax = length(dir);
 	dir /= curTMax;
 
+	// Not forced opaque, alpha masked geometry runs the any-hit alpha test
 	traceRayEXT(
 		acc,
-		gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsOpaqueEXT | gl_RayFlagsSkipClosestHitShaderEXT,
+		gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsSkipClosestHitShaderEXT,
 		0xFF,
 		0,
 		0,